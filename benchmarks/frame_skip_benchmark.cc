@@ -0,0 +1,65 @@
+// Measures PPU throughput with frame skipping. Skipped frames keep exact
+// timing, so the speedup comes only from not fetching and drawing pixels.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+
+#include "interrupt_controller.h"
+#include "ppu.h"
+#include "screen.h"
+#include "video_sink.h"
+
+const int BENCHMARK_FRAMES = 600;
+const int MAX_FRAME_SKIP = 8;
+// Roughly the average instruction length, in cycles.
+const int CYCLES_PER_ADVANCE = 12;
+
+class NullInterruptHandler : public InterruptHandler {
+ public:
+  void RequestInterrupt(Interrupt interrupt) { (void)interrupt; }
+};
+
+double FramesPerSecond(int frame_skip) {
+  HeadlessVideoSink video_sink;
+  Screen screen(&video_sink);
+  PPU ppu(&screen);
+  NullInterruptHandler handler;
+  ppu.SetInterruptHandler(&handler);
+  ppu.SetFrameSkip(frame_skip);
+
+  // Busy background, window and sprites.
+  std::mt19937 rng(42);
+  for (uint16_t address = 0x8000; address < 0xA000; address++) {
+    ppu.SetByteAt(address, rng());
+  }
+  for (uint16_t address = 0xFE00; address < 0xFEA0; address++) {
+    ppu.SetByteAt(address, rng() % 168);
+  }
+  ppu.SetByteAt(0xFF40, 0xF3);
+  ppu.SetByteAt(0xFF4A, 100);
+  ppu.SetByteAt(0xFF4B, 87);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  int frames = 0;
+  while (frames < BENCHMARK_FRAMES) {
+    if (ppu.Advance(CYCLES_PER_ADVANCE)) {
+      frames++;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::high_resolution_clock::now() - start;
+  return frames / elapsed.count();
+}
+
+int main() {
+  double base_fps = FramesPerSecond(0);
+  std::cerr << "skip 0: " << base_fps << " frames/s" << std::endl;
+  for (int frame_skip = 1; frame_skip <= MAX_FRAME_SKIP; frame_skip++) {
+    double fps = FramesPerSecond(frame_skip);
+    std::cerr << "skip " << frame_skip << ": " << fps << " frames/s ("
+              << fps / base_fps << "x)" << std::endl;
+  }
+  return 0;
+}
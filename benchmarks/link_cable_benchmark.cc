@@ -0,0 +1,58 @@
+// Measures two emulators joined by a LinkCable against one running alone:
+// with nothing sent, and with bytes going back and forth as fast as the
+// cable allows.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "emulator.h"
+#include "link_cable.h"
+#include "test_roms.h"
+
+const int BENCHMARK_FRAMES = 600;
+
+Emulator *Create(const std::vector<uint8_t> &rom) {
+  EmulatorOptions options;
+  options.audio_buffer_ms = 0;
+  options.rtc_time = 1;
+  return Emulator::Create(rom.data(), rom.size(), options);
+}
+
+// Returns microseconds per frame of both.
+double LinkedMicroseconds(bool send) {
+  std::vector<uint8_t> clocking = send ? TransferROM(true, true) : IdleROM();
+  std::vector<uint8_t> listening = send ? TransferROM(false, true) : IdleROM();
+  Emulator *a = Create(clocking);
+  Emulator *b = Create(listening);
+  LinkCable *cable = new LinkCable(a, b);
+  auto start = std::chrono::high_resolution_clock::now();
+  cable->RunFrames(BENCHMARK_FRAMES);
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  std::cerr << (send ? "sending" : "idle") << ": " << cable->transfers() << " transfers, "
+            << (double)cable->runs() / BENCHMARK_FRAMES << " runs a frame" << std::endl;
+  delete cable;
+  delete a;
+  delete b;
+  return 1e6 * elapsed.count() / BENCHMARK_FRAMES;
+}
+
+double AloneMicroseconds(bool send) {
+  Emulator *a = Create(send ? TransferROM(true, true) : IdleROM());
+  auto start = std::chrono::high_resolution_clock::now();
+  a->RunFrames(BENCHMARK_FRAMES);
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  delete a;
+  return 1e6 * elapsed.count() / BENCHMARK_FRAMES;
+}
+
+int main() {
+  for (bool send : {false, true}) {
+    double alone = AloneMicroseconds(send);
+    double linked = LinkedMicroseconds(send);
+    std::cerr << (send ? "sending" : "idle") << ": one alone " << alone << " us/frame, two linked "
+              << linked << " us/frame, " << linked / (2 * alone) << "x two alone" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,55 @@
+// Measures the polyphase resampler turning APU output at its native rate into
+// common device rates, in nanoseconds per output sample (both channels).
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "constants.h"
+#include "polyphase_resampler.h"
+
+const int BENCHMARK_SECONDS = 10;
+// Samples handed over at a time, about one frame's worth.
+const int CHUNK_SAMPLES = NATIVE_SAMPLE_RATE / 60;
+
+double NanosecondsPerSample(int out_rate, const std::vector<int16_t> &input, int *taps) {
+  PolyphaseResampler resampler(NATIVE_SAMPLE_RATE, out_rate);
+  *taps = resampler.taps();
+  std::vector<int16_t> output(2 * resampler.MaxOutput(CHUNK_SAMPLES));
+  long long written = 0;
+  int16_t check = 0;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int second = 0; second < BENCHMARK_SECONDS; second++) {
+    for (int offset = 0; offset + CHUNK_SAMPLES <= NATIVE_SAMPLE_RATE; offset += CHUNK_SAMPLES) {
+      int count = resampler.Process(input.data() + 2 * offset, CHUNK_SAMPLES, output.data());
+      written += count;
+      check ^= output[0];
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::high_resolution_clock::now() - start;
+  if (check == 12345) {
+    std::cerr << "";
+  }
+  return elapsed.count() / written;
+}
+
+int main() {
+  // One second of noisy stereo input, reused.
+  std::mt19937 rng(42);
+  std::vector<int16_t> input(2 * NATIVE_SAMPLE_RATE);
+  for (int16_t &sample : input) {
+    sample = (int16_t)(rng() % 16384) - 8192;
+  }
+
+  const int rates[] = {44100, 48000, 96000};
+  for (int rate : rates) {
+    int taps;
+    double ns = NanosecondsPerSample(rate, input, &taps);
+    std::cerr << rate << " Hz: " << ns << " ns/sample (" << taps << " taps)" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Measures the worst case of a RollbackSession: the peer's input changes every
+// frame and arrives max_rollback frames late, so every frame rolls back that
+// far and runs again. Both ends run in this process over a LoopbackLink, and
+// only the first is timed. Pass a ROM to run it rather than the built in loop.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "emulator.h"
+#include "loopback_transport.h"
+#include "rollback_session.h"
+#include "test_roms.h"
+
+const int BENCHMARK_FRAMES = 300;
+// One frame at 60 Hz.
+const double FRAME_BUDGET_MS = 1000.0 / 60;
+
+int main(int argc, char *argv[]) {
+  std::vector<uint8_t> rom = LoopROM();
+  if (argc > 1) {
+    std::ifstream file(argv[1], std::ios::binary);
+    rom.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  EmulatorOptions emulator_options;
+  emulator_options.audio_buffer_ms = 0;
+  emulator_options.rtc_time = 1;
+  RollbackOptions options;
+  options.input_delay = 0;
+  LoopbackOptions link_options;
+  link_options.latency_frames = options.max_rollback;
+  LoopbackLink link(link_options);
+
+  Emulator *emulators[2];
+  RollbackSession *sessions[2];
+  for (int i = 0; i < 2; i++) {
+    emulators[i] = Emulator::Create(rom.data(), rom.size(), emulator_options);
+    if (!emulators[i]) {
+      std::cerr << "Unsupported ROM" << std::endl;
+      return 1;
+    }
+    sessions[i] = new RollbackSession(emulators[i], link.end(i), options);
+  }
+
+  std::vector<double> frame_ms;
+  while (sessions[0]->frame() < BENCHMARK_FRAMES) {
+    auto start = std::chrono::high_resolution_clock::now();
+    bool ran = sessions[0]->AdvanceFrame(sessions[0]->frame() & 0x0F);
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    if (ran) {
+      frame_ms.push_back(elapsed.count());
+    }
+    sessions[1]->AdvanceFrame((sessions[1]->frame() & 0x0F) << 4);
+    link.Tick();
+  }
+
+  std::sort(frame_ms.begin(), frame_ms.end());
+  double total = 0;
+  for (double ms : frame_ms) {
+    total += ms;
+  }
+  std::cerr << sessions[0]->rollbacks() << " rollbacks, " << sessions[0]->resimulated_frames()
+            << " frames run again, " << sessions[0]->stalls() << " stalls" << std::endl;
+  std::cerr << "ms per frame: mean " << total / frame_ms.size() << ", median "
+            << frame_ms[frame_ms.size() / 2] << ", 99th percentile "
+            << frame_ms[frame_ms.size() * 99 / 100] << ", max " << frame_ms.back() << " (budget "
+            << FRAME_BUDGET_MS << ")" << std::endl;
+  for (int i = 0; i < 2; i++) {
+    delete sessions[i];
+    delete emulators[i];
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+// Measures the CPU time of each shown frame with run-ahead 0 to 3, done as
+// System does it: the real emulator draws nothing, and a fork catches up with
+// it each frame by ForkFrom, then runs ahead drawing only its last frame.
+// Pass a ROM to run it rather than the built in loop.
+
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "emulator.h"
+#include "ppu.h"
+#include "test_roms.h"
+
+const int BENCHMARK_FRAMES = 600;
+
+// Returns microseconds per shown frame.
+double MicrosecondsPerFrame(const std::vector<uint8_t> &rom, EmulatorOptions options,
+                            int run_ahead) {
+  Emulator *emulator = Emulator::Create(rom.data(), rom.size(), options);
+  emulator->RunFrames(60);
+  Emulator *ahead = nullptr;
+  if (run_ahead) {
+    emulator->ppu()->SetFrameSkip(INT_MAX);
+    ahead = emulator->Fork();
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+    emulator->SetInput(frame & 0xFF);
+    emulator->RunFrame();
+    if (ahead) {
+      ahead->ForkFrom(*emulator);
+      ahead->ppu()->SkipNextFrames(run_ahead - 1);
+      ahead->RunFrames(run_ahead);
+    }
+  }
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  delete ahead;
+  delete emulator;
+  return 1e6 * elapsed.count() / BENCHMARK_FRAMES;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<uint8_t> rom = LoopROM();
+  if (argc > 1) {
+    std::ifstream file(argv[1], std::ios::binary);
+    rom.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  EmulatorOptions options;
+  options.audio_buffer_ms = 0;
+  options.rtc_time = 1;
+  Emulator *probe = Emulator::Create(rom.data(), rom.size(), options);
+  if (!probe) {
+    std::cerr << "Unsupported ROM" << std::endl;
+    return 1;
+  }
+  delete probe;
+  double base = MicrosecondsPerFrame(rom, options, 0);
+  std::cerr << "run-ahead 0: " << base << " us/frame" << std::endl;
+  for (int run_ahead = 1; run_ahead <= 3; run_ahead++) {
+    double cost = MicrosecondsPerFrame(rom, options, run_ahead);
+    std::cerr << "run-ahead " << run_ahead << ": " << cost << " us/frame, " << cost / base
+              << "x" << std::endl;
+  }
+  return 0;
+}
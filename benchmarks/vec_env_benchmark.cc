@@ -0,0 +1,58 @@
+// Measures VecEnv steps per second, with and without observations, using the
+// default options. Pass a ROM to run it rather than the built in loop.
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "test_roms.h"
+#include "vec_env.h"
+
+const int ENVS = 16;
+const int BENCHMARK_STEPS = 50;
+
+double StepsPerSecond(VecEnv *env, bool observe) {
+  std::vector<uint8_t> actions(env->envs());
+  std::vector<uint8_t> observations(env->envs() * env->observation_size());
+  std::vector<uint8_t> ram(env->envs() * VEC_ENV_RAM_SIZE);
+  env->Reset(observations.data(), ram.data());
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int step = 0; step < BENCHMARK_STEPS; step++) {
+    for (int i = 0; i < env->envs(); i++) {
+      actions[i] = (step + i) & 0xFF;
+    }
+    env->Step(actions.data(), observe ? observations.data() : nullptr, ram.data());
+  }
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  return env->envs() * BENCHMARK_STEPS / elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<uint8_t> rom = LoopROM();
+  if (argc > 1) {
+    std::ifstream file(argv[1], std::ios::binary);
+    rom.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  EmulatorOptions emulator_options;
+  emulator_options.audio_buffer_ms = 0;
+  emulator_options.rtc_time = 1;
+  for (int threads : {1, 0}) {
+    VecEnvOptions options;
+    options.threads = threads;
+    VecEnv *env = VecEnv::Create(rom.data(), rom.size(), ENVS, options, emulator_options);
+    if (!env) {
+      std::cerr << "Unsupported ROM" << std::endl;
+      return 1;
+    }
+    double observed = StepsPerSecond(env, true);
+    double ram_only = StepsPerSecond(env, false);
+    std::cerr << ENVS << " envs, " << (threads ? "1 thread" : "all threads") << ": "
+              << observed << " steps/s observed, " << ram_only << " steps/s RAM only ("
+              << options.action_repeat << " frames a step)" << std::endl;
+    delete env;
+  }
+  return 0;
+}
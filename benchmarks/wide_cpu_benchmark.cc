@@ -0,0 +1,74 @@
+// Measures WideCPU against the same number of emulators run one after
+// another, in total frames per second over every lane. Pass a ROM to run it
+// rather than the built in loop. All lanes get the same input, so how far
+// they stay together depends only on the ROM.
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "emulator.h"
+#include "test_roms.h"
+#include "wide_cpu.h"
+
+const int BENCHMARK_FRAMES = 60;
+const int LANE_COUNTS[] = {1, 8, 64, 256};
+
+double ScalarFramesPerSecond(const std::vector<uint8_t> &rom, int lanes,
+                             EmulatorOptions options) {
+  std::vector<Emulator *> emulators;
+  for (int i = 0; i < lanes; i++) {
+    emulators.push_back(Emulator::Create(rom.data(), rom.size(), options));
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  for (Emulator *emulator : emulators) {
+    emulator->RunFrames(BENCHMARK_FRAMES);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  for (Emulator *emulator : emulators) {
+    delete emulator;
+  }
+  return lanes * BENCHMARK_FRAMES / elapsed.count();
+}
+
+double WideFramesPerSecond(const std::vector<uint8_t> &rom, int lanes, EmulatorOptions options,
+                           double &wide_fraction) {
+  WideCPU *wide_cpu = WideCPU::Create(rom.data(), rom.size(), lanes, options);
+  auto start = std::chrono::high_resolution_clock::now();
+  wide_cpu->RunFrames(BENCHMARK_FRAMES);
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  wide_fraction = (double)wide_cpu->wide_steps() /
+                  (wide_cpu->wide_steps() + wide_cpu->scalar_steps());
+  delete wide_cpu;
+  return lanes * BENCHMARK_FRAMES / elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<uint8_t> rom = ArithmeticROM();
+  if (argc > 1) {
+    std::ifstream file(argv[1], std::ios::binary);
+    rom.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  EmulatorOptions options;
+  options.audio_buffer_ms = 0;
+  options.rtc_time = 1;
+  Emulator *check = Emulator::Create(rom.data(), rom.size(), options);
+  if (!check) {
+    std::cerr << "Unsupported ROM" << std::endl;
+    return 1;
+  }
+  delete check;
+
+  for (int lanes : LANE_COUNTS) {
+    double scalar_fps = ScalarFramesPerSecond(rom, lanes, options);
+    double wide_fraction;
+    double wide_fps = WideFramesPerSecond(rom, lanes, options, wide_fraction);
+    std::cerr << lanes << " lanes: scalar " << scalar_fps << " frames/s, wide " << wide_fps
+              << " frames/s (" << wide_fps / scalar_fps << "x, " << wide_fraction * 100
+              << "% of instructions wide)" << std::endl;
+  }
+  return 0;
+}
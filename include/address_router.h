@@ -6,6 +6,7 @@ using namespace std;
 
 class InputController;
 class InterruptController;
+class Logger;
 class MMU;
 class PPU;
 class SerialController;
@@ -39,15 +40,22 @@ class AddressRouter {
 
   uint8_t GetByteAt(uint16_t address);
   void SetByteAt(uint16_t address, uint8_t byte);
+  // Reads as save states do, giving 0xFF for IO registers and unmapped
+  // addresses, so any address can be read from outside without side effects.
+  uint8_t PeekByteAt(uint16_t address);
 
   uint16_t GetWordAt(uint16_t address);
   void SetWordAt(uint16_t address, uint16_t word);
 
   void EnableDisassemblerMode(bool disassemblerMode);
+  // Unexpected accesses go to logger, if set.
+  void SetLogger(Logger *logger) { logger_ = logger; }
 
   void SaveState(struct DeviceMemorySaveState &state);
   void LoadState(const struct DeviceMemorySaveState &state);
   void SkipBootROM();
+  // Takes on other's DMA state. The devices fork themselves.
+  void ForkFrom(AddressRouter &other);
  private:
   MMU* mmu_;
   PPU* ppu_;
@@ -56,6 +64,7 @@ class AddressRouter {
   SerialController* serial_controller_;
   SoundController* sound_controller_;
   TimerController* timer_controller_;
+  Logger *logger_ = nullptr;
 
   bool disassemblerMode_ = false;
   uint8_t dma_base_ = 0x00;
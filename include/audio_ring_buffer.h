@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer, single consumer ring of int16 audio values, which
+// SDLAudioSink fills with interleaved stereo, AUDIO_CHANNELS values a sample.
+// Counts and capacities below are in values. The emulation thread writes and
+// the audio callback reads.
+class AudioRingBuffer {
+ public:
+  // Holds at least capacity samples.
+  explicit AudioRingBuffer(int capacity);
+  ~AudioRingBuffer();
+
+  // Producer only. Samples that don't fit are dropped and counted as an
+  // overrun. Returns how many were written.
+  int Write(const int16_t *samples, int count);
+
+  // Consumer only. If fewer than count samples are buffered, the rest of
+  // samples is filled with silence and counted as an underrun. Returns how
+  // many buffered samples were read.
+  int Read(int16_t *samples, int count);
+
+  // Samples buffered at the time of the call.
+  int Available() const;
+  int capacity() const { return capacity_; }
+
+  // How many Write and Read calls were short.
+  uint64_t overruns() const { return overruns_; }
+  uint64_t underruns() const { return underruns_; }
+
+ private:
+  int16_t *samples_;
+  int capacity_;
+  uint32_t mask_;
+
+  // Free running positions, on their own cache lines so the two threads
+  // don't share one.
+  alignas(64) std::atomic<uint32_t> write_pos_;
+  alignas(64) std::atomic<uint32_t> read_pos_;
+
+  alignas(64) std::atomic<uint64_t> overruns_;
+  std::atomic<uint64_t> underruns_;
+};
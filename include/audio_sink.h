@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+
+#include "audio_ring_buffer.h"
+#include "constants.h"
+
+// Receives stereo samples from the SoundController, at the rate the sink asks
+// for.
+class AudioSink {
+ public:
+  virtual ~AudioSink() = default;
+
+  // Samples per second the sink plays, so audio is made at the device's rate
+  // rather than resampled.
+  virtual int sample_rate() { return DEFAULT_SAMPLE_RATE; }
+
+  // samples holds count interleaved left, right pairs.
+  virtual void QueueSamples(const int16_t *samples, int count) = 0;
+
+  // Times the device ran out of samples, and times samples were dropped
+  // because the device fell behind.
+  virtual uint64_t underruns() { return 0; }
+  virtual uint64_t overruns() { return 0; }
+
+  // Samples queued but not yet played, and how many the sink would like
+  // queued. -1 if the sink isn't driven by a device clock.
+  virtual int BufferedSamples() { return -1; }
+  virtual int TargetBufferedSamples() { return -1; }
+};
+
+// Drops samples, for running without an audio device.
+class HeadlessAudioSink : public AudioSink {
+ public:
+  explicit HeadlessAudioSink(int sample_rate = DEFAULT_SAMPLE_RATE) : sample_rate_(sample_rate) {}
+
+  int sample_rate() override { return sample_rate_; }
+
+  void QueueSamples(const int16_t *, int count) override { samples_queued_ += count; }
+
+  long long samples_queued() { return samples_queued_; }
+
+ private:
+  int sample_rate_;
+  long long samples_queued_ = 0;
+};
+
+// Keeps samples until they are read, for hosts that pull audio rather than
+// having it pushed to a device. Samples that don't fit are dropped.
+class BufferingAudioSink : public AudioSink {
+ public:
+  // Holds at least capacity stereo samples.
+  BufferingAudioSink(int sample_rate, int capacity)
+      : sample_rate_(sample_rate), ring_(capacity * AUDIO_CHANNELS) {}
+
+  int sample_rate() override { return sample_rate_; }
+
+  void QueueSamples(const int16_t *samples, int count) override {
+    ring_.Write(samples, count * AUDIO_CHANNELS);
+  }
+
+  // Reads up to max_count buffered stereo samples, returning how many were
+  // read.
+  int ReadSamples(int16_t *samples, int max_count) {
+    int count = available();
+    if (count > max_count) {
+      count = max_count;
+    }
+    return ring_.Read(samples, count * AUDIO_CHANNELS) / AUDIO_CHANNELS;
+  }
+
+  // Stereo samples waiting to be read.
+  int available() { return ring_.Available() / AUDIO_CHANNELS; }
+  uint64_t overruns() override { return ring_.overruns(); }
+
+ private:
+  int sample_rate_;
+  AudioRingBuffer ring_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// One line of an edge_batch manifest.
+struct BatchJob {
+  string rom_path;
+  // Snapshot to start from, or empty to start from power on.
+  string state_path;
+  // Input script, or empty to press nothing.
+  string input_path;
+  int frames = 0;
+};
+
+// From this frame on, buttons (Button bits) are held.
+struct InputEvent {
+  int64_t frame;
+  uint8_t buttons;
+};
+
+struct BatchResult {
+  // Empty if the job ran.
+  string error;
+  uint64_t frame_hash = 0;
+  vector<uint8_t> snapshot;
+  string serial_output;
+  // What the emulator logged, a line each.
+  string log;
+  double seconds = 0;
+};
+
+// Manifest lines are "rom state input frames", with "-" for no state or no
+// input. Blank lines and lines starting with # are skipped. Relative paths
+// are taken from base_dir. Returns false and sets error on a malformed line.
+bool ReadManifest(istream &in, const string &base_dir, vector<BatchJob> &jobs,
+                  string &error);
+
+// Input script lines are "frame buttons", e.g. "120 0x80" to hold Start from
+// frame 120, in frame order. Blank lines and lines starting with # are
+// skipped.
+bool ReadInputScript(istream &in, vector<InputEvent> &events, string &error);
+
+// Loads and runs one job on the calling thread.
+BatchResult RunBatchJob(const BatchJob &job, int64_t rtc_time);
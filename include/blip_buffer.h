@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+
+// Band-limited stereo synthesis buffer. Voices add amplitude changes (deltas)
+// at the clock cycle they happen. Each delta is spread over nearby output
+// samples as a windowed-sinc step, so waveforms don't alias however fast they
+// change, and a voice only costs work when its output changes. Ending a frame
+// makes the samples up to that point readable. Left and right are kept
+// interleaved, so a delta to both sides is one pass over the kernel.
+class BlipBuffer {
+ public:
+  // Sizes the buffer for frames of up to max_samples output samples.
+  explicit BlipBuffer(int max_samples);
+  ~BlipBuffer();
+
+  // Clock cycles per second in, samples per second out. Takes effect at the
+  // next EndFrame, so deltas within a frame stay consistent.
+  void SetRates(double clock_rate, double sample_rate);
+
+  // Adds deltas to the left and right outputs from time cycles after the
+  // frame start.
+  void AddDelta(int time, int left, int right);
+  void AddDelta(int time, int delta) { AddDelta(time, delta, delta); }
+
+  // Ends the current frame duration cycles after it started. Later deltas are
+  // relative to the new frame.
+  void EndFrame(int duration);
+
+  // Stereo samples, each a left and right value.
+  int SamplesAvailable() const { return (int)(offset_ >> FRAC_BITS); }
+
+  // Reads up to count stereo samples into out as interleaved left, right
+  // pairs. Returns how many were read.
+  int ReadSamples(int16_t *out, int count);
+
+  void Clear();
+
+  // Takes on other's unread samples, filter state and rates. other must have
+  // been made with the same max_samples.
+  void CopyFrom(const BlipBuffer &other);
+
+ private:
+  static const int FRAC_BITS = 32;
+  static const int PHASE_BITS = 5;
+  static const int PHASES = 1 << PHASE_BITS;
+  static const int INTERP_BITS = 15;
+  // Samples each step is spread over.
+  static const int WIDTH = 16;
+  static const int KERNEL_BITS = 14;
+
+  // Windowed-sinc impulse for each sub-sample phase, each row summing to
+  // 1 << KERNEL_BITS.
+  static int16_t kernel_[PHASES + 1][WIDTH];
+  static void InitKernel();
+
+  // Interleaved left, right sums of kernel steps.
+  int32_t *samples_;
+  int size_;
+  // Output samples per clock cycle, and position of the frame start, in
+  // 32.32 fixed point.
+  uint64_t factor_ = 0;
+  uint64_t next_factor_ = 0;
+  uint64_t offset_ = 0;
+  int64_t integrator_[2] = {0, 0};
+  // Slowly bleeds off DC, like the output capacitor. Each sample loses
+  // 1 / 2^bass_shift_ of the level, so the shift grows with the sample rate.
+  int bass_shift_ = 9;
+};
+
+// One voice's output into a BlipBuffer, panned by a level out of 8 for each
+// side. Only changes in the scaled output become deltas.
+class BlipOutput {
+ public:
+  // 0 mutes a side, 8 is full volume.
+  void SetLevels(int left, int right) {
+    left_level_ = left;
+    right_level_ = right;
+  }
+
+  bool Silent() const { return left_level_ == 0 && right_level_ == 0; }
+
+  // Changes the output to amplitude from time.
+  void Update(BlipBuffer *buffer, int time, int amplitude) {
+    int left = amplitude * left_level_ / 8;
+    int right = amplitude * right_level_ / 8;
+    if (left != left_ || right != right_) {
+      buffer->AddDelta(time, left - left_, right - right_);
+      left_ = left;
+      right_ = right;
+    }
+  }
+
+ private:
+  int left_level_ = 8;
+  int right_level_ = 8;
+  // Output last added to the buffer.
+  int left_ = 0;
+  int right_ = 0;
+};
@@ -1,13 +1,18 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <time.h>
+#include <vector>
 
+#include "paged_memory.h"
 #include "state.h"
 
 using namespace std;
 
+class Logger;
+
 enum CartridgeType {
   CartridgeType_ROM_only = 0x00,
   CartridgeType_ROM_MBC1 = 0x01,
@@ -47,12 +52,22 @@ uint8_t *UnsignedCartridgeBytes(string filename);
 class Cartridge {
  public:
   Cartridge(string filename);
+  // Copies size bytes of ROM, e.g. from memory rather than a file.
+  Cartridge(const uint8_t *rom, size_t size);
   ~Cartridge();
 
+  // A copy that shares this cartridge's ROM, and its RAM until either writes.
+  Cartridge *Fork();
+  // Takes on the RAM and clock of other, a fork of this cartridge or its
+  // original.
+  void ForkFrom(Cartridge &other);
+
   bool LoadFile(string filename);
   void PrintDebugInfo();
 
   uint8_t GetROMByteAt(int address);
+  // FNV-1a over the ROM, worked out on first use and shared with forks.
+  uint64_t ROMHash();
 
   CartridgeType GetCartridgeType();
 
@@ -85,11 +100,24 @@ class Cartridge {
   time_t GetRTCSessionStartTime() const { return rtc_session_start_time_; }
   time_t GetRTCTimeOverride() const { return rtc_current_time_override_; }
 
+  // Unsupported headers and clock register use go to logger, if set.
+  void SetLogger(Logger *logger) { logger_ = logger; }
+
   void SetState(const struct CartridgeSaveState &state);
+  // state.ram points at a copy of the RAM, valid until the next GetState.
   void GetState(struct CartridgeSaveState& state);
 
  private:
+  // Takes ownership of rom, which was allocated with new[].
+  explicit Cartridge(uint8_t *rom);
+  explicit Cartridge(shared_ptr<uint8_t> rom);
+
+  // Owns rom_, which forks share.
+  shared_ptr<uint8_t> shared_rom_;
   uint8_t *rom_;
+  // 0 until ROMHash works it out.
+  uint64_t rom_hash_;
+  Logger *logger_ = nullptr;
   bool HasRTC();
   bool HasBattery();
 
@@ -100,7 +128,9 @@ class Cartridge {
   bool rtc_latched_;
   time_t rtc_latched_time_;
 
-  uint8_t *ram_;
+  PagedMemory *ram_;
+  // GetState's copy of ram_.
+  vector<uint8_t> ram_copy_;
   uint8_t GetRAM(int address);
   void SetRAM(int address, uint8_t byte);
   int GetBankedRAMAddress(int address);
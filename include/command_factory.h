@@ -15,7 +15,7 @@ class MMU;
 class AbstractCommandFactory {
  public:
   AbstractCommandFactory();
-  virtual ~AbstractCommandFactory() = default;
+  virtual ~AbstractCommandFactory();
   Command *CommandForOpcode(uint8_t opcode);
   void RegisterCommand(Command *command);
 
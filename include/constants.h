@@ -4,10 +4,19 @@ const int CYCLES_PER_SECOND = 4194304;
 
 const int CYCLES_PER_FRAME = 70224;
 
-// Audio Sample Rate.
-const int SAMPLE_RATE = 44000;
-
-const int CYCLES_PER_SAMPLE = CYCLES_PER_SECOND / SAMPLE_RATE;
+// Audio sample rate, unless the output device asks for another.
+const int DEFAULT_SAMPLE_RATE = 48000;
+// Most samples per second an output device is asked for.
+const int MAX_SAMPLE_RATE = 192000;
+// The APU's own output rate, one sample per 4 cycles.
+const int NATIVE_SAMPLE_RATE = CYCLES_PER_SECOND / 4;
+const int AUDIO_CHANNELS = 2;
+
+
+// Audio buffered ahead of the output device.
+const int DEFAULT_AUDIO_LATENCY_MS = 50;
+// Most audio that may be buffered ahead of the output device.
+const int MAX_AUDIO_LATENCY_MS = 1000;
 
 const int CYCLES_PER_SOUND_TIMER_TICK = CYCLES_PER_SECOND / 256;
 
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Emulator;
+
+using namespace std;
+
+// Binary protocol of the control socket. Every request and response is an
+// 8 byte header followed by length bytes of payload, little endian. Clients
+// may send any number of requests without waiting; responses come back in
+// request order, one per request.
+struct ControlHeader {
+  uint8_t op;
+  // In responses, a ControlStatus. 0 in requests.
+  uint8_t status;
+  uint16_t reserved;
+  uint32_t length;
+};
+static_assert(sizeof(ControlHeader) == 8, "ControlHeader must be packed");
+
+enum ControlOp : uint8_t {
+  // uint32 frames -> uint64 frame count, uint64 frame hash. 0 frames just
+  // reports them.
+  ControlOp_Step = 1,
+  // uint8 Button bits -> nothing.
+  ControlOp_SetInput = 2,
+  // nothing -> Emulator::Snapshot bytes.
+  ControlOp_Snapshot = 3,
+  // snapshot bytes -> nothing.
+  ControlOp_Restore = 4,
+  // uint16 address, uint16 count -> count bytes from the address bus, with
+  // 0 meaning 0x10000.
+  ControlOp_ReadMemory = 5,
+  // nothing -> SCREEN_PIXELS ARGB uint32 pixels.
+  ControlOp_Framebuffer = 6,
+};
+
+enum ControlStatus : uint8_t {
+  ControlStatus_OK = 0,
+  ControlStatus_UnknownOp = 1,
+  ControlStatus_BadPayload = 2,
+  ControlStatus_RestoreFailed = 3,
+};
+
+// Requests with more payload than this close the connection.
+const uint32_t MAX_CONTROL_PAYLOAD = 1 << 24;
+
+// Runs frames for a ControlServer, so its host can do its own per frame work,
+// e.g. System's save state history.
+class FrameStepper {
+ public:
+  virtual ~FrameStepper() = default;
+  virtual void StepFrame() = 0;
+};
+
+// Serves the control protocol on a Unix domain socket, so tools can drive
+// emulator processes without a GUI. Nothing happens on its own thread: the
+// host calls Poll between frames, which answers every request that has
+// arrived in full, writing the responses back in one go. So running an
+// instance with a server costs nothing per instruction.
+class ControlServer {
+ public:
+  // Listens at path, replacing any socket file already there. Returns
+  // nullptr if it can't. Frames are run with stepper, or with
+  // emulator->RunFrame() if it's null.
+  static ControlServer *Create(const string &path, Emulator *emulator,
+                               FrameStepper *stepper = nullptr);
+  // Closes every connection and removes the socket file.
+  ~ControlServer();
+
+  // Accepts connections and serves requests. Waits up to timeout_ms for
+  // something to happen first, forever if -1. Returns how many requests
+  // were served.
+  int Poll(int timeout_ms);
+
+  int connections() { return (int)clients_.size(); }
+
+ private:
+  struct Client {
+    int fd;
+    vector<uint8_t> in;
+    vector<uint8_t> out;
+    // Bytes of out already written.
+    size_t out_offset = 0;
+  };
+
+  ControlServer(const string &path, int listen_fd, Emulator *emulator, FrameStepper *stepper);
+
+  void Accept();
+  // Returns false if the client should be dropped.
+  bool Read(Client &client);
+  bool Write(Client &client);
+  // Serves every whole request in client.in, returning how many.
+  int Serve(Client &client);
+  void Respond(Client &client, uint8_t op, uint8_t status, const void *payload, size_t size);
+  void Execute(Client &client, uint8_t op, const uint8_t *payload, uint32_t size);
+
+  string path_;
+  int listen_fd_;
+  Emulator *emulator_;
+  FrameStepper *stepper_;
+  vector<Client> clients_;
+};
@@ -21,6 +21,7 @@ struct flags_t {
 
 class AddressRouter;
 class InterruptController;
+class Logger;
 
 class CPU : public InterruptExecutor {
  private:
@@ -28,6 +29,7 @@ class CPU : public InterruptExecutor {
   CommandFactory *commandFactory_;
   CBCommandFactory *cbCommandFactory_;
   InterruptController *interrupt_controller_;
+  Logger *logger_ = nullptr;
   Command *CommandForOpcode(uint8_t opcode);
 
   uint8_t a_, b_, c_, d_, e_, h_, l_ = 0;
@@ -90,16 +92,23 @@ class CPU : public InterruptExecutor {
   // Special Actions.
   void HaltNextLoop() { haltNextLoop_ = true; };
   void StopNextLoop() { stopNextLoop_ = true; };
+  // A HALT or STOP ran, and takes effect on the next Step.
+  bool halt_or_stop_pending() { return haltNextLoop_ || stopNextLoop_; };
   void DisableInterrupts();
   void EnableInterrupts();
 
   void SetState(const struct CPUSaveState &state);
   void GetState(CPUSaveState& state);
+  // Takes on other's registers, and any halt or stop it has pending.
+  void ForkFrom(CPU &other);
   void SkipBootROM();
 
   void SetDebugPrint(bool debugPrint) { debugPrint_ = debugPrint; };
 
   void SetInterruptController(InterruptController *interrupt_controller);
+  // Unsupported instructions and odd register use go to logger, if set.
+  void SetLogger(Logger *logger) { logger_ = logger; }
+  Logger *logger() { return logger_; }
 
   uint64_t Cycles() { return cycles_; };
 
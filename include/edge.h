@@ -0,0 +1,76 @@
+#pragma once
+
+// C interface to the emulator core, for embedding it in other languages and
+// hosts. Each edge_emulator is independent, and may be run on any thread, one
+// thread at a time.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct edge_emulator edge_emulator;
+
+#define EDGE_SCREEN_WIDTH 160
+#define EDGE_SCREEN_HEIGHT 144
+
+// Bits of the mask passed to edge_set_input. A set bit is held down.
+#define EDGE_BUTTON_RIGHT 0x01
+#define EDGE_BUTTON_LEFT 0x02
+#define EDGE_BUTTON_UP 0x04
+#define EDGE_BUTTON_DOWN 0x08
+#define EDGE_BUTTON_A 0x10
+#define EDGE_BUTTON_B 0x20
+#define EDGE_BUTTON_SELECT 0x40
+#define EDGE_BUTTON_START 0x80
+
+typedef struct edge_options {
+  // Audio samples per second.
+  int sample_rate;
+  // Non-zero to render audio at the APU's native rate and resample it.
+  int resample;
+  // Audio kept for edge_audio, or 0 to drop audio.
+  int audio_buffer_ms;
+  // Pins the cartridge clock to this many seconds since the epoch, or 0 to
+  // follow the host's clock.
+  int64_t rtc_time;
+} edge_options;
+
+// Fills options with the defaults.
+void edge_default_options(edge_options *options);
+
+// Copies size bytes of ROM. options may be NULL for the defaults. Returns NULL
+// if the ROM isn't a supported cartridge or options are out of range.
+edge_emulator *edge_create(const uint8_t *rom, size_t size, const edge_options *options);
+void edge_destroy(edge_emulator *emulator);
+
+void edge_run_frames(edge_emulator *emulator, int count);
+
+// Buttons held from now on, as EDGE_BUTTON_ bits.
+void edge_set_input(edge_emulator *emulator, uint8_t buttons);
+
+// The newest finished frame, EDGE_SCREEN_WIDTH x EDGE_SCREEN_HEIGHT ARGB
+// pixels. Valid until the next edge_run_frames.
+const uint32_t *edge_framebuffer(edge_emulator *emulator);
+
+// Reads up to max_samples buffered stereo samples into samples as interleaved
+// left, right pairs, returning how many were read.
+int edge_audio(edge_emulator *emulator, int16_t *samples, int max_samples);
+
+// Writes a snapshot to data if it has room for size bytes. Returns the
+// snapshot's size either way, so data may be NULL to find the size.
+size_t edge_snapshot(edge_emulator *emulator, uint8_t *data, size_t size);
+// Returns 1 if data was restored, or 0 if it isn't a snapshot of this ROM.
+int edge_restore(edge_emulator *emulator, const uint8_t *data, size_t size);
+
+// Frames run since creation.
+int64_t edge_frame_count(edge_emulator *emulator);
+// Everything the game has sent over the serial port, NUL terminated. Valid
+// until the next edge_run_frames.
+const char *edge_serial_output(edge_emulator *emulator);
+
+#ifdef __cplusplus
+}
+#endif
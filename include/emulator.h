@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "logger.h"
+#include "state.h"
+
+class AddressRouter;
+class AudioSink;
+class BufferingAudioSink;
+class Cartridge;
+class CPU;
+class InputController;
+class InterruptController;
+class MMU;
+class PPU;
+class Screen;
+class SerialController;
+class SoundController;
+class TimerController;
+class VideoSink;
+
+using namespace std;
+
+// Bits of the mask passed to Emulator::SetInput. A set bit is held down.
+enum Button : uint8_t {
+  Button_Right = 0x01,
+  Button_Left = 0x02,
+  Button_Up = 0x04,
+  Button_Down = 0x08,
+  Button_A = 0x10,
+  Button_B = 0x20,
+  Button_Select = 0x40,
+  Button_Start = 0x80,
+};
+
+struct EmulatorOptions {
+  // Samples per second of the emulator's own audio buffer, when it isn't
+  // given an audio sink.
+  int sample_rate = DEFAULT_SAMPLE_RATE;
+  // Render audio at NATIVE_SAMPLE_RATE and resample it to the output rate.
+  bool resample = false;
+  // Audio kept for ReadAudio, or 0 to drop audio.
+  int audio_buffer_ms = 200;
+  // Pins the cartridge clock to this many seconds since the epoch, so runs
+  // repeat exactly. 0 follows the host's clock.
+  int64_t rtc_time = 0;
+  // Also print serial output to stdout.
+  bool echo_serial = false;
+  // If set, gets a line for each thing the game does that the emulator
+  // doesn't expect or support, e.g. writes to read only memory. Called on the
+  // thread running the emulator. Forks share it, so it must be thread safe if
+  // they run on other threads.
+  Logger::Callback log;
+};
+
+// One Game Boy: the cartridge, CPU, PPU and controllers, run a frame at a
+// time. It has no globals, and does no host I/O beyond the sinks and log it
+// is given and echo_serial, so any number can run in one process, each on one
+// thread at a time.
+class Emulator {
+ public:
+  // Takes ownership of cartridge. Frames go to video_sink and audio to
+  // audio_sink if given, otherwise frames are only kept for framebuffer() and
+  // audio for ReadAudio(). The sinks must outlive the Emulator.
+  Emulator(Cartridge *cartridge, EmulatorOptions options = EmulatorOptions(),
+           VideoSink *video_sink = nullptr, AudioSink *audio_sink = nullptr);
+  ~Emulator();
+
+  // Copies size bytes of ROM. Returns nullptr if it isn't a cartridge this
+  // emulator supports, or options are out of range.
+  static Emulator *Create(const uint8_t *rom, size_t size, EmulatorOptions options = EmulatorOptions());
+
+  // Runs until the PPU enters VBlank, then renders the frame's audio.
+  void RunFrame();
+  void RunFrames(int count);
+  // Runs until cycles() reaches cycle, the frame ends, or the serial port
+  // starts a transfer or begins listening, for a LinkCable to look at.
+  // Returns true if the frame ended.
+  bool RunUntil(int64_t cycle);
+
+  // RunFrame in parts, for cores that run the CPU themselves. Advances
+  // everything but the CPU by the cycles it just ran, and dispatches
+  // interrupts, returning true when the PPU enters VBlank. EndFrame must
+  // follow.
+  bool AdvanceDevices(int cycles);
+  // Renders the frame's audio and starts the next.
+  void EndFrame();
+
+  // Buttons held from now on, as Button bits.
+  void SetInput(uint8_t buttons);
+  uint8_t input() { return input_; }
+
+  // The newest finished frame, SCREEN_WIDTH x SCREEN_HEIGHT ARGB pixels. Valid
+  // until the next RunFrame.
+  const uint32_t *framebuffer();
+  // FNV-1a over framebuffer(), for comparing runs.
+  uint64_t FrameHash();
+
+  // While muted, frames run as usual but their audio is dropped, e.g. when
+  // running again frames whose audio was already played.
+  void SetAudioMuted(bool muted);
+
+  // Reads up to max_samples buffered stereo samples into samples as
+  // interleaved left, right pairs, returning how many were read.
+  int ReadAudio(int16_t *samples, int max_samples);
+
+  // Registers, memory and cartridge RAM, as save states hold them, plus the
+  // timer. Only valid for the same ROM and build. Sound is restored from its
+  // registers, so audio may differ briefly after a Restore.
+  vector<uint8_t> Snapshot();
+  // Returns false, leaving the emulator untouched, if data isn't a snapshot
+  // of this cartridge.
+  bool Restore(const uint8_t *data, size_t size);
+
+  // A new emulator in this one's exact state, for trying several inputs from
+  // one point, e.g. in a tree search. It shares the ROM, and memory pages
+  // copy-on-write, so it costs little beyond the pages either one changes
+  // afterwards. Exact between frames. The fork sends frames and audio to the
+  // sinks given, or has its own buffers for them, and starts with a copy of
+  // this one's framebuffer().
+  Emulator *Fork(VideoSink *video_sink = nullptr, AudioSink *audio_sink = nullptr);
+  // Puts this emulator, a fork of other or the other way round, back into
+  // other's exact state, keeping its own sinks. Cheaper than a Fork or a
+  // Restore, so one fork can be reused to look ahead every frame.
+  void ForkFrom(Emulator &other);
+
+  // As above, for StateController's save state files. save_state.cartridge.ram
+  // points at a copy of the cartridge RAM, valid until the next GetState. SetState leaves the timer to be restored
+  // through memory, since save state files don't hold its counters.
+  void GetState(struct SaveState &save_state);
+  void SetState(const struct SaveState &save_state);
+
+  // Frames run since creation.
+  int64_t frame_count() { return frame_count_; }
+  // CPU cycles run since creation.
+  int64_t cycles() { return cycles_; }
+  // Everything the game has sent over the serial port.
+  const string &serial_output();
+  // Whether it's also printed to stdout, as options.echo_serial.
+  void SetSerialEcho(bool echo);
+
+  Cartridge *cartridge() { return cartridge_; }
+  CPU *cpu() { return cpu_; }
+  MMU *mmu() { return mmu_; }
+  AddressRouter *router() { return router_; }
+  InterruptController *interrupt_controller() { return interrupt_controller_; }
+  PPU *ppu() { return ppu_; }
+  Screen *screen() { return screen_; }
+  InputController *input_controller() { return input_controller_; }
+  SoundController *sound_controller() { return sound_controller_; }
+  SerialController *serial_controller() { return serial_controller_; }
+
+ private:
+  Cartridge *cartridge_;
+  MMU *mmu_;
+  CPU *cpu_;
+  PPU *ppu_;
+  AddressRouter *router_;
+  InputController *input_controller_;
+  InterruptController *interrupt_controller_;
+  SerialController *serial_controller_;
+  SoundController *sound_controller_;
+  TimerController *timer_controller_;
+  Screen *screen_;
+  EmulatorOptions options_;
+  // Made when options.log is set.
+  Logger *logger_ = nullptr;
+
+  // Sinks made for the emulator when none were given.
+  VideoSink *owned_video_sink_ = nullptr;
+  AudioSink *owned_audio_sink_ = nullptr;
+  BufferingAudioSink *buffering_sink_ = nullptr;
+  // Between the SoundController and the audio sink when resampling.
+  AudioSink *resampling_sink_ = nullptr;
+
+  uint8_t input_ = 0;
+  int64_t frame_count_ = 0;
+  // Cycles run in the current frame. The SoundController's clock.
+  int frame_cycles_ = 0;
+  // Cycles run since creation. The SerialController's clock.
+  int64_t cycles_ = 0;
+};
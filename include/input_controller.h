@@ -34,6 +34,13 @@ class InputController {
   void SetByteAt(uint16_t address, uint8_t byte);
   uint8_t GetByteAt(uint16_t);
 
+  // Buttons held, with right, left, up, down, A, B, select and start from bit
+  // 0 up, as Emulator's Button bits.
+  uint8_t held_buttons() { return ~((button_nibble_ << 4) | dpad_nibble_); }
+
+  // Takes on other's button and select state.
+  void ForkFrom(InputController &other);
+
   void SetScreenshotTaker(ScreenshotTaker *screenshot_taker) { screenshot_taker_ = screenshot_taker; }
   void SetStateNavigator(StateNavigator *state_navigator) { state_navigator_ = state_navigator; }
  private:
@@ -23,6 +23,7 @@ class InterruptExecutor {
 
 class InterruptHandler {
  public:
+  virtual ~InterruptHandler() = default;
   virtual void RequestInterrupt(Interrupt interrupt) = 0;
 };
 
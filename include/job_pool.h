@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Runs jobs on a fixed set of threads. Each thread works from the back of its
+// own queue, and once that is empty steals from the front of the others', so
+// jobs of uneven length still keep every thread busy.
+class JobPool {
+ public:
+  // threads <= 0 makes one thread per hardware thread. With pin, thread i only
+  // runs on CPU i, where the platform supports it.
+  explicit JobPool(int threads = 0, bool pin = false);
+  // Finishes the jobs already submitted.
+  ~JobPool();
+
+  void Submit(function<void()> job);
+  // Blocks until every submitted job has finished.
+  void Wait();
+
+  int thread_count() { return (int)threads_.size(); }
+
+ private:
+  struct Queue {
+    mutex lock;
+    deque<function<void()>> jobs;
+  };
+
+  void Work(int index, bool pin);
+  bool TakeJob(int index, function<void()> &job);
+
+  vector<Queue *> queues_;
+  vector<thread> threads_;
+
+  // Guards the counts below, and wakes idle threads and Wait.
+  mutex lock_;
+  condition_variable work_available_;
+  condition_variable all_done_;
+  // Jobs in queues, and jobs in queues or running.
+  int queued_ = 0;
+  int pending_ = 0;
+  int next_queue_ = 0;
+  bool stopping_ = false;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+class Emulator;
+
+using namespace std;
+
+// Joins the serial ports of two emulators in one process, for two player
+// games. Each runs on its own as long as neither's serial port is busy, so
+// while nothing is sent they run a frame at a time, as fast as one emulator
+// each. They only meet when a transfer could need the other end: whoever
+// clocks a transfer waits at its end, 8 bit times after it started, for the
+// other to get there, and then they swap bytes; and a port listening for the
+// other end's clock waits rather than run more than a byte's time ahead of
+// it. So transfers time and interrupt exactly as over a real cable.
+class LinkCable {
+ public:
+  // Connects a and b, which must outlive the cable.
+  LinkCable(Emulator *a, Emulator *b);
+  // Disconnects them, so transfers on the internal clock receive 0xFF again.
+  ~LinkCable();
+
+  // Runs a for a frame, and b until it is at least as far on.
+  void RunFrame();
+  void RunFrames(int count);
+
+  // Transfers completed, including those nobody listened to.
+  int64_t transfers() { return transfers_; }
+  // Times either emulator was run, two a frame while nothing is sent.
+  int64_t runs() { return runs_; }
+
+ private:
+  // How far emulator i may run before the other must catch up.
+  int64_t Limit(int i);
+  // Completes transfers both emulators have reached the end of.
+  void Exchange();
+
+  Emulator *emulators_[2];
+  int64_t transfers_ = 0;
+  int64_t runs_ = 0;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+// Where an Emulator's parts report what a game does that they don't expect
+// or don't support, e.g. writes to read only memory. Parts hold a Logger
+// pointer that is null unless EmulatorOptions::log is set, so unlogged lines
+// cost a branch:
+//   if (logger_) {
+//     logger_->Line() << "Unknown GetByte 0x" << hex << unsigned(address);
+//   }
+class Logger {
+ public:
+  typedef function<void(const string &line)> Callback;
+
+  // Collects one line, and logs it when it goes out of scope.
+  class LineStream {
+   public:
+    explicit LineStream(Logger *logger) : logger_(logger) {}
+    ~LineStream() { logger_->Log(line_.str()); }
+
+    template <typename T>
+    LineStream &operator<<(const T &value) {
+      line_ << value;
+      return *this;
+    }
+
+   private:
+    Logger *logger_;
+    ostringstream line_;
+  };
+
+  explicit Logger(Callback callback) : callback_(callback) {}
+
+  void Log(const string &line) { callback_(line); }
+  LineStream Line() { return LineStream(this); }
+
+ private:
+  Callback callback_;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "rollback_session.h"
+
+using namespace std;
+
+struct LoopbackOptions {
+  // Frames each input takes to arrive, plus up to jitter_frames more, chosen
+  // at random per input, so inputs can arrive out of order.
+  int latency_frames = 0;
+  int jitter_frames = 0;
+  uint32_t seed = 1;
+};
+
+// Two RollbackTransports joined in one process, for running both ends of a
+// RollbackSession side by side with a network's latency and jitter, but
+// repeatably. Time is counted in frames and only moves on with Tick.
+class LoopbackLink {
+ public:
+  explicit LoopbackLink(LoopbackOptions options = LoopbackOptions());
+
+  // End 0 or 1. Inputs sent from one arrive at the other.
+  RollbackTransport *end(int index) { return &ends_[index]; }
+
+  // Moves time on a frame, so inputs due by then can be received.
+  void Tick() { now_++; }
+
+ private:
+  struct InFlight {
+    int64_t arrival;
+    RollbackInput input;
+  };
+
+  class End : public RollbackTransport {
+   public:
+    void Send(const RollbackInput &input) override;
+    bool Receive(RollbackInput *input) override;
+
+    LoopbackLink *link;
+    End *peer;
+    // Sent to this end and not yet received, in order sent.
+    vector<InFlight> in_flight;
+  };
+
+  LoopbackOptions options_;
+  End ends_[2];
+  int64_t now_ = 0;
+  mt19937 random_;
+};
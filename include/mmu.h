@@ -3,6 +3,8 @@
 #include <string>
 
 #include "cartridge.h"
+#include "logger.h"
+#include "paged_memory.h"
 #include "state.h"
 
 using namespace std;
@@ -23,6 +25,8 @@ class MMU {
 
   void SetBootROM(uint8_t *bytes);
   void SetCartridge(Cartridge *cartridge);
+  // Unexpected reads and writes go to logger, if set.
+  void SetLogger(Logger *logger) { logger_ = logger; }
  
   // Hacks to simulate a disassembler.
   void EnableDisassemblerMode(bool disassemblerMode) {
@@ -31,8 +35,16 @@ class MMU {
 
   uint8_t rom_bank() { return rom_bank_; };
 
+  // Work RAM, WORK_RAM_START to WORK_RAM_END, and high RAM, HIGH_RAM_START to
+  // HIGH_RAM_END.
+  const PagedMemory &work_ram() { return *ram_; };
+  const uint8_t *high_ram() { return high_memory_; };
+
   void SetState(const struct MMUSaveState &state);
   void GetState(struct MMUSaveState& state);
+  // Takes on other's state, sharing its work RAM copy-on-write. Keeps this
+  // MMU's cartridge.
+  void ForkFrom(MMU &other);
 
  private:
   bool UseBootROMForAddress(uint16_t address);
@@ -45,13 +57,14 @@ class MMU {
 
   void LatchRTC();
 
-  uint8_t *ram_;
+  PagedMemory *ram_;
 
   bool disasembler_mode_ = false;
   bool overlay_boot_rom_;
 
   uint8_t *boot_rom_;
   Cartridge *cartridge_;
+  Logger *logger_ = nullptr;
   uint8_t rom_bank_ = 0x1;
   uint8_t *high_memory_;
 
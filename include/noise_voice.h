@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "blip_buffer.h"
 #include "constants.h"
 
 union SDL_Event;
@@ -21,9 +22,18 @@ class NoiseVoice {
   uint8_t GetFF22() { return ff22_; };
   uint8_t GetFF23() { return 0xBF | ff23_; };
 
-  int16_t GetSample();
-  // Adds this voice's samples to the buffer.
-  void AddSamplesToBuffer(int16_t* buffer, int samples);
+  // Adds this voice's output changes between start_time and end_time (cycles
+  // within the buffer's frame) to the buffer. The LFSR steps at its real rate,
+  // up to 524288 Hz.
+  void Run(int start_time, int end_time, BlipBuffer* buffer);
+
+  // Clocked by the frame sequencer at 256 and 64 Hz.
+  void ClockLength();
+  void ClockEnvelope();
+
+  // Output levels out of 8 for the left and right terminals, from panning and
+  // master volume. 0 mutes a side.
+  void SetOutputLevels(int left, int right) { output_.SetLevels(left, right); }
 
   bool Playing() { return enabled_; }
 
@@ -42,18 +52,24 @@ class NoiseVoice {
   bool SweepUp() { return (ff21_ & 0b1000) >> 3; }
   uint8_t SweepPace() { return ff21_ & 0b111; }
 
-  float FrequencyHz();
+  // The LFSR steps every 16 * divider << shift cycles, with divider 0 acting
+  // as 0.5.
+  int CyclesPerLFSR() { return (ClockDivider() ? ClockDivider() * 16 : 8) << ClockShift(); }
 
   bool enabled_ = false;
-  uint8_t ff20_, ff21_, ff22_, ff23_;
+  uint8_t ff20_ = 0, ff21_ = 0, ff22_ = 0, ff23_ = 0;
 
-  uint8_t length_;
-  uint16_t lfsr_; // https://en.wikipedia.org/wiki/Linear-feedback_shift_register
-  int volume_;
+  uint8_t length_ = 0;
+  uint16_t lfsr_ = 0; // https://en.wikipedia.org/wiki/Linear-feedback_shift_register
+  int volume_ = 0;
   bool length_enable_ = false;
-  
-  int timer_cycles_ = CYCLES_PER_SOUND_TIMER_TICK;
+
   int lsfr_cycles_ = 0;
-  int cycles_per_lfsr_ = 0;
-  int envelope_cycles_ = 0;
+  // Frame sequencer clocks until the next envelope step.
+  int envelope_timer_ = 0;
+  BlipOutput output_;
+  int Amplitude();
+  // Output for each volume and LFSR bit.
+  static int16_t amplitudes_[16][2];
+  static void InitAmplitudes();
 };
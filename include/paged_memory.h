@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+const int MEMORY_PAGE_SIZE = 256;
+
+// Zeroed memory kept in fixed size pages, which copies made with Share hold in
+// common until one of them writes to the page. So a copy costs a pointer per
+// page, and each copy only pays for the pages it changes. A page shared with
+// another thread's copy is never written in place, so copies can run on
+// different threads.
+class PagedMemory {
+ public:
+  explicit PagedMemory(size_t size);
+  ~PagedMemory() = default;
+
+  uint8_t Get(size_t offset) const {
+    return pages_[offset / MEMORY_PAGE_SIZE]->bytes[offset % MEMORY_PAGE_SIZE];
+  }
+  void Set(size_t offset, uint8_t byte) {
+    size_t page = offset / MEMORY_PAGE_SIZE;
+    if (!owned_[page]) {
+      // Writing what's already there doesn't need a page of its own.
+      if (Get(offset) == byte) {
+        return;
+      }
+      Own(page);
+    }
+    pages_[page]->bytes[offset % MEMORY_PAGE_SIZE] = byte;
+  }
+
+  void Read(size_t offset, uint8_t *to, size_t size) const;
+  void Write(size_t offset, const uint8_t *from, size_t size);
+
+  // Makes this a copy of other, which must be the same size, sharing all of
+  // its pages.
+  void Share(PagedMemory &other);
+
+  size_t size() const { return size_; }
+  // Pages this memory has copied for itself since it was last shared.
+  int owned_pages() const;
+
+ private:
+  struct Page {
+    uint8_t bytes[MEMORY_PAGE_SIZE];
+  };
+
+  // Makes page safe to write in place, copying it if another memory may
+  // hold it.
+  void Own(size_t page);
+
+  size_t size_;
+  vector<shared_ptr<Page>> pages_;
+  // Whether no other memory can reach each page.
+  vector<uint8_t> owned_;
+};
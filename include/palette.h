@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstdint>
+
+// Shades 3, 2, 1, 0 for colors 3, 2, 1, 0. Palettes start out as this until
+// the game sets them.
+const uint8_t DEFAULT_PALETTE = 0xE4;  // 11100100.
+
 enum Palette {
   SpritePalette0,
   SpritePalette1,
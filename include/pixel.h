@@ -4,8 +4,29 @@
 
 #include "palette.h"
 
-struct Pixel {
-  uint8_t two_bit_color_;
-  Palette palette_;
-  bool sprite_over_background_window_;
-};
+// Pixels are packed into a single byte so that 8 of them fit in a uint64_t:
+//   bits 0-1: two bit color.
+//   bits 2-3: palette.
+//   bit 4: sprite is drawn over the background / window.
+typedef uint8_t Pixel;
+
+// A row of 8 packed pixels, leftmost pixel in the lowest byte.
+typedef uint64_t PixelRow;
+
+const PixelRow PIXEL_ROW_LOW_BITS = 0x0101010101010101ULL;
+
+inline Pixel MakePixel(uint8_t two_bit_color, Palette palette,
+                       bool sprite_over_background_window) {
+  return (two_bit_color & 0x3) | (palette << 2) |
+         (sprite_over_background_window << 4);
+}
+
+inline uint8_t PixelColor(Pixel pixel) { return pixel & 0x3; }
+
+inline Palette PixelPalette(Pixel pixel) {
+  return (Palette)((pixel >> 2) & 0x3);
+}
+
+inline bool PixelSpriteOverBackgroundWindow(Pixel pixel) {
+  return (pixel >> 4) & 0x1;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <list>
 
 #include "palette.h"
@@ -18,18 +19,30 @@ enum FetchStrategy {
 };
 
 struct Fetch {
-  Pixel *pixels_;
+  PixelRow pixels_;
   int cycles_remaining_;
   // Whether we should overlay the front 8 pixels for a sprite.
   FetchStrategy strategy_;
   Sprite sprite_;
 };
 
+// Builds 8 packed pixels from a tile row, as returned by PPU::BackgroundTile.
+PixelRow MakePixelRow(uint16_t tile_row, Palette palette,
+                      bool sprite_over_background_window);
+
+// Blends a row of sprite pixels over the front 8 FIFO pixels, one byte lane
+// per pixel. Sprite pixels replace background / window pixels when they have
+// priority or the background is color 0, and replace transparent sprite
+// pixels.
+PixelRow OverlaySpritePixelRow(PixelRow fifo, PixelRow sprite);
+
 class PixelFIFO {
  private:
-  Pixel *fifo_;
+  // The 16 pixel FIFO is held as two shift registers. Pixels shift out of the
+  // low byte of the front register, and the back register shifts into it.
+  PixelRow fifo_front_ = 0;
+  PixelRow fifo_back_ = 0;
   int fifo_length_ = 0;
-  int fifo_start_ = 0;
 
   PPU *ppu_;
   int scx_shift_ = 0;
@@ -44,6 +57,12 @@ class PixelFIFO {
 
   Sprite *row_sprites_;
   int row_sprites_count_;
+  // Index into row_sprites_ (sorted by x) of the next sprite to consider.
+  int row_sprite_cursor_ = 0;
+
+  // When false, the FIFO keeps its timing but skips tile fetches, sprite
+  // overlay and drawing.
+  bool draw_ = true;
 
   bool window_triggered_ = false;
   int window_x_ = 0;
@@ -51,15 +70,13 @@ class PixelFIFO {
   // What pixel to fetch sprites for. Starts < 0 to capture sprites off of the left edge.
   int sprite_fetch_x = -7;
 
-  void OverlaySpriteFetch(int i);
-
   void StartBackgroundFetch();
   void StartWindowFetch();
   void StartSpriteFetch(Sprite sprite, bool immediately_apply, int left_shift);
   void ApplyFetch();
 
   Pixel PopFrontPixel();
-  void Append(Pixel p);
+  void AppendRow(PixelRow row);
   int FirstSpriteIndexForX(int x);
 
   void ClearFifo();
@@ -70,8 +87,8 @@ class PixelFIFO {
   PixelFIFO(PPU *ppu);
   ~PixelFIFO();
 
-  // Starts the new row 0->143.
-  void NewRow(int row, Sprite *row_sprites, int row_sprites_count);
+  // Starts the new row 0->143. Pixels are only drawn to the screen if draw is set.
+  void NewRow(int row, Sprite *row_sprites, int row_sprites_count, bool draw);
   bool Advance(Screen *screen);
   bool WindowTriggered() { return window_triggered_; }
 };
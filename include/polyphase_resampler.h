@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "audio_sink.h"
+
+// Converts interleaved stereo samples from one rate to another with a
+// windowed-sinc filter. The filter is precomputed for PHASES fractional
+// positions between input samples, and each output sample is one dot product
+// per channel against the nearest phase, done with SSE2, or AVX2 on machines
+// that have it.
+class PolyphaseResampler {
+ public:
+  // use_avx2 false keeps to the baseline kernel even where AVX2 runs. Both
+  // give the same output.
+  PolyphaseResampler(int in_rate, int out_rate, bool use_avx2 = true);
+  ~PolyphaseResampler();
+
+  // Most output samples count input samples can make.
+  int MaxOutput(int count) const;
+
+  // Resamples count stereo samples from in into out, which must have room
+  // for MaxOutput(count). Returns how many were written. Input the filter
+  // still needs is kept for the next call.
+  int Process(const int16_t *in, int count, int16_t *out);
+
+  // Filter taps per channel per output sample.
+  int taps() const { return taps_; }
+  // Whether Process uses the AVX2 kernel.
+  bool avx2() const { return avx2_; }
+
+ private:
+  static const int PHASE_BITS = 6;
+  static const int PHASES = 1 << PHASE_BITS;
+  static const int FRAC_BITS = 32;
+  static const int KERNEL_BITS = 15;
+  // Filter length, in samples at the lower of the two rates.
+  static const int ZERO_CROSSINGS = 32;
+
+  int taps_;
+  // PHASES rows of taps_ taps, each summing to 1 << KERNEL_BITS.
+  int16_t *kernel_;
+  // Unconsumed input, one array per channel so taps line up with samples.
+  std::vector<int16_t> history_[2];
+  // Input position of the next output sample, relative to the start of
+  // history_, and input samples per output sample, in 32.32 fixed point.
+  uint64_t position_ = 0;
+  uint64_t step_;
+  bool avx2_ = false;
+
+  // Filters left and right against the same row of taps.
+  static void Dot(const int16_t *kernel, const int16_t *left, const int16_t *right,
+                  int taps, int32_t *left_sum, int32_t *right_sum);
+  // Dot, 16 taps at a time. Only called when avx2_ is set.
+  static void DotAVX2(const int16_t *kernel, const int16_t *left, const int16_t *right,
+                      int taps, int32_t *left_sum, int32_t *right_sum);
+};
+
+// Puts a PolyphaseResampler between the SoundController and an output sink.
+// The SoundController renders at in_rate, e.g. NATIVE_SAMPLE_RATE, and sink
+// receives audio at its own rate.
+class ResamplingAudioSink : public AudioSink {
+ public:
+  ResamplingAudioSink(AudioSink *sink, int in_rate);
+  ~ResamplingAudioSink();
+
+  int sample_rate() override { return in_rate_; }
+  void QueueSamples(const int16_t *samples, int count) override;
+
+  uint64_t underruns() override { return sink_->underruns(); }
+  uint64_t overruns() override { return sink_->overruns(); }
+
+ private:
+  AudioSink *sink_;
+  int in_rate_;
+  PolyphaseResampler resampler_;
+  std::vector<int16_t> out_;
+};
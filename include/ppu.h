@@ -5,9 +5,11 @@
 #include <cstdint>
 #include <vector>
 
+#include "paged_memory.h"
 #include "sprite.h"
 
 class InterruptHandler;
+class Logger;
 class PixelFIFO;
 class Screen;
 struct Sprite;
@@ -25,7 +27,7 @@ enum PPUState {
 class PPU {
  public:
   PPU(Screen *screen);
-  ~PPU() = default;
+  ~PPU();
 
   bool Advance(int cycles);
 
@@ -40,26 +42,46 @@ class PPU {
   // Sprite, y is 0-sprite_height.
   uint16_t SpritePixels(Sprite sprite, int sprite_y);
 
+  // The sprites OAM search found for the current row, at most 10, sorted by
+  // x with ties in OAM order.
+  const Sprite *row_sprites() { return row_sprites_; }
+  int row_sprites_count() { return row_sprites_count_; }
+
   uint8_t scx();
   uint8_t scy();
 
   void SetInterruptHandler(InterruptHandler *handler) {
     interrupt_handler_ = handler;
   };
+  // Writes the game shouldn't make at the time, e.g. scrolling mid-line, go to
+  // logger, if set.
+  void SetLogger(Logger *logger) { logger_ = logger; }
+  Logger *logger() { return logger_; }
 
   bool WindowEnabledAt(int x, int y);
 
+  // Draws one frame, then skips drawing the next frame_skip frames. Skipped
+  // frames keep exact mode timing and interrupts, but leave the screen stale.
+  void SetFrameSkip(int frame_skip) { frame_skip_ = frame_skip; }
+  // Skips drawing the next frames frames, then draws one, whatever the frame
+  // skip. The frame skip carries on from there.
+  void SkipNextFrames(int frames);
+
   // State restoration
   void SetState(const struct PPUSaveState& state);
   void GetState(struct PPUSaveState& state);
+  // Takes on other's state, sharing its video RAM copy-on-write. Exact
+  // between frames, when no row is being drawn.
+  void ForkFrom(PPU &other);
 
  private:
   uint8_t *oam_ram_ = NULL;
-  uint8_t *video_ram_ = NULL;
+  PagedMemory *video_ram_ = NULL;
   uint8_t *io_ram_ = NULL;
   Screen *screen_ = NULL;
   PixelFIFO *fifo_ = NULL;
   InterruptHandler *interrupt_handler_ = NULL;
+  Logger *logger_ = NULL;
 
   PPUState state_;
 
@@ -69,9 +91,24 @@ class PPU {
   int advance_cycles_ = 0;
   void AdvanceFrame(int frame_cycles);
 
+  // Frame cycle of the next mode or LY transition. Advances which end before
+  // it only need to count cycles.
+  int next_event_cycles_ = 0;
+  int NextEventCycles();
+
   Sprite *row_sprites_ = NULL;
   int row_sprites_count_ = 0;
 
+  // For each visible row, bit i is set if OAM sprite i could intersect it as
+  // a 8x16 sprite. Kept up to date on OAM Y writes so OAM search only looks at
+  // candidate sprites.
+  uint64_t *row_oam_index_ = NULL;
+  void UpdateRowOAMIndex(int sprite_index, int old_oam_y, int new_oam_y);
+
+  int frame_skip_ = 0;
+  int skipped_frames_ = 0;
+  bool draw_frame_ = true;
+
   void VisibleCycle(int clockCycles);
   void InvisibleCycle(int clockCycles);
   void DrawRow(int row);
@@ -91,6 +128,11 @@ class PPU {
   void set_lcdc(uint8_t value);
   uint8_t lcdc();
 
+  // The PPU is dormant while LCDC bit 7 is clear.
+  bool LCDEnabled();
+  void TurnOffLCD();
+  void TurnOnLCD();
+
   void set_stat(uint8_t value);
   uint8_t stat();
 
@@ -123,7 +165,7 @@ class PPU {
   void set_obp1(uint8_t address);
 
   // Performs the OAM Search function, finding up to 10 sprites visible at this
-  // row.
+  // row, sorted by x (ties keep OAM order).
   void OAMSearchY(int row);
 
   bool SpritesEnabled();
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "blip_buffer.h"
 #include "constants.h"
 
 union SDL_Event;
@@ -11,9 +12,18 @@ class PulseVoice {
   PulseVoice(int voice_number);
   ~PulseVoice();
 
-  // Adds this voice's samples to the buffer.
-  void AddSamplesToBuffer(int16_t* buffer, int samples);
-  int16_t GetSample();
+  // Adds this voice's output changes between start_time and end_time (cycles
+  // within the buffer's frame) to the buffer.
+  void Run(int start_time, int end_time, BlipBuffer* buffer);
+
+  // Clocked by the frame sequencer at 256, 64 and 128 Hz.
+  void ClockLength();
+  void ClockEnvelope();
+  void ClockSweep();
+
+  // Output levels out of 8 for the left and right terminals, from panning and
+  // master volume. 0 mutes a side.
+  void SetOutputLevels(int left, int right) { output_.SetLevels(left, right); }
 
   // Pulse voice 2 will never have this set by the controller.
   void SetNRX0(uint8_t byte) { nrx0_ = byte; };
@@ -44,25 +54,27 @@ class PulseVoice {
   uint8_t PeriodSweepPace() { return (nrx0_ & 0x70) >> 4;}
   void DoPeriodSweep();
 
-  int CyclesPerDutyCycle() { return CYCLES_PER_SECOND / FrequencyHz() / 16; }
+  // The 16 step waveform advances every 2 * (2048 - period) cycles.
+  int CyclesPerDutyCycle() { return 2 * (2048 - PeriodValue()); }
 
   uint8_t DutyCycle() { return (nrx1_ & 0xC0) >> 6; }
 
   bool DACEnabled() { return nrx2_ & 0xF8; }
 
   uint16_t PeriodValue();
-  float FrequencyHz();
   uint8_t nrx0_ = 0;
   uint8_t nrx1_ = 0;
   uint8_t nrx2_ = 0;
   uint8_t nrx3_ = 0;
   uint8_t nrx4_ = 0;
 
-  int duty_cycle_timer_cycles_ = CYCLES_PER_SOUND_TIMER_TICK;
-  int timer_cycles_ = 0;
-  int envelope_cycles_ = 0;
-  int period_sweep_cycles_ = 0;
+  int duty_cycle_timer_cycles_ = 0;
+  // Frame sequencer clocks until the next envelope and sweep step.
+  int envelope_timer_ = 0;
+  int period_sweep_timer_ = 0;
   bool enabled_ = false;
+  BlipOutput output_;
+  int Amplitude();
   int length_ = 0;
   uint8_t length_enable_ = false;
   int volume_ = 0;
@@ -71,4 +83,7 @@ class PulseVoice {
 
   uint8_t waveform_position_ = 0;
   static const uint8_t waveform_[4][16];
+  // Output for each volume, duty cycle and waveform step.
+  static int16_t amplitudes_[16][4][16];
+  static void InitAmplitudes();
 };
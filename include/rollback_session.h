@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+class Emulator;
+
+using namespace std;
+
+// One player's buttons for one frame, as Button bits.
+struct RollbackInput {
+  int64_t frame;
+  uint8_t buttons;
+};
+
+// Carries inputs between the two ends of a RollbackSession. Inputs may arrive
+// late and out of order, but must all arrive.
+class RollbackTransport {
+ public:
+  virtual ~RollbackTransport() = default;
+  virtual void Send(const RollbackInput &input) = 0;
+  // Takes the next input that has arrived, returning false if there's none.
+  virtual bool Receive(RollbackInput *input) = 0;
+};
+
+struct RollbackOptions {
+  // Frames local input is held back before it takes effect. Hides that much
+  // of the peer's latency without rolling back, at the cost of as much input
+  // lag. The peer may use a different delay.
+  int input_delay = 2;
+  // Most frames run on predicted input, and so the most re-run to correct
+  // them. The session stalls rather than get further ahead of the peer.
+  int max_rollback = 8;
+};
+
+// Plays one game between two players on two machines, each running its own
+// emulator in step with the other. Each frame both players' buttons are OR'd
+// together into the game's input, so e.g. one can steer while the other
+// jumps. Local input is sent to the peer as it's given, and the peer's input
+// not yet arrived is predicted to stay as it last was. Each frame is kept
+// as a copy-on-write fork of the emulator, so when the peer's real input
+// turns out different, the session goes back to the first wrong frame and
+// runs again from there, undrawn and muted, before going on. Both ends see
+// exactly the same frames once their inputs are confirmed.
+class RollbackSession {
+ public:
+  // emulator and transport must outlive the session. Both ends must start
+  // from the same state.
+  RollbackSession(Emulator *emulator, RollbackTransport *transport,
+                  RollbackOptions options = RollbackOptions());
+  ~RollbackSession();
+
+  // Applies the peer's input that has arrived, correcting any frames
+  // predicted wrongly, then runs the next frame with local_buttons held from
+  // input_delay frames on. Returns false, running nothing and dropping
+  // local_buttons, if the peer is too far behind to run another frame.
+  bool AdvanceFrame(uint8_t local_buttons);
+  // Applies the peer's input that has arrived without running a frame.
+  void Poll();
+
+  // Frames run, so the number of the next one.
+  int64_t frame() { return frame_; }
+  // Frames run with both players' input known. Only these are final.
+  int64_t confirmed_frames();
+
+  // Times frames were run again, and how many in all.
+  int64_t rollbacks() { return rollbacks_; }
+  int64_t resimulated_frames() { return resimulated_frames_; }
+  // Times AdvanceFrame waited for the peer.
+  int64_t stalls() { return stalls_; }
+
+ private:
+  // The peer's input for frame, or the prediction for it.
+  uint8_t RemoteInput(int64_t frame);
+  // Saves the state before frame, then runs it.
+  void RunFrame();
+  // Goes back to frame and runs again up to frame_.
+  void RollBackTo(int64_t frame);
+
+  Emulator *emulator_;
+  RollbackTransport *transport_;
+  RollbackOptions options_;
+  int64_t frame_ = 0;
+
+  // The emulator before each of the last max_rollback + 1 frames, by frame
+  // number modulo their count, and the peer's input each was run with.
+  vector<Emulator *> saved_;
+  vector<uint8_t> remote_used_;
+
+  map<int64_t, uint8_t> local_inputs_;
+  map<int64_t, uint8_t> remote_inputs_;
+  // The peer's inputs are known for every frame before this one.
+  int64_t remote_confirmed_ = 0;
+  // Predicted from when not yet known.
+  uint8_t last_confirmed_remote_ = 0;
+
+  int64_t rollbacks_ = 0;
+  int64_t resimulated_frames_ = 0;
+  int64_t stalls_ = 0;
+};
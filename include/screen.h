@@ -1,7 +1,7 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
-#include <mutex>
 #include <string>
 
 
@@ -12,9 +12,7 @@ const int SCREEN_WIDTH = 160;
 const int SCREEN_HEIGHT = 144;
 const int SCREEN_PIXELS = SCREEN_WIDTH * SCREEN_HEIGHT;
 
-struct SDL_Renderer;
-struct SDL_Texture;
-struct SDL_Window;
+class VideoSink;
 
 using namespace std;
 
@@ -27,27 +25,42 @@ class Screen {
  private:
   bool on_ = false;
   bool debugger_ = false;
-  uint32_t *pixels_front_;
-  uint32_t *pixels_back_;
-  std::mutex pixels_mutex_;
+  // Finished frames are passed to the reader through a lock-free triple
+  // buffer. The emulation thread draws into back_buffer_, the reader owns
+  // front_buffer_, and they swap their buffer with shared_buffer_. The
+  // buffers are only made once there is a frame to put in them, so forks
+  // that are only kept as saved states don't pay for them.
+  uint32_t *buffers_[3] = {nullptr, nullptr, nullptr};
+  int back_buffer_ = 0;
+  int front_buffer_ = 1;
+  // Buffer index, with FRESH_FRAME_BIT set if the reader hasn't taken it yet.
+  std::atomic<int> shared_buffer_;
+  static const int FRESH_FRAME_BIT = 0x4;
+  uint32_t *pixels_back_ = nullptr;
+  // What the reader last took, blank until the first frame.
+  const uint32_t *pixels_front_;
+  // The last published frame. Neither thread writes to it until it has been
+  // replaced, so the emulation thread can read it for screenshots.
+  const uint32_t *last_frame_;
   uint32_t *palettes_;
   int x_ = 0;
   int y_ = 0;
 
-  void InitSDL();
-  SDL_Renderer *renderer_;
-  SDL_Texture *texture_;
-  SDL_Window *window_;
+  VideoSink *video_sink_;
   unsigned long long frame_start_ms_ = 0;
   int frames_ = 0;
   ScreenStyle style_ = ScreenStyle_White;
 
   uint32_t GetScreenColor(Pixel pixel);
+  void AllocateBuffers();
+  void PublishFrame();
 
   int screenshot_ = 0;
  public:
-  Screen();
-  ~Screen() = default;
+  // video_sink is told about each finished frame, e.g. an SDLVideoSink or a
+  // HeadlessVideoSink.
+  explicit Screen(VideoSink *video_sink);
+  ~Screen();
 
   void DrawPixel(Pixel pixel);
   void NewLine();
@@ -59,8 +72,19 @@ class Screen {
 
   void SetStyle(ScreenStyle style) { style_ = style; }
 
+  // Takes on other's palettes, style and drawing position, and a copy of its
+  // last frame, which is published to the reader without telling the sink.
+  void ForkFrom(Screen &other);
+
   void SaveScreenshot(const string& base_name);
   void SaveScreenshotToPath(const string& filepath);
 
-  const uint32_t* pixels() { return pixels_front_; }
+  // Returns the newest finished frame. Safe to call from a thread other than
+  // the emulation thread, but only one thread may read frames. The pixels stay
+  // valid until the next call.
+  const uint32_t* pixels();
+
+  // The newest finished frame, for reading on the emulation thread without
+  // taking it from the reader.
+  const uint32_t* last_frame() { return last_frame_; }
 };
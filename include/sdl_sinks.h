@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "audio_ring_buffer.h"
+#include "audio_sink.h"
+#include "constants.h"
+#include "video_sink.h"
+
+struct SDL_AudioStream;
+struct SDL_Renderer;
+struct SDL_Texture;
+struct SDL_Window;
+
+// Draws frames to an SDL window. SDL only allows rendering on the main
+// thread, so FrameReady, on the emulation thread, just notes the frame, and
+// Present uploads it from the main loop. Frames are taken from the Screen's
+// triple buffer, so any that finish between Presents are dropped in favor of
+// the newest.
+class SDLVideoSink : public VideoSink {
+ public:
+  SDLVideoSink();
+  ~SDLVideoSink();
+
+  void FrameReady(Screen *screen) override;
+
+  // Shows the newest frame, if there is one, and returns whether there was.
+  // Call on the main thread.
+  bool Present();
+
+ private:
+  SDL_Renderer *renderer_ = nullptr;
+  SDL_Texture *texture_ = nullptr;
+  SDL_Window *window_ = nullptr;
+
+  std::atomic<Screen *> screen_{nullptr};
+  std::atomic<bool> frame_ready_{false};
+};
+
+// Plays samples on the default SDL playback device. Samples go into a
+// lock-free ring which SDL's audio thread drains from a callback, so the
+// emulation thread never takes a lock. The ring holds latency_ms of audio;
+// samples beyond that are dropped. A sample_rate of 0 uses the device's own
+// rate, so SDL doesn't have to resample.
+class SDLAudioSink : public AudioSink {
+ public:
+  explicit SDLAudioSink(int latency_ms = DEFAULT_AUDIO_LATENCY_MS, int sample_rate = 0);
+  ~SDLAudioSink();
+
+  int sample_rate() override { return sample_rate_; }
+
+  void QueueSamples(const int16_t *samples, int count) override;
+
+  uint64_t underruns() override { return ring_.underruns(); }
+  uint64_t overruns() override { return ring_.overruns(); }
+
+  // The ring holds interleaved values, AUDIO_CHANNELS per sample.
+  int BufferedSamples() override { return ring_.Available() / AUDIO_CHANNELS; }
+  int TargetBufferedSamples() override { return ring_.capacity() / AUDIO_CHANNELS / 2; }
+
+ private:
+  SDL_AudioStream *audio_stream_ = nullptr;
+  // Before ring_, which is sized from it.
+  int sample_rate_;
+  AudioRingBuffer ring_;
+  // Don't count underruns until the ring has filled once.
+  std::atomic<bool> started_;
+
+  static int ChooseSampleRate(int sample_rate);
+  static void FillStream(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount);
+};
@@ -3,7 +3,16 @@
 #include <cstdint>
 #include <string>
 
-// Simple Serial Controller capable of outputting Test ROM.
+class InterruptHandler;
+
+// Serial port. A transfer on the internal clock shifts SB out and a byte in
+// over 8 bits at 8192 Hz, then requests Interrupt_SerialTransferCompletion.
+// With nothing connected, 0xFF comes in. On the external clock the port waits
+// for the other end of a LinkCable to clock it. Sent bytes are also kept as
+// output, for test ROMs that report over serial.
+
+// CPU cycles to shift one byte on the internal clock.
+const int SERIAL_TRANSFER_CYCLES = 8 * 512;
 
 class SerialController {
  public:
@@ -17,10 +26,66 @@ class SerialController {
   void set_sc(uint8_t byte);
 
   uint8_t sb() { return sb_; };
-  uint8_t sc() { return sc_; };
+  // Unused bits read as 1.
+  uint8_t sc() { return sc_ | 0x7E; };
+
+  void SetInterruptHandler(InterruptHandler *handler) { interrupt_handler_ = handler; }
+  // CPU cycles run so far, e.g. Emulator's, which transfers are timed by.
+  // Advance must be called as it moves on.
+  void SetClock(const int64_t *clock) { clock_ = clock; }
+  void Advance() {
+    if (*clock_ >= complete_at_) {
+      CompleteTransfer(0xFF);
+    }
+  }
+
+  // Everything sent so far.
+  const std::string &output() { return line_; }
+  void clear_output() { line_.clear(); }
+  // Whether sent bytes are also printed to stdout.
+  void set_echo(bool echo) { echo_ = echo; }
+
+  // While linked, transfers only complete when the LinkCable completes them.
+  void set_linked(bool linked);
+  // Whether a transfer on the internal clock is under way, and when its last
+  // bit is shifted.
+  bool clocking() { return (sc_ & 0x81) == 0x81; }
+  int64_t transfer_end() { return clocking() ? transfer_start_ + SERIAL_TRANSFER_CYCLES : NEVER; }
+  // Whether waiting to be clocked by the other end, and since when.
+  bool listening() { return (sc_ & 0x81) == 0x80; }
+  int64_t listening_since() { return listening_since_; }
+  // Ends the current transfer with received in SB.
+  void CompleteTransfer(uint8_t received);
+  // Whether a transfer started or the port began listening since the last
+  // call, so whoever runs a LinkCable must look again.
+  bool TakeLinkEvent() {
+    bool event = link_event_;
+    link_event_ = false;
+    return event;
+  }
+
+  // Takes on other's registers, transfer and output, but not whether it
+  // echoes or is linked.
+  void ForkFrom(SerialController &other);
+
+  void SetState(const struct SerialSaveState &state);
+  void GetState(struct SerialSaveState &state);
 
  private:
-  std::string *line = new std::string();
+  static constexpr int64_t NEVER = INT64_MAX;
+
+  void UpdateCompleteAt();
+
+  InterruptHandler *interrupt_handler_ = nullptr;
+  const int64_t *clock_ = nullptr;
+  std::string line_;
+  bool echo_ = true;
+  bool linked_ = false;
+  bool link_event_ = false;
   uint8_t sb_ = 0;
   uint8_t sc_ = 0;
-};
\ No newline at end of file
+  int64_t transfer_start_ = NEVER;
+  int64_t listening_since_ = NEVER;
+  // When Advance completes the transfer, or NEVER.
+  int64_t complete_at_ = NEVER;
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "audio_sink.h"
+#include "screen.h"
+#include "video_sink.h"
+
+using namespace std;
+
+// Layout of the POSIX shared memory an exporting emulator writes frames and
+// audio into, for recorders, streamers and analysis processes on the same
+// machine. Frames go into a ring of slots and audio into a ring of blocks.
+// The writer never waits for readers: a reader that falls a whole ring behind
+// loses the oldest entries, and can tell from their numbers.
+
+const uint32_t SHARED_EXPORT_MAGIC = 0x45444745;  // "EDGE"
+const uint32_t SHARED_EXPORT_VERSION = 1;
+const int SHARED_EXPORT_FRAME_SLOTS = 8;
+const int SHARED_EXPORT_AUDIO_BLOCKS = 32;
+// Stereo samples per audio block, a frame's worth at up to 96 kHz.
+const int SHARED_EXPORT_BLOCK_SAMPLES = 2048;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint64_t>::is_always_lock_free,
+              "Shared memory atomics must not need a lock");
+
+// Each slot and block is guarded by a sequence that is odd while the writer
+// is changing it. A reader notes the sequence, reads in place, then checks
+// the sequence is unchanged to know what it read wasn't overwritten.
+struct SharedFrameSlot {
+  atomic<uint32_t> sequence;
+  // Buttons held during the frame, as Button bits.
+  uint32_t input;
+  // Frames are numbered from 1.
+  uint64_t frame_number;
+  // FNV-1a over pixels, as Emulator::FrameHash.
+  uint64_t hash;
+  uint32_t pixels[SCREEN_PIXELS];
+};
+
+struct SharedAudioBlock {
+  atomic<uint32_t> sequence;
+  // Stereo samples in samples.
+  int32_t count;
+  // Blocks are numbered from 1.
+  uint64_t block_number;
+  // The frame the samples were made during.
+  uint64_t frame_number;
+  int16_t samples[SHARED_EXPORT_BLOCK_SAMPLES * AUDIO_CHANNELS];
+};
+
+struct SharedExportHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t frame_slots;
+  uint32_t audio_blocks;
+  uint32_t block_samples;
+  uint32_t sample_rate;
+  // The writing process, so readers can tell a crashed writer from a slow one.
+  int32_t writer_pid;
+  // Set once the writer is done.
+  atomic<uint32_t> closed;
+  // Bumped on every publish. Readers wait on it as a futex on Linux.
+  atomic<uint32_t> changes;
+  // Readers waiting on changes, so the writer only makes a system call to wake
+  // them when there are some.
+  atomic<uint32_t> waiters;
+  atomic<uint64_t> frames_written;
+  atomic<uint64_t> blocks_written;
+};
+
+struct SharedExport {
+  SharedExportHeader header;
+  SharedFrameSlot frames[SHARED_EXPORT_FRAME_SLOTS];
+  SharedAudioBlock audio[SHARED_EXPORT_AUDIO_BLOCKS];
+};
+
+// Sits between an Emulator and its sinks, passing everything on while also
+// writing each finished frame and its audio into shared memory. Frames are
+// copied straight from the Screen into their slot on the emulation thread,
+// which costs one frame copy and hash and no system calls unless a reader is
+// waiting.
+class SharedMemoryExport : public VideoSink, public AudioSink {
+ public:
+  // Creates, or takes over, the shared memory object name, e.g. "/edge".
+  // Returns nullptr if it can't be mapped. The sinks must outlive the export.
+  static SharedMemoryExport *Create(const string &name, VideoSink *video_sink,
+                                    AudioSink *audio_sink);
+  // Tells readers the writer is done, and removes the shared memory.
+  ~SharedMemoryExport();
+
+  // Buttons to record with the following frames.
+  void set_input(uint8_t buttons) { input_ = buttons; }
+
+  // VideoSink.
+  void FrameReady(Screen *screen) override;
+
+  // AudioSink.
+  int sample_rate() override { return audio_sink_->sample_rate(); }
+  void QueueSamples(const int16_t *samples, int count) override;
+  uint64_t underruns() override { return audio_sink_->underruns(); }
+  uint64_t overruns() override { return audio_sink_->overruns(); }
+  int BufferedSamples() override { return audio_sink_->BufferedSamples(); }
+  int TargetBufferedSamples() override { return audio_sink_->TargetBufferedSamples(); }
+
+ private:
+  SharedMemoryExport(const string &name, SharedExport *shared, VideoSink *video_sink,
+                     AudioSink *audio_sink);
+  void Publish();
+
+  string name_;
+  SharedExport *shared_;
+  VideoSink *video_sink_;
+  AudioSink *audio_sink_;
+  uint8_t input_ = 0;
+  uint64_t frames_ = 0;
+  uint64_t blocks_ = 0;
+};
+
+// Reads another process's SharedMemoryExport in place.
+class SharedMemoryReader {
+ public:
+  // Returns nullptr if name doesn't exist or isn't an export of this version.
+  static SharedMemoryReader *Open(const string &name);
+  ~SharedMemoryReader();
+
+  const SharedExportHeader &header() { return shared_->header; }
+  uint64_t frames_written() { return shared_->header.frames_written.load(memory_order_acquire); }
+  uint64_t blocks_written() { return shared_->header.blocks_written.load(memory_order_acquire); }
+  // Whether the writer closed the export or exited without doing so.
+  bool WriterGone();
+
+  // Waits up to timeout_ms for frame frame_number to be written. Returns
+  // false on timeout, or if the writer is gone first.
+  bool WaitForFrame(uint64_t frame_number, int timeout_ms);
+
+  // Return the slot holding frame_number or the block holding block_number,
+  // to be read in place and then checked with EndRead, or nullptr if it isn't
+  // in the ring.
+  const SharedFrameSlot *BeginReadFrame(uint64_t frame_number, uint32_t *ticket);
+  const SharedAudioBlock *BeginReadAudio(uint64_t block_number, uint32_t *ticket);
+  // True if the slot or block wasn't overwritten since BeginRead.
+  bool EndRead(const atomic<uint32_t> &sequence, uint32_t ticket);
+
+ private:
+  explicit SharedMemoryReader(SharedExport *shared) : shared_(shared) {}
+
+  SharedExport *shared_;
+};
+
+// FNV-1a over a frame's pixels.
+uint64_t SharedFrameHash(const uint32_t *pixels);
@@ -2,46 +2,115 @@
 
 #include <cstdint>
 
+#include "constants.h"
+
+class AudioSink;
+class BlipBuffer;
+class Logger;
 class NoiseVoice;
 class PulseVoice;
-class SDL_AudioStream;
 class WaveVoice;
 
 class SoundController {
  public:
-  SoundController();
+  // Samples are handed to audio_sink, e.g. an SDLAudioSink or a
+  // HeadlessAudioSink, at its sample rate.
+  explicit SoundController(AudioSink *audio_sink);
   ~SoundController();
 
+  // Register writes are only logged with the cycle they happen at, and the
+  // voices are rendered in one pass per frame. clock, if set, counts cycles
+  // run since the last Advance, so writes between Advance calls get the right
+  // time, e.g. System's frame cycles. Without one, Advance must be called
+  // after every instruction.
+  void SetClock(const int *clock) { clock_ = clock; }
+  // Accesses to registers it doesn't have go to logger, if set.
+  void SetLogger(Logger *logger) { logger_ = logger; }
+
   bool Advance(int cycles);
 
   void SetByteAt(uint16_t address, uint8_t byte);
   uint8_t GetByteAt(uint16_t);
 
-  int16_t GetSample();
-  void MixSamplesToBuffer(int16_t* buffer, int samples);
+  // Reads up to samples finished stereo samples into buffer as interleaved
+  // left, right pairs, returning how many were read.
+  int MixSamplesToBuffer(int16_t* buffer, int samples);
+
+  // Produce ratio times as many samples per emulated second, to keep a device
+  // buffer from draining or filling. Takes effect from the next frame.
+  void SetRateRatio(double ratio);
+
+  // Muted frames are still rendered, so the voices stay exact, but their
+  // samples are dropped rather than sent to the sink.
+  void SetMuted(bool muted) { muted_ = muted; }
+
+  // Takes on other's voices, logged writes and unread samples. other must
+  // output at the same sample rate.
+  void ForkFrom(SoundController &other);
 
  private:
-  static const int SAMPLE_BUFFER_SIZE = 8;
-  int16_t sample_buffer_[SAMPLE_BUFFER_SIZE];
-  int buffer_pos_ = 0;
+  // The frame sequencer clocks length, sweep and envelope at 512 Hz.
+  static const int CYCLES_PER_SEQUENCER_STEP = CYCLES_PER_SECOND / 512;
+  // Writes logged before the voices have to be rendered early to make room.
+  static const int MAX_REGISTER_WRITES = 1024;
+
+  struct RegisterWrite {
+    int time;
+    uint16_t address;
+    uint8_t byte;
+  };
+  // Made on the first write, and frame_samples_ at the first frame, so forks
+  // that are only kept as saved states don't pay for them.
+  RegisterWrite *writes_ = nullptr;
+  int write_count_ = 0;
+
+  const int *clock_ = nullptr;
+  Logger *logger_ = nullptr;
+  // Frame time the CPU had reached at the last Advance.
+  int now_ = 0;
+  int Now() { return now_ + (clock_ ? *clock_ : 0); }
+
+  // Voices add their panned output changes here, and it is filtered down to
+  // sample_rate_ once per frame. It tracks the exact fractional position of
+  // each output sample in 32.32 fixed point, so the rate is exact rather
+  // than rounded to whole cycles per sample.
+  BlipBuffer *blip_;
+  int sample_rate_;
+  // Samples in a frame at sample_rate_, with room for rate control.
+  int max_samples_per_frame_;
+  int16_t *frame_samples_ = nullptr;
+  // Cycles since the start of the audio frame the voices are rendered to.
+  int frame_time_ = 0;
+  // Frame time of the next frame sequencer step, and which of its 8 steps it
+  // is.
+  int sequencer_time_ = CYCLES_PER_SEQUENCER_STEP;
+  int sequencer_step_ = 0;
+
+  // Renders the voices to time, applying logged writes as they come up.
+  void RenderUntil(int time);
+  // Finishes the frame at time and sends its samples to the sink.
+  void EndFrame(int time);
+  void RunUntil(int time);
+  void RunVoices(int start_time, int end_time);
+  void ClockFrameSequencer();
+  void UpdateOutputLevels();
 
   uint8_t sound_output_terminals_ = 0;
   bool global_sound_on_ = 0;
-  uint8_t s01_volume_level_ = 0;
-  uint8_t s02_volume_level_ = 0;
   uint8_t channel_control_ = 0;
-  int cycles_;
 
   PulseVoice *voice1_;
   PulseVoice *voice2_;
   WaveVoice *voice3_;
   NoiseVoice *voice4_;
 
-  SDL_AudioStream* audio_stream_;
+  AudioSink *audio_sink_;
+  bool muted_ = false;
 
   bool ChannelLeftEnabled(int channel);
   bool ChannelRightEnabled(int channel);
 
+  void WriteRegister(uint16_t address, uint8_t byte);
   void SetFF26(uint8_t byte);
   uint8_t GetFF26();
 };
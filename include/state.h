@@ -40,6 +40,9 @@ struct TimerSaveState {
   uint8_t tima;
   uint8_t tma;
   uint8_t tac;
+  // The full DIV counter, and cycles until TIMA next counts.
+  uint16_t div_counter;
+  int32_t tima_cycles;
 };
 
 struct CartridgeSaveState {
@@ -77,12 +80,22 @@ struct InterruptControllerSaveState {
   bool is_halted;
 };
 
+struct SerialSaveState {
+  uint8_t sb;
+  uint8_t sc;
+  // In emulator cycles, which are saved alongside.
+  int64_t transfer_start;
+  int64_t listening_since;
+};
+
 struct SaveState {
   static constexpr uint32_t MAGIC = 0x45444745;  // "EDGE"
-  static constexpr uint32_t VERSION = 1;
+  static constexpr uint32_t VERSION = 3;
   
   uint32_t magic;
   uint32_t version;
+  // Cartridge::ROMHash(), so a snapshot only restores into the same game.
+  uint64_t rom_hash;
 
   CPUSaveState cpu;
   CartridgeSaveState cartridge;
@@ -91,6 +104,9 @@ struct SaveState {
   InterruptControllerSaveState interrupt_controller;
   PPUSaveState ppu;
   TimerSaveState timer;
+  SerialSaveState serial;
+  // Emulator::cycles(), which serial transfers are timed by.
+  int64_t cycles;
 };
 
 class State {
@@ -5,18 +5,11 @@
 #include <memory>
 
 class State;
-class CPU;
-class MMU;
-class Cartridge;
-class AddressRouter;
-class InterruptController;
-class PPU;
-class Screen;
+class Emulator;
 
 class StateController {
 public:
-    StateController(const std::string& game_state_dir, CPU* cpu, MMU* mmu, Cartridge* cartridge, 
-                   AddressRouter* router, InterruptController* interrupt_controller, PPU* ppu, Screen* screen);
+    StateController(const std::string& game_state_dir, Emulator* emulator);
     ~StateController() = default;
 
     // Get all available save states for this game
@@ -66,13 +59,7 @@ private:
     static constexpr int MAX_SLOTS = 10;
     int latest_rotating_slot_ = -1;
     
-    CPU* cpu_;
-    MMU* mmu_;
-    Cartridge* cartridge_;
-    AddressRouter* router_;
-    InterruptController* interrupt_controller_;
-    PPU* ppu_;
-    Screen* screen_;
+    Emulator* emulator_;
     
     std::string GetStateDir(int slot) const;
     std::string GetStateFile(int slot) const;
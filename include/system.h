@@ -1,40 +1,93 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "constants.h"
+#include "control_server.h"
 #include "input_controller.h"
 
-class AddressRouter;
-class Cartridge;
-class CPU;
-class InputController;
-class InterruptController;
-class MMU;
-class PPU;
-class Screen;
-class SerialController;
-class SoundController;
+class AudioSink;
+class Emulator;
+class SDLVideoSink;
+class SharedMemoryExport;
 class State;
 class StateController;
-class TimerController;
+class VideoSink;
 
 using namespace std;
 
-class System : public ScreenshotTaker, public StateNavigator {
+enum FramePacing {
+  // Sleep until the next frame is due by the system clock.
+  FramePacing_Sleep = 0,
+  // Sleep against the frame clock, and nudge the audio rate so the audio
+  // device's buffer stays near its target.
+  FramePacing_Audio = 1,
+};
+
+struct SystemOptions {
+  // No window, audio device or input polling, and run as fast as possible
+  // rather than at 60 fps.
+  bool headless = false;
+  // Audio buffered ahead of the output device.
+  int audio_latency_ms = DEFAULT_AUDIO_LATENCY_MS;
+  // Output samples per second, or 0 for the audio device's own rate.
+  int sample_rate = 0;
+  // Render audio at NATIVE_SAMPLE_RATE and resample it to the output rate
+  // with a polyphase filter, rather than synthesizing at the output rate.
+  bool resample = false;
+  FramePacing pacing = FramePacing_Sleep;
+  // Log audio pacing's rate ratio, buffer level, drift and under/overruns
+  // every 10 seconds.
+  bool pacing_stats = false;
+  // If set, the POSIX shared memory object, e.g. "/edge", that frames and
+  // audio are also written to for other processes.
+  string shared_memory_name;
+  // If set, serves the control protocol on a Unix domain socket at this path.
+  // Headless instances then only run the frames they are asked to.
+  string control_socket;
+  // Frames to run ahead, 0 to 3. After each frame, the frame this many frames
+  // later with the buttons now held is shown instead, cutting input latency
+  // by as many frames at the cost of running them too.
+  int run_ahead = 0;
+};
+
+// Runs an Emulator with a window, audio device, keyboard input and save
+// states, at the Game Boy's frame rate. With a window, Main runs frames on an
+// emulation thread while the main thread presents them and polls input.
+class System : public ScreenshotTaker, public StateNavigator, public FrameStepper {
  public:
-  System(string rom_filename, string state_dir);
+  System(string rom_filename, string state_dir, SystemOptions options = SystemOptions());
   ~System() = default;
 
   void Main();
 
   void SetButtons(bool dpadUp, bool dpadDown, bool dpadLeft, bool dpadRight, bool buttonA, bool buttonB, bool buttonSelect, bool buttonStart);
+  // Polls input, runs a frame and waits until the next is due, all on the
+  // calling thread. For hosts that drive frames themselves.
   void AdvanceOneFrame();
 
+  // Only draw every (frame_skip + 1)th frame. Emulation is unaffected. No
+  // effect with run-ahead, which only draws the frames it shows.
+  void SetFrameSkip(int frame_skip);
+
+  // The newest finished frame. Only one thread may read frames.
   const uint32_t* pixels();
 
+  // Audio device underruns and overruns since startup.
+  uint64_t AudioUnderruns();
+  uint64_t AudioOverruns();
+
+  // With FramePacing_Audio, the current audio rate ratio, and how far audio
+  // has been stretched in total versus the emulated clock, in ms.
+  double AudioRateRatio() { return audio_rate_ratio_; }
+  double AudioDriftMs();
+
   // ScreenshotTaker abstract class functions.
   void TakeScreenshot();
 
@@ -47,24 +100,49 @@ class System : public ScreenshotTaker, public StateNavigator {
 
   std::vector<std::unique_ptr<State>> GetSaveStates();
 
+  // FrameStepper abstract class functions.
+  void StepFrame() { RunOneFrame(); }
+
  private:
-  Cartridge *cartridge_;
-  MMU *mmu_;
-  CPU *cpu_;
-  PPU *ppu_;
-  AddressRouter *router_;
-  InputController *input_controller_;
-  InterruptController *interrupt_controller_;
-  SerialController *serial_controller_;
-  SoundController *sound_controller_;
-  TimerController *timer_controller_;
-  Screen *screen_;
+  Emulator *emulator_;
+  // With run-ahead, a fork of emulator_ that runs ahead of it each frame and
+  // shows what it sees, while emulator_ plays the audio.
+  Emulator *ahead_ = nullptr;
+  int run_ahead_ = 0;
+  // Takes emulator_'s frames, which aren't shown with run-ahead.
+  VideoSink *hidden_video_sink_ = nullptr;
+  AudioSink *ahead_audio_sink_ = nullptr;
+  VideoSink *video_sink_;
+  // The window's sink, presented from the main loop. Null when headless.
+  SDLVideoSink *sdl_video_sink_ = nullptr;
+  AudioSink *audio_sink_;
+  SharedMemoryExport *shared_memory_export_ = nullptr;
+  ControlServer *control_server_ = nullptr;
   StateController *state_controller_;
 
+  bool headless_;
+  FramePacing pacing_;
+  bool pacing_stats_;
+  double audio_rate_ratio_ = 1.0;
+  double audio_drift_samples_ = 0;
+  std::chrono::steady_clock::time_point next_frame_time_;
+  // Nudges the audio rate toward keeping the device buffer on target.
+  void PaceToAudio();
+  // Sleeps until the next frame is due.
+  void WaitForNextFrame();
+  // Runs emulator_'s next frame, and run-ahead's on top of it.
+  void RunOneFrame();
+  void RunAhead();
+  // Runs and paces frames on emulation_thread_.
+  void EmulationLoop();
+  std::thread emulation_thread_;
+  // Held by emulation_thread_ while it runs a frame, and by the main thread
+  // while it polls input and control requests, which can change emulator_.
+  std::mutex emulator_mutex_;
+  // The emulator whose frames are shown.
+  Emulator *shown() { return ahead_ ? ahead_ : emulator_; }
   int frame_count_;
-  int frame_cycles_;
   std::chrono::high_resolution_clock::time_point last_frame_start_time_;
 
-  MMU *GetMMU(bool skip_boot_rom);
   bool WillLoadState();
 };
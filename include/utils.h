@@ -31,6 +31,11 @@ std::string destinationToString(Destination d);
 
 std::string descriptionforPixel(Pixel p);
 
+// Reads a whole decimal number from text, e.g. a command line argument.
+// Returns false if there is anything else in it, or it doesn't fit.
+bool ParseInt(const char *text, int &value);
+bool ParseInt64(const char *text, int64_t &value);
+
 class CPU;
 CPU *getTestingCPU();
 CPU *getTestingCPUWithInstructions(std::vector<uint8_t> instructions);
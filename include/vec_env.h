@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "constants.h"
+#include "emulator.h"
+
+class JobPool;
+
+using namespace std;
+
+// Bytes of RAM VecEnv reports per environment: work RAM, then high RAM.
+const int VEC_ENV_RAM_SIZE =
+    (WORK_RAM_END - WORK_RAM_START + 1) + (HIGH_RAM_END - HIGH_RAM_START + 1);
+
+struct VecEnvOptions {
+  // Frames each action is held for.
+  int action_repeat = 4;
+  // Observe the per pixel, per channel maximum of the last two frames of
+  // each step, taken before grayscale and downsampling, so sprites that
+  // flicker every other frame still show. Needs an action_repeat of at least
+  // 2 to have any effect.
+  bool max_pool = true;
+  // One luma byte per pixel, rather than R, G and B bytes.
+  bool grayscale = true;
+  // Averages each downsample x downsample block of pixels into one. Must
+  // divide the screen's width and height, so 1, 2, 4, 8 or 16.
+  int downsample = 2;
+  // Threads stepping environments. 1 steps them on the calling thread, and
+  // 0 uses one per hardware thread.
+  int threads = 1;
+};
+
+// Emulators of one ROM, stepped together as a batch of gym style
+// environments. Each Step holds every environment's action for
+// action_repeat frames, then writes its observation and RAM straight into
+// the caller's arrays without allocating. Only the frames observed are
+// drawn.
+class VecEnv {
+ public:
+  // Returns nullptr if rom isn't a supported cartridge, or options are out of
+  // range.
+  static VecEnv *Create(const uint8_t *rom, size_t size, int envs,
+                        VecEnvOptions options = VecEnvOptions(),
+                        EmulatorOptions emulator_options = EmulatorOptions());
+  ~VecEnv();
+
+  // Array arguments hold one entry per environment, in order: actions a
+  // Button mask, observations observation_size() bytes, and ram
+  // VEC_ENV_RAM_SIZE bytes. observations or ram may be null to skip them;
+  // without observations no frames are drawn at all.
+
+  // Returns every environment to its state at Create, which is after its
+  // first frame.
+  void Reset(uint8_t *observations, uint8_t *ram);
+  // Returns one environment to its state at Create, writing only its entries.
+  void ResetEnv(int env, uint8_t *observations, uint8_t *ram);
+  void Step(const uint8_t *actions, uint8_t *observations, uint8_t *ram);
+
+  int envs() { return (int)emulators_.size(); }
+  int observation_width() { return width_; }
+  int observation_height() { return height_; }
+  // 1 for grayscale, otherwise 3.
+  int observation_channels() { return channels_; }
+  // Bytes per observation, row by row, with channels interleaved.
+  int observation_size() { return width_ * height_ * channels_; }
+  Emulator *env(int i) { return emulators_[i]; }
+
+ private:
+  VecEnv(vector<Emulator *> emulators, VecEnvOptions options);
+
+  void StepEnvs(int begin, int end);
+  void StepEnv(int env);
+  // Raises each channel of each pooled pixel to pixels'.
+  void MaxPool(const uint32_t *pixels, uint32_t *pooled);
+  // Converts and downsamples pixels into observation.
+  void Observe(const uint32_t *pixels, uint8_t *observation);
+  void ReadRAM(int env, uint8_t *ram);
+
+  vector<Emulator *> emulators_;
+  VecEnvOptions options_;
+  JobPool *pool_ = nullptr;
+  int width_;
+  int height_;
+  int channels_;
+  // log2 of the pixels averaged into each observed one.
+  int block_shift_;
+
+  // With max_pool, each environment's frame before its last in a step,
+  // SCREEN_PIXELS apiece, which the last is pooled into.
+  vector<uint32_t> pooled_frames_;
+
+  // The state, observation and RAM every environment starts from.
+  vector<uint8_t> initial_state_;
+  vector<uint8_t> initial_observation_;
+  vector<uint8_t> initial_ram_;
+
+  // The arrays of the Step in progress.
+  const uint8_t *actions_ = nullptr;
+  uint8_t *observations_ = nullptr;
+  uint8_t *ram_ = nullptr;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+class Screen;
+
+// Told about each finished frame from the Screen.
+class VideoSink {
+ public:
+  virtual ~VideoSink() = default;
+
+  // Called on the emulation thread once a frame can be read with
+  // screen->pixels(). Must not block.
+  virtual void FrameReady(Screen *screen) = 0;
+};
+
+// Drops frames, for running without a display.
+class HeadlessVideoSink : public VideoSink {
+ public:
+  void FrameReady(Screen *) override { frames_presented_++; }
+
+  int frames_presented() { return frames_presented_; }
+
+ private:
+  int frames_presented_ = 0;
+};
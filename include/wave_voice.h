@@ -1,5 +1,6 @@
 #pragma once
 
+#include "blip_buffer.h"
 #include "constants.h"
 
 #include <cstdint>
@@ -11,8 +12,16 @@ class WaveVoice {
   WaveVoice();
   ~WaveVoice();
 
-  int16_t GetSample();
-  void AddSamplesToBuffer(int16_t* buffer, int samples);
+  // Adds this voice's output changes between start_time and end_time (cycles
+  // within the buffer's frame) to the buffer.
+  void Run(int start_time, int end_time, BlipBuffer* buffer);
+
+  // Clocked by the frame sequencer at 256 Hz.
+  void ClockLength();
+
+  // Output levels out of 8 for the left and right terminals, from panning and
+  // master volume. 0 mutes a side.
+  void SetOutputLevels(int left, int right) { output_.SetLevels(left, right); }
 
   void SetNR30(uint8_t byte);
   uint8_t GetNR30() { return 0x7F | nr30_; };
@@ -48,21 +57,25 @@ class WaveVoice {
   uint8_t nr33_ = 0;
   uint8_t nr34_ = 0;
 
-  uint8_t wave_pattern_[16];
+  uint8_t wave_pattern_[16] = {0};
 
-  int timer_cycles_ = CYCLES_PER_SOUND_TIMER_TICK;
-  int cycles_per_sample_ = 0;
   int next_sample_cycles_ = 0;
   int sample_index_ = 0;
+  BlipOutput output_;
+  int Amplitude();
 
   int length_ = 0; // Must be able to count up to 256.
   uint8_t length_enable_ = false;
   uint8_t output_level_ = 0;
   
   uint16_t PeriodValue();
-  float FrequencyHz();
+  // Each of the 32 samples plays for 2 * (2048 - period) cycles.
+  int CyclesPerSample() { return 2 * (2048 - PeriodValue()); }
   void PrintDebug();
 
-  // Returns the current sample value centered from -1 to 1.
-  float CenteredSample();
+  // The current 4 bit sample.
+  uint8_t Nibble();
+  // Output for each output level and sample.
+  static int16_t amplitudes_[4][16];
+  static void InitAmplitudes();
 };
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "emulator.h"
+#include "interrupt_controller.h"
+
+using namespace std;
+
+// Experimental. Runs many emulators of one ROM in lockstep, keeping their CPU
+// registers as structure of arrays. Each step, lanes whose PCs agree run the
+// instruction together: register instructions as vector operations across
+// lanes, loads and stores through each lane's own AddressRouter. Lanes that
+// have diverged, are halted, or are at an instruction without a wide form
+// are peeled off to their own scalar CPU for that step. Every lane behaves
+// exactly as its Emulator run alone, except that CPU::cycles() only counts
+// scalar steps.
+class WideCPU {
+ public:
+  // Returns nullptr if rom isn't a supported cartridge.
+  static WideCPU *Create(const uint8_t *rom, size_t size, int lanes,
+                         EmulatorOptions options = EmulatorOptions());
+  ~WideCPU();
+
+  // Runs every lane to the end of its next frame.
+  void RunFrame();
+  void RunFrames(int count);
+
+  int lanes() { return lanes_; }
+  // Lane i's Emulator, for input, frames and snapshots between RunFrame
+  // calls. Running it directly is fine too.
+  Emulator *lane(int i) { return emulators_[i]; }
+
+  // Instructions run, summed over lanes, together and alone.
+  uint64_t wide_steps() { return wide_steps_; }
+  uint64_t scalar_steps() { return scalar_steps_; }
+
+ private:
+  // Takes interrupts on the lane's registers here, rather than its CPU's.
+  class LaneExecutor : public InterruptExecutor {
+   public:
+    void InterruptToPC(uint8_t pc);
+    WideCPU *wide_cpu;
+    int lane;
+  };
+
+  WideCPU(const uint8_t *rom, size_t size, vector<Emulator *> emulators);
+
+  // Copy a lane's registers between its CPU and the arrays below.
+  void ToCPU(int lane);
+  void FromCPU(int lane);
+
+  void Step();
+  bool CanRunWide(int lane);
+  int StepScalar(int lane);
+  uint8_t Fetch(int lane, uint16_t address);
+  // Runs the instruction at pc on the lanes in mask_ from begin to end, or
+  // returns false, changing nothing, if it has no wide form.
+  bool RunWide(uint8_t opcode, uint16_t pc, int begin, int end);
+
+  // ROM bank 0, which is the same in every lane.
+  vector<uint8_t> bank0_;
+  vector<Emulator *> emulators_;
+  vector<LaneExecutor> executors_;
+  int lanes_;
+
+  // Registers by lane. r8_ is in the order instructions encode registers:
+  // B, C, D, E, H, L, then F in (HL)'s slot, then A.
+  vector<uint8_t> r8_[8];
+  vector<uint16_t> sp_;
+  vector<uint16_t> pc_;
+
+  // Per step. 0xFF for lanes in the set, 0 for the rest.
+  vector<uint8_t> done_;
+  vector<uint8_t> todo_;
+  vector<uint8_t> mask_;
+  // The instruction's operand in each lane, and the cycles it took.
+  vector<uint8_t> imm8_;
+  vector<uint16_t> imm16_;
+  vector<uint8_t> cycles_;
+
+  uint64_t wide_steps_ = 0;
+  uint64_t scalar_steps_ = 0;
+};
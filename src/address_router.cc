@@ -6,6 +6,7 @@
 #include "constants.h"
 #include "input_controller.h"
 #include "interrupt_controller.h"
+#include "logger.h"
 #include "mmu.h"
 #include "ppu.h"
 #include "serial_controller.h"
@@ -226,6 +227,13 @@ uint8_t AddressRouter::GetByteAt(uint16_t address) {
   return GetByteAtAddressFromOwner(owner, address);
 }
 
+uint8_t AddressRouter::PeekByteAt(uint16_t address) {
+  if (address >= 0x8000 && !ShouldSaveLoadAddress(address)) {
+    return 0xFF;
+  }
+  return GetByteAt(address);
+}
+
 void AddressRouter::SetByteAt(uint16_t address, uint8_t byte) {
   AddressOwner owner = ownerForAddress(address);
   SetByteAtAddressInOwner(owner, address, byte);
@@ -235,8 +243,9 @@ uint16_t AddressRouter::GetWordAt(uint16_t address) {
   AddressOwner owner_lsb = ownerForAddress(address);
   AddressOwner owner_msb = ownerForAddress(address + 1);
   if (owner_lsb != owner_msb) {
-    cout << "Unexpected cross owner get at 0x" << hex << unsigned(address)
-         << " +1" << endl;
+    if (logger_) {
+      logger_->Line() << "Unexpected cross owner get at 0x" << hex << unsigned(address) << " +1";
+    }
     assert(false);
   }
 
@@ -251,8 +260,9 @@ void AddressRouter::SetWordAt(uint16_t address, uint16_t word) {
   AddressOwner owner_lsb = ownerForAddress(address);
   AddressOwner owner_msb = ownerForAddress(address + 1);
   if (owner_lsb != owner_msb) {
-    cout << "Unexpected cross owner set at 0x" << hex << unsigned(address)
-         << " +1" << endl;
+    if (logger_) {
+      logger_->Line() << "Unexpected cross owner set at 0x" << hex << unsigned(address) << " +1";
+    }
     assert(false);
   }
 
@@ -346,4 +356,15 @@ void AddressRouter::SkipBootROM() {
   ss.ram[0xFF4B - 0x8000] = 0x00;
 
   LoadState(ss);
+
+  // LoadState leaves the IO registers alone, so the ones the boot ROM leaves
+  // behind in the PPU are set directly. This turns the LCD on.
+  ppu_->SetByteAt(0xFF40, 0x91);
+  ppu_->SetByteAt(0xFF41, 0x85);
+  ppu_->SetByteAt(0xFF47, 0xFC);
+}
+
+void AddressRouter::ForkFrom(AddressRouter &other) {
+  disassemblerMode_ = other.disassemblerMode_;
+  dma_base_ = other.dma_base_;
 }
@@ -0,0 +1,62 @@
+#include "audio_ring_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+AudioRingBuffer::AudioRingBuffer(int capacity)
+    : write_pos_(0), read_pos_(0), overruns_(0), underruns_(0) {
+  assert(capacity > 0);
+  // Round up to a power of two so positions wrap with a mask.
+  capacity_ = 1;
+  while (capacity_ < capacity) {
+    capacity_ <<= 1;
+  }
+  mask_ = capacity_ - 1;
+  samples_ = new int16_t[capacity_]();
+}
+
+AudioRingBuffer::~AudioRingBuffer() { delete[] samples_; }
+
+int AudioRingBuffer::Write(const int16_t *samples, int count) {
+  uint32_t write_pos = write_pos_.load(std::memory_order_relaxed);
+  uint32_t read_pos = read_pos_.load(std::memory_order_acquire);
+  int space = capacity_ - (int)(write_pos - read_pos);
+  int to_write = std::min(count, space);
+  if (to_write < count) {
+    overruns_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // At most two copies, either side of the wrap.
+  int start = write_pos & mask_;
+  int first = std::min(to_write, capacity_ - start);
+  memcpy(samples_ + start, samples, first * sizeof(int16_t));
+  memcpy(samples_, samples + first, (to_write - first) * sizeof(int16_t));
+
+  write_pos_.store(write_pos + to_write, std::memory_order_release);
+  return to_write;
+}
+
+int AudioRingBuffer::Read(int16_t *samples, int count) {
+  uint32_t read_pos = read_pos_.load(std::memory_order_relaxed);
+  uint32_t write_pos = write_pos_.load(std::memory_order_acquire);
+  int available = (int)(write_pos - read_pos);
+  int to_read = std::min(count, available);
+  if (to_read < count) {
+    underruns_.fetch_add(1, std::memory_order_relaxed);
+    memset(samples + to_read, 0, (count - to_read) * sizeof(int16_t));
+  }
+
+  int start = read_pos & mask_;
+  int first = std::min(to_read, capacity_ - start);
+  memcpy(samples, samples_ + start, first * sizeof(int16_t));
+  memcpy(samples + first, samples_, (to_read - first) * sizeof(int16_t));
+
+  read_pos_.store(read_pos + to_read, std::memory_order_release);
+  return to_read;
+}
+
+int AudioRingBuffer::Available() const {
+  return (int)(write_pos_.load(std::memory_order_acquire) -
+               read_pos_.load(std::memory_order_acquire));
+}
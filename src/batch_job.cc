@@ -0,0 +1,143 @@
+#include "batch_job.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "emulator.h"
+
+static bool SkipLine(const string &line) {
+  size_t start = line.find_first_not_of(" \t\r");
+  return start == string::npos || line[start] == '#';
+}
+
+static string ResolvePath(const string &base_dir, const string &path) {
+  if (path == "-") {
+    return "";
+  }
+  if (base_dir.empty() || filesystem::path(path).is_absolute()) {
+    return path;
+  }
+  return (filesystem::path(base_dir) / path).string();
+}
+
+static bool ReadFile(const string &path, vector<uint8_t> &data) {
+  ifstream file(path, ios::binary);
+  if (!file) {
+    return false;
+  }
+  data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+  return true;
+}
+
+bool ReadManifest(istream &in, const string &base_dir, vector<BatchJob> &jobs,
+                  string &error) {
+  string line;
+  int line_number = 0;
+  while (getline(in, line)) {
+    line_number++;
+    if (SkipLine(line)) {
+      continue;
+    }
+    istringstream fields(line);
+    string rom, state, input, extra;
+    BatchJob job;
+    if (!(fields >> rom >> state >> input >> job.frames) || (fields >> extra) ||
+        rom == "-" || job.frames < 0) {
+      error = "Manifest line " + to_string(line_number) +
+              " should be \"rom state input frames\": " + line;
+      return false;
+    }
+    job.rom_path = ResolvePath(base_dir, rom);
+    job.state_path = ResolvePath(base_dir, state);
+    job.input_path = ResolvePath(base_dir, input);
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+bool ReadInputScript(istream &in, vector<InputEvent> &events, string &error) {
+  string line;
+  int line_number = 0;
+  while (getline(in, line)) {
+    line_number++;
+    if (SkipLine(line)) {
+      continue;
+    }
+    istringstream fields(line);
+    int64_t frame;
+    string buttons, extra;
+    bool ok = (bool)(fields >> frame >> buttons) && !(fields >> extra) && frame >= 0;
+    char *end = nullptr;
+    unsigned long mask = ok ? strtoul(buttons.c_str(), &end, 0) : 0;
+    if (!ok || *end != '\0' || mask > 0xFF ||
+        (!events.empty() && frame < events.back().frame)) {
+      error = "Input line " + to_string(line_number) +
+              " should be \"frame buttons\", in frame order: " + line;
+      return false;
+    }
+    events.push_back({frame, (uint8_t)mask});
+  }
+  return true;
+}
+
+BatchResult RunBatchJob(const BatchJob &job, int64_t rtc_time) {
+  BatchResult result;
+  auto start = chrono::steady_clock::now();
+
+  vector<uint8_t> rom;
+  if (!ReadFile(job.rom_path, rom)) {
+    result.error = "Can't read ROM " + job.rom_path;
+    return result;
+  }
+  vector<InputEvent> events;
+  if (!job.input_path.empty()) {
+    ifstream input(job.input_path);
+    if (!input) {
+      result.error = "Can't read input script " + job.input_path;
+      return result;
+    }
+    if (!ReadInputScript(input, events, result.error)) {
+      return result;
+    }
+  }
+
+  // Nothing listens to a batch job's audio.
+  EmulatorOptions options;
+  options.audio_buffer_ms = 0;
+  options.rtc_time = rtc_time;
+  options.log = [&result](const string &line) { result.log += line + "\n"; };
+  Emulator *emulator = Emulator::Create(rom.data(), rom.size(), options);
+  if (!emulator) {
+    result.error = "Unsupported ROM " + job.rom_path;
+    return result;
+  }
+  if (!job.state_path.empty()) {
+    vector<uint8_t> state;
+    if (!ReadFile(job.state_path, state) || !emulator->Restore(state.data(), state.size())) {
+      result.error = "Can't restore " + job.state_path;
+      delete emulator;
+      return result;
+    }
+  }
+
+  // Script frames count from the start of the job.
+  size_t next_event = 0;
+  for (int frame = 0; frame < job.frames; frame++) {
+    while (next_event < events.size() && events[next_event].frame <= frame) {
+      emulator->SetInput(events[next_event].buttons);
+      next_event++;
+    }
+    emulator->RunFrame();
+  }
+
+  result.frame_hash = emulator->FrameHash();
+  result.snapshot = emulator->Snapshot();
+  result.serial_output = emulator->serial_output();
+  delete emulator;
+  result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return result;
+}
@@ -0,0 +1,144 @@
+// edge_batch runs many emulator sessions at once, one per job in a manifest,
+// on a thread pool sized to the machine. Each job writes <n>.state (a
+// snapshot to resume from) and <n>.serial to the output directory, and a line
+// of results.tsv with its final frame hash and timing. What the emulators
+// log goes to log.txt, grouped by job.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "batch_job.h"
+#include "job_pool.h"
+#include "utils.h"
+
+static bool WriteFile(const std::string &path, const void *data, size_t size) {
+  std::ofstream file(path, std::ios::binary);
+  file.write((const char *)data, size);
+  return (bool)file;
+}
+
+// More pool threads than this is surely a typo.
+const int MAX_THREADS = 1024;
+
+static std::string Hex(uint64_t value) {
+  char text[17];
+  snprintf(text, sizeof(text), "%016llx", (unsigned long long)value);
+  return text;
+}
+
+int main(int argc, char *argv[]) {
+  // --threads N runs N jobs at once rather than one per hardware thread.
+  // --pin keeps each pool thread on its own CPU.
+  // --rtc-time SECONDS pins cartridge clocks, so runs repeat exactly.
+  int threads = 0;
+  bool pin = false;
+  int64_t rtc_time = 0;
+  std::vector<std::string> args;
+  bool bad_arg = false;
+  for (int i = 1; i < argc && !bad_arg; i++) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      bad_arg = !ParseInt(argv[++i], threads) || threads <= 0 || threads > MAX_THREADS;
+      if (bad_arg) {
+        std::cerr << "Threads must be between 1 and " << MAX_THREADS << std::endl;
+      }
+    } else if (arg == "--pin") {
+      pin = true;
+    } else if (arg == "--rtc-time" && i + 1 < argc) {
+      bad_arg = !ParseInt64(argv[++i], rtc_time) || rtc_time < 0;
+      if (bad_arg) {
+        std::cerr << "RTC time must be seconds since the epoch" << std::endl;
+      }
+    } else {
+      args.push_back(arg);
+    }
+  }
+  if (bad_arg || args.size() != 2) {
+    std::cerr << "Usage: [--threads N] [--pin] [--rtc-time SECONDS] manifest.txt OutputDirectory" << std::endl;
+    return 1;
+  }
+
+  std::string manifest_path = args[0];
+  std::string output_dir = args[1];
+  std::ifstream manifest(manifest_path);
+  if (!manifest) {
+    std::cerr << "Can't read manifest " << manifest_path << std::endl;
+    return 1;
+  }
+  std::vector<BatchJob> jobs;
+  std::string error;
+  if (!ReadManifest(manifest, std::filesystem::path(manifest_path).parent_path().string(), jobs,
+                    error)) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(output_dir, ec);
+  if (ec) {
+    std::cerr << "Error creating directory: " << output_dir << " - " << ec.message() << std::endl;
+    return 1;
+  }
+
+  std::vector<BatchResult> results(jobs.size());
+  auto start = std::chrono::steady_clock::now();
+  int thread_count;
+  {
+    JobPool pool(threads, pin);
+    thread_count = pool.thread_count();
+    for (size_t i = 0; i < jobs.size(); i++) {
+      pool.Submit([&jobs, &results, &output_dir, rtc_time, i] {
+        BatchResult &result = results[i];
+        result = RunBatchJob(jobs[i], rtc_time);
+        if (!result.error.empty()) {
+          return;
+        }
+        std::string prefix = output_dir + "/" + std::to_string(i);
+        if (!WriteFile(prefix + ".state", result.snapshot.data(), result.snapshot.size()) ||
+            !WriteFile(prefix + ".serial", result.serial_output.data(),
+                       result.serial_output.size())) {
+          result.error = "Can't write " + prefix + " outputs";
+        }
+        // Written out, so don't hold every job's state until the end.
+        result.snapshot = std::vector<uint8_t>();
+      });
+    }
+    pool.Wait();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::ofstream log(output_dir + "/log.txt");
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (!results[i].log.empty()) {
+      log << "==== Job " << i << ": " << jobs[i].rom_path << std::endl << results[i].log;
+    }
+  }
+
+  std::ofstream summary(output_dir + "/results.tsv");
+  summary << "job\trom\tframes\tframe_hash\tseconds\tframes_per_second\terror" << std::endl;
+  int64_t total_frames = 0;
+  int failed = 0;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const BatchResult &result = results[i];
+    bool ok = result.error.empty();
+    summary << i << "\t" << jobs[i].rom_path << "\t" << jobs[i].frames << "\t"
+            << (ok ? Hex(result.frame_hash) : "-") << "\t" << result.seconds << "\t"
+            << (ok && result.seconds > 0 ? jobs[i].frames / result.seconds : 0) << "\t"
+            << result.error << std::endl;
+    if (ok) {
+      total_frames += jobs[i].frames;
+    } else {
+      failed++;
+      std::cerr << "Job " << i << ": " << result.error << std::endl;
+    }
+  }
+
+  std::cerr << jobs.size() << " jobs (" << failed << " failed), " << total_frames << " frames in "
+            << seconds << " s on " << thread_count << " threads: " << total_frames / seconds
+            << " frames/s" << std::endl;
+  return failed ? 1 : 0;
+}
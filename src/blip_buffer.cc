@@ -0,0 +1,133 @@
+#include "blip_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+int16_t BlipBuffer::kernel_[BlipBuffer::PHASES + 1][BlipBuffer::WIDTH];
+
+// Cutoff as a fraction of the output Nyquist frequency. Leaves room for the
+// window's transition band.
+const double CUTOFF = 0.9;
+
+void BlipBuffer::InitKernel() {
+  for (int phase = 0; phase <= PHASES; phase++) {
+    double center = WIDTH / 2 - 1 + double(phase) / PHASES;
+    double taps[WIDTH];
+    double total = 0;
+    for (int i = 0; i < WIDTH; i++) {
+      double t = i - center;
+      double x = M_PI * CUTOFF * t;
+      double sinc = (x == 0) ? 1.0 : sin(x) / x;
+      // Blackman window over the width of the kernel.
+      double w = 2 * M_PI * t / WIDTH;
+      double window = 0.42 + 0.5 * cos(w) + 0.08 * cos(2 * w);
+      taps[i] = sinc * window;
+      total += taps[i];
+    }
+
+    // Scale to fixed point, then put the rounding error on the largest tap so
+    // each step adds exactly its delta.
+    int sum = 0;
+    int largest = 0;
+    for (int i = 0; i < WIDTH; i++) {
+      kernel_[phase][i] = (int16_t)lround(taps[i] * (1 << KERNEL_BITS) / total);
+      sum += kernel_[phase][i];
+      if (abs(kernel_[phase][i]) > abs(kernel_[phase][largest])) {
+        largest = i;
+      }
+    }
+    kernel_[phase][largest] += (1 << KERNEL_BITS) - sum;
+  }
+}
+
+BlipBuffer::BlipBuffer(int max_samples) {
+  // Emulators may be made on several threads at once.
+  static std::once_flag once;
+  std::call_once(once, InitKernel);
+  size_ = max_samples + WIDTH + 1;
+  samples_ = new int32_t[2 * size_]();
+}
+
+BlipBuffer::~BlipBuffer() { delete[] samples_; }
+
+// Corner of the DC blocking filter, whatever the sample rate.
+const double BASS_HZ = 15;
+
+void BlipBuffer::SetRates(double clock_rate, double sample_rate) {
+  bass_shift_ = std::max(1, (int)lround(log2(sample_rate / (2 * M_PI * BASS_HZ))));
+  next_factor_ = (uint64_t)llround(sample_rate / clock_rate * ((uint64_t)1 << FRAC_BITS));
+  if (factor_ == 0) {
+    factor_ = next_factor_;
+  }
+}
+
+void BlipBuffer::AddDelta(int time, int left, int right) {
+  uint64_t fixed = (uint64_t)time * factor_ + offset_;
+  int index = (int)(fixed >> FRAC_BITS);
+  int phase = (int)(fixed >> (FRAC_BITS - PHASE_BITS)) & (PHASES - 1);
+  int interp = (int)(fixed >> (FRAC_BITS - PHASE_BITS - INTERP_BITS)) & ((1 << INTERP_BITS) - 1);
+  assert(index + WIDTH <= size_);
+
+  // Blend the two nearest phases. The two parts always add up to the delta.
+  int left2 = (left * interp) >> INTERP_BITS;
+  int left1 = left - left2;
+  int right2 = (right * interp) >> INTERP_BITS;
+  int right1 = right - right2;
+  const int16_t *kernel1 = kernel_[phase];
+  const int16_t *kernel2 = kernel_[phase + 1];
+  int32_t *out = samples_ + 2 * index;
+  for (int i = 0; i < WIDTH; i++) {
+    out[2 * i] += kernel1[i] * left1 + kernel2[i] * left2;
+    out[2 * i + 1] += kernel1[i] * right1 + kernel2[i] * right2;
+  }
+}
+
+void BlipBuffer::EndFrame(int duration) {
+  offset_ += (uint64_t)duration * factor_;
+  factor_ = next_factor_;
+  assert(SamplesAvailable() + WIDTH <= size_);
+}
+
+int BlipBuffer::ReadSamples(int16_t *out, int count) {
+  count = std::min(count, SamplesAvailable());
+
+  for (int channel = 0; channel < 2; channel++) {
+    int64_t sum = integrator_[channel];
+    for (int i = 0; i < count; i++) {
+      int sample = (int)(sum >> KERNEL_BITS);
+      sample = std::max(-32768, std::min(sample, 32767));
+      out[2 * i + channel] = (int16_t)sample;
+      sum += samples_[2 * i + channel];
+      sum -= sum >> bass_shift_;
+    }
+    integrator_[channel] = sum;
+  }
+
+  // Shift the unread samples, and the tails of steps past them, down.
+  int remaining = SamplesAvailable() - count + WIDTH;
+  memmove(samples_, samples_ + 2 * count, 2 * remaining * sizeof(int32_t));
+  memset(samples_ + 2 * remaining, 0, 2 * count * sizeof(int32_t));
+  offset_ -= (uint64_t)count << FRAC_BITS;
+  return count;
+}
+
+void BlipBuffer::Clear() {
+  memset(samples_, 0, 2 * size_ * sizeof(int32_t));
+  offset_ = 0;
+  integrator_[0] = 0;
+  integrator_[1] = 0;
+}
+
+void BlipBuffer::CopyFrom(const BlipBuffer &other) {
+  assert(other.size_ == size_);
+  memcpy(samples_, other.samples_, 2 * size_ * sizeof(int32_t));
+  factor_ = other.factor_;
+  next_factor_ = other.next_factor_;
+  offset_ = other.offset_;
+  integrator_[0] = other.integrator_[0];
+  integrator_[1] = other.integrator_[1];
+  bass_shift_ = other.bass_shift_;
+}
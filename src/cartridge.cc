@@ -13,6 +13,7 @@
 #include <time.h>
 
 #include "constants.h"
+#include "logger.h"
 #include "utils.h"
 
 const int RTC_SECONDS_REGISTER = 0x08;
@@ -39,18 +40,40 @@ uint8_t *UnsignedCartridgeBytes(string filename) {
   for (uint32_t i = 0; i < rom_size; i++) {
     rom[i] = unsigned_contents[i];
   }
+  delete[] unsigned_contents;
   file.close();
 
   return rom;
 }
 
-Cartridge::Cartridge(string filename)
-  : rtc_previous_session_duration_(0),
+static uint8_t *CopyBytes(const uint8_t *bytes, size_t size) {
+  uint8_t *copy = new uint8_t[size];
+  memcpy(copy, bytes, size);
+  return copy;
+}
+
+Cartridge::Cartridge(string filename) : Cartridge(UnsignedCartridgeBytes(filename)) {}
+
+Cartridge::Cartridge(const uint8_t *rom, size_t size) : Cartridge(CopyBytes(rom, size)) {}
+
+Cartridge::Cartridge(uint8_t *rom)
+    : Cartridge(shared_ptr<uint8_t>(rom, default_delete<uint8_t[]>())) {}
+
+Cartridge::Cartridge(shared_ptr<uint8_t> rom)
+  : rom_hash_(0),
+    ram_rtc_enable_(0),
+    ram_bank_rtc_(0),
+    rtc_latch_register_(0),
+    rtc_latched_(false),
+    rtc_latched_time_(0),
+    rtc_previous_session_duration_(0),
     rtc_session_start_time_(time(nullptr)),
     rtc_current_time_override_(0),
-    rtc_has_override_(false) {
-  rom_ = UnsignedCartridgeBytes(filename);
-  ram_ = new uint8_t[RAMSize()];
+    rtc_has_override_(false),
+    rtc_halted_(false) {
+  shared_rom_ = rom;
+  rom_ = rom.get();
+  ram_ = new PagedMemory(RAMSize());
   // TODO: MBC1 uses a special addressing for large ROMS.
   assert(ROMSize() <= 524288 || GetCartridgeType() == CartridgeType_ROM_MBC3_RAM_BATT);
 }
@@ -68,8 +91,41 @@ void Cartridge::PrintDebugInfo() {
 }
 
 Cartridge::~Cartridge() {
-  free(ram_);
-  free(rom_);
+  delete ram_;
+}
+
+Cartridge *Cartridge::Fork() {
+  Cartridge *fork = new Cartridge(shared_rom_);
+  fork->ForkFrom(*this);
+  return fork;
+}
+
+void Cartridge::ForkFrom(Cartridge &other) {
+  assert(other.rom_ == rom_);
+  rom_hash_ = other.rom_hash_;
+  ram_->Share(*other.ram_);
+  ram_rtc_enable_ = other.ram_rtc_enable_;
+  ram_bank_rtc_ = other.ram_bank_rtc_;
+  rtc_latch_register_ = other.rtc_latch_register_;
+  rtc_latched_ = other.rtc_latched_;
+  rtc_latched_time_ = other.rtc_latched_time_;
+  rtc_previous_session_duration_ = other.rtc_previous_session_duration_;
+  rtc_session_start_time_ = other.rtc_session_start_time_;
+  rtc_current_time_override_ = other.rtc_current_time_override_;
+  rtc_has_override_ = other.rtc_has_override_;
+  rtc_halted_ = other.rtc_halted_;
+}
+
+uint64_t Cartridge::ROMHash() {
+  if (rom_hash_ == 0) {
+    assert(rom_);
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < ROMSize(); i++) {
+      hash = (hash ^ rom_[i]) * 1099511628211ULL;
+    }
+    rom_hash_ = hash;
+  }
+  return rom_hash_;
 }
 
 uint8_t Cartridge::GetROMByteAt(int address) {
@@ -101,7 +157,9 @@ CartridgeType Cartridge::GetCartridgeType() {
     case 0x13:
       return CartridgeType_ROM_MBC3_RAM_BATT;
     default:
-      std::cout << "Unsupported cartridge type: " << std::hex << (int)ctbyte << std::endl;
+      if (logger_) {
+        logger_->Line() << "Unsupported cartridge type: " << hex << (int)ctbyte;
+      }
       return CartridgeType_Unsupported;
   }
 }
@@ -138,7 +196,9 @@ RAMSizeType Cartridge::GetRAMSizeType() {
     case 0x00:
       return RAMSize_0k;
     case 0x01:
-      std::cout << "Impossible RAM size: " << std::hex << (int)ctbyte << std::endl;
+      if (logger_) {
+        logger_->Line() << "Impossible RAM size: " << hex << (int)ctbyte;
+      }
       assert(false);
       return RAMSize_Unknown;
     case 0x02:
@@ -150,7 +210,9 @@ RAMSizeType Cartridge::GetRAMSizeType() {
     case 0x05:
       return RAMSize_64k;
     default:
-      std::cout << "Unsupported RAM size: " << std::hex << (int)ctbyte << std::endl;
+      if (logger_) {
+        logger_->Line() << "Unsupported RAM size: " << hex << (int)ctbyte;
+      }
       assert(false);
       return RAMSize_Unsupported;
   }
@@ -226,7 +288,9 @@ uint8_t Cartridge::GetRTC() {
              (GetRTCHalted() ? 0x40 : 0) |
              (GetRTCDayCarry() ? 0x80 : 0);
     default:
-      std::cout << "Unknown RTC Register: " << std::hex << int(ram_bank_rtc_) << std::endl;
+      if (logger_) {
+        logger_->Line() << "Unknown RTC Register: " << hex << int(ram_bank_rtc_);
+      }
       assert(false);
       return 0;
   }
@@ -249,8 +313,10 @@ void Cartridge::SetRTC(uint8_t byte) {
   }
 
   // std::cout << "PSD : " << int(rtc_previous_session_duration_) << " byte: " << std::dec << int(byte) << std::endl;
-  std::cout << int(GetRTCSeconds()) << ":" << int(GetRTCMinutes()) << ":" << int(GetRTCHours()) << ": " << int(GetRTCDays()) << std::endl;
-  std::cout << std::dec << int(byte) << std::endl;  
+  if (logger_) {
+    logger_->Line() << "RTC " << int(GetRTCSeconds()) << ":" << int(GetRTCMinutes()) << ":"
+                    << int(GetRTCHours()) << ": " << int(GetRTCDays()) << " set to " << int(byte);
+  }
 
 
   switch (ram_bank_rtc_) {
@@ -270,8 +336,10 @@ void Cartridge::SetRTC(uint8_t byte) {
       rtc_previous_session_duration_ += 86400 * (bit_set(byte, 0) ? 256 : 0 - (GetRTCDays() & 0x100));
       break;
   }
-  std::cout << " After " << int(rtc_previous_session_duration_) << std::endl;
-  std::cout << int(GetRTCSeconds()) << ":" << int(GetRTCMinutes()) << ":" << int(GetRTCHours()) << ": " << int(GetRTCDays()) << std::endl;
+  if (logger_) {
+    logger_->Line() << " After " << int(rtc_previous_session_duration_) << " " << int(GetRTCSeconds())
+                    << ":" << int(GetRTCMinutes()) << ":" << int(GetRTCHours()) << ": " << int(GetRTCDays());
+  }
 
   if (!GetRTCHalted()) {
     // There is a race condition here, but it's OK since they should have set the halting.
@@ -285,7 +353,7 @@ uint8_t Cartridge::GetRAM(int address) {
     // Ignore reads from out of bounds RAM (restoring, cartridge errors).
     return 0xFF;
   }
-  uint8_t byte = ram_[banked_address];
+  uint8_t byte = ram_->Get(banked_address);
   if (IsMBC2()) {
     // Half bytes of RAM - upper 4 bits are unreliable.
     byte &= 0x0F;
@@ -304,7 +372,7 @@ void Cartridge::SetRAM(int address, uint8_t byte) {
     return;
   }
 
-  ram_[banked_address] = byte;
+  ram_->Set(banked_address, byte);
 }
 
 int Cartridge::GetBankedRAMAddress(int address) {
@@ -344,7 +412,9 @@ void Cartridge::SetRAMRTCEnable(uint8_t byte) {
 
 void Cartridge::SetRAMBankRTC(uint8_t byte) {
   if (byte > RTC_DAYS_HIGH_CARRY_HALT_REGISTER) {
-    std::cout << "Unexpected too high value for SetRAMBankRTC: " << std::hex << (int)byte << std::endl;
+    if (logger_) {
+      logger_->Line() << "Unexpected too high value for SetRAMBankRTC: " << hex << (int)byte;
+    }
     assert(false);
   }
   if (byte >= RTC_SECONDS_REGISTER) {
@@ -437,7 +507,7 @@ void Cartridge::SetState(const struct CartridgeSaveState &state) {
   rtc_halted_ = state.rtc_halted;
   
   if (state.ram && state.ram_size > 0) {
-    memcpy(ram_, state.ram, std::min<uint32_t>(state.ram_size, RAMSize()));
+    ram_->Write(0, state.ram, std::min<uint32_t>(state.ram_size, RAMSize()));
   }
 }
 
@@ -451,6 +521,8 @@ void Cartridge::GetState(struct CartridgeSaveState& state) {
   state.rtc_latched_time = rtc_latched_time_;
   state.rtc_halted = rtc_halted_;
   state.ram_size = RAMSize();
-  state.ram = ram_;
+  ram_copy_.resize(RAMSize());
+  ram_->Read(0, ram_copy_.data(), ram_copy_.size());
+  state.ram = ram_copy_.data();
 }
 
@@ -18,6 +18,12 @@ AbstractCommandFactory::AbstractCommandFactory() {
   commands = array<Command *, 256>();
 }
 
+AbstractCommandFactory::~AbstractCommandFactory() {
+  for (Command *command : commands) {
+    delete command;
+  }
+}
+
 void AbstractCommandFactory::RegisterCommand(Command *command) {
   Command *existingCommand = commands[command->opcode];
   if (existingCommand != NULL) {
@@ -0,0 +1,251 @@
+#include "control_server.h"
+
+#include <cstring>
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "address_router.h"
+#include "emulator.h"
+#include "screen.h"
+
+#ifndef MSG_NOSIGNAL
+// macOS has SO_NOSIGPIPE instead, set on each socket.
+#define MSG_NOSIGNAL 0
+#endif
+
+// Bytes read from a client at a time.
+const size_t READ_CHUNK = 64 * 1024;
+
+static bool SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+ControlServer *ControlServer::Create(const string &path, Emulator *emulator,
+                                     FrameStepper *stepper) {
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    cout << "Control socket path must be 1 to " << sizeof(address.sun_path) - 1
+         << " characters: " << path << endl;
+    return nullptr;
+  }
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    cout << "Could not create control socket: " << strerror(errno) << endl;
+    return nullptr;
+  }
+  unlink(path.c_str());
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 64) != 0 ||
+      !SetNonBlocking(fd)) {
+    cout << "Could not listen on control socket " << path << ": " << strerror(errno) << endl;
+    close(fd);
+    return nullptr;
+  }
+  return new ControlServer(path, fd, emulator, stepper);
+}
+
+ControlServer::ControlServer(const string &path, int listen_fd, Emulator *emulator,
+                             FrameStepper *stepper)
+    : path_(path), listen_fd_(listen_fd), emulator_(emulator), stepper_(stepper) {}
+
+ControlServer::~ControlServer() {
+  for (Client &client : clients_) {
+    close(client.fd);
+  }
+  close(listen_fd_);
+  unlink(path_.c_str());
+}
+
+int ControlServer::Poll(int timeout_ms) {
+  vector<struct pollfd> fds(clients_.size() + 1);
+  fds[0] = {listen_fd_, POLLIN, 0};
+  for (size_t i = 0; i < clients_.size(); i++) {
+    bool writing = clients_[i].out_offset < clients_[i].out.size();
+    fds[i + 1] = {clients_[i].fd, (short)(POLLIN | (writing ? POLLOUT : 0)), 0};
+  }
+  if (poll(fds.data(), fds.size(), timeout_ms) <= 0) {
+    return 0;
+  }
+
+  int served = 0;
+  // Backwards, so dropping a client doesn't move the ones still to come.
+  for (size_t i = clients_.size(); i-- > 0;) {
+    if (!fds[i + 1].revents) {
+      continue;
+    }
+    Client &client = clients_[i];
+    // Requests sent just before hanging up are still answered.
+    bool open = Read(client);
+    served += Serve(client);
+    if (!Write(client) || !open) {
+      close(client.fd);
+      clients_.erase(clients_.begin() + i);
+    }
+  }
+  if (fds[0].revents & POLLIN) {
+    Accept();
+  }
+  return served;
+}
+
+void ControlServer::Accept() {
+  while (true) {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      return;
+    }
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    if (!SetNonBlocking(fd)) {
+      close(fd);
+      continue;
+    }
+    Client client;
+    client.fd = fd;
+    clients_.push_back(client);
+  }
+}
+
+bool ControlServer::Read(Client &client) {
+  while (true) {
+    size_t size = client.in.size();
+    client.in.resize(size + READ_CHUNK);
+    ssize_t count = recv(client.fd, client.in.data() + size, READ_CHUNK, 0);
+    client.in.resize(size + (count > 0 ? count : 0));
+    if (count > 0) {
+      continue;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      return true;
+    }
+    // Hung up, or failed.
+    return false;
+  }
+}
+
+bool ControlServer::Write(Client &client) {
+  while (client.out_offset < client.out.size()) {
+    ssize_t count = send(client.fd, client.out.data() + client.out_offset,
+                         client.out.size() - client.out_offset, MSG_NOSIGNAL);
+    if (count < 0) {
+      // The rest goes once the socket has room.
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    client.out_offset += count;
+  }
+  client.out.clear();
+  client.out_offset = 0;
+  return true;
+}
+
+int ControlServer::Serve(Client &client) {
+  int served = 0;
+  size_t offset = 0;
+  while (client.in.size() - offset >= sizeof(ControlHeader)) {
+    ControlHeader header;
+    memcpy(&header, client.in.data() + offset, sizeof(header));
+    if (header.length > MAX_CONTROL_PAYLOAD) {
+      // The stream can't be trusted to be in step any more.
+      Respond(client, header.op, ControlStatus_BadPayload, nullptr, 0);
+      Write(client);
+      shutdown(client.fd, SHUT_RDWR);
+      client.in.clear();
+      return served;
+    }
+    if (client.in.size() - offset - sizeof(header) < header.length) {
+      break;
+    }
+    Execute(client, header.op, client.in.data() + offset + sizeof(header), header.length);
+    offset += sizeof(header) + header.length;
+    served++;
+  }
+  client.in.erase(client.in.begin(), client.in.begin() + offset);
+  return served;
+}
+
+void ControlServer::Respond(Client &client, uint8_t op, uint8_t status, const void *payload,
+                            size_t size) {
+  ControlHeader header = {op, status, 0, (uint32_t)size};
+  const uint8_t *bytes = (const uint8_t *)&header;
+  client.out.insert(client.out.end(), bytes, bytes + sizeof(header));
+  if (size) {
+    bytes = (const uint8_t *)payload;
+    client.out.insert(client.out.end(), bytes, bytes + size);
+  }
+}
+
+void ControlServer::Execute(Client &client, uint8_t op, const uint8_t *payload, uint32_t size) {
+  switch (op) {
+    case ControlOp_Step: {
+      uint32_t frames;
+      if (size != sizeof(frames)) {
+        break;
+      }
+      memcpy(&frames, payload, sizeof(frames));
+      for (uint32_t i = 0; i < frames; i++) {
+        if (stepper_) {
+          stepper_->StepFrame();
+        } else {
+          emulator_->RunFrame();
+        }
+      }
+      uint64_t result[2] = {(uint64_t)emulator_->frame_count(), emulator_->FrameHash()};
+      Respond(client, op, ControlStatus_OK, result, sizeof(result));
+      return;
+    }
+    case ControlOp_SetInput:
+      if (size != 1) {
+        break;
+      }
+      emulator_->SetInput(payload[0]);
+      Respond(client, op, ControlStatus_OK, nullptr, 0);
+      return;
+    case ControlOp_Snapshot: {
+      if (size != 0) {
+        break;
+      }
+      vector<uint8_t> snapshot = emulator_->Snapshot();
+      Respond(client, op, ControlStatus_OK, snapshot.data(), snapshot.size());
+      return;
+    }
+    case ControlOp_Restore: {
+      bool restored = emulator_->Restore(payload, size);
+      Respond(client, op, restored ? ControlStatus_OK : ControlStatus_RestoreFailed, nullptr, 0);
+      return;
+    }
+    case ControlOp_ReadMemory: {
+      uint16_t request[2];
+      if (size != sizeof(request)) {
+        break;
+      }
+      memcpy(request, payload, sizeof(request));
+      int count = request[1] ? request[1] : 0x10000;
+      vector<uint8_t> bytes(count);
+      for (int i = 0; i < count; i++) {
+        bytes[i] = emulator_->router()->PeekByteAt((uint16_t)(request[0] + i));
+      }
+      Respond(client, op, ControlStatus_OK, bytes.data(), bytes.size());
+      return;
+    }
+    case ControlOp_Framebuffer:
+      if (size != 0) {
+        break;
+      }
+      Respond(client, op, ControlStatus_OK, emulator_->framebuffer(), SCREEN_PIXELS * sizeof(uint32_t));
+      return;
+    default:
+      Respond(client, op, ControlStatus_UnknownOp, nullptr, 0);
+      return;
+  }
+  Respond(client, op, ControlStatus_BadPayload, nullptr, 0);
+}
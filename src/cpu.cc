@@ -8,6 +8,7 @@
 #include "constants.h"
 #include "command.h"
 #include "interrupt_controller.h"
+#include "logger.h"
 #include "ppu.h"
 #include "utils.h"
 
@@ -19,7 +20,10 @@ CPU::CPU(AddressRouter *address_router) {
   Reset();
 }
 
-CPU::~CPU() {}
+CPU::~CPU() {
+  delete commandFactory_;
+  delete cbCommandFactory_;
+}
 
 Command *CPU::CommandForOpcode(uint8_t opcode) {
   if (opcode == 0xCB) {
@@ -38,7 +42,9 @@ int CPU::Step() {
     haltNextLoop_ = false;
     interrupt_controller_->HaltUntilInterrupt();  // halt until interrupt.
   } else if (stopNextLoop_) {
-    cout << "SUSPICIOUS: Stop not implemented!!" << endl;
+    if (logger_) {
+      logger_->Line() << "SUSPICIOUS: Stop not implemented!!";
+    }
     stopNextLoop_ = false;
     // assert(false);
   }
@@ -152,8 +158,9 @@ uint8_t CPU::Get8Bit(Destination destination) {
         break;
     }
     default:
-      cout << "Unknown 8 bit destination: 0x" << hex << unsigned(destination)
-           << endl;
+      if (logger_) {
+        logger_->Line() << "Unknown 8 bit destination: 0x" << hex << unsigned(destination);
+      }
       assert(false);
       return 0xED;
   }
@@ -179,8 +186,9 @@ uint16_t CPU::Get16Bit(Destination destination) {
     case Address_0xFF00_Byte:
     case Address_nn_16bit:
     case Address_0xFF00_Register_C:
-      cout << "Tried reading 0x" << hex << unsigned(destination)
-           << " as a 16 bit value." << endl;
+      if (logger_) {
+        logger_->Line() << "Tried reading 0x" << hex << unsigned(destination) << " as a 16 bit value.";
+      }
       assert(false);
     case Register_AF:
       return buildMsbLsb16(a_, Get8Bit(Register_F));
@@ -200,8 +208,9 @@ uint16_t CPU::Get16Bit(Destination destination) {
       AdvancePC();
       return word;
     default:
-      cout << "Unknown desination for get: 0x" << hex << unsigned(destination)
-           << endl;
+      if (logger_) {
+        logger_->Line() << "Unknown desination for get: 0x" << hex << unsigned(destination);
+      }
       assert(false);
   }
   return 0xDEAD;
@@ -246,8 +255,9 @@ void CPU::Set8Bit(Destination destination, uint8_t value) {
       address_router_->SetByteAt(Get16Bit(Register_HL), value);
       break;
     case Address_SP:
-      cout << "Consider moving the SP on set? How is it happening elsewhere?"
-           << endl;
+      if (logger_) {
+        logger_->Line() << "Consider moving the SP on set? How is it happening elsewhere?";
+      }
       assert(false);
       address_router_->SetByteAt(Get16Bit(Register_SP), value);
       break;
@@ -266,8 +276,9 @@ void CPU::Set8Bit(Destination destination, uint8_t value) {
       assert(false);
       break;
     default:
-      cout << "Unknown 8 bit destination: 0x" << hex << unsigned(destination)
-           << endl;
+      if (logger_) {
+        logger_->Line() << "Unknown 8 bit destination: 0x" << hex << unsigned(destination);
+      }
       assert(false);
   }
 }
@@ -286,8 +297,9 @@ void CPU::Set16Bit(Destination destination, uint16_t value) {
     case Eat_PC_Byte:
     case Address_0xFF00_Byte:
     case Address_0xFF00_Register_C:
-      cout << "0x" << hex << unsigned(destination) << " is not 16 bits."
-           << endl;
+      if (logger_) {
+        logger_->Line() << "0x" << hex << unsigned(destination) << " is not 16 bits.";
+      }
       assert(false);
     case Register_AF:
       a_ = HIGHER8(value);
@@ -329,7 +341,9 @@ void CPU::Set16Bit(Destination destination, uint16_t value) {
       address_router_->SetByteAt(address + 1, HIGHER8(value));
       break;
     default:
-      cout << "Unknown 16 bit set: " << hex << unsigned(destination) << endl;
+      if (logger_) {
+        logger_->Line() << "Unknown 16 bit set: " << hex << unsigned(destination);
+      }
       assert(false);
   }
 }
@@ -388,7 +402,9 @@ void CPU::SetSP(uint16_t sp) {
   bool in_work_ram = sp >= WORK_RAM_START && sp <= WORK_RAM_END;
   bool in_external_ram = sp >= EXTERNAL_RAM_START && sp <= EXTERNAL_RAM_END;
   if (!in_high_ram && !in_work_ram && !in_external_ram) {
-    std::cout << "SetSP: " << std::hex << (int)sp << " is not in valid RAM range" << std::endl;
+    if (logger_) {
+      logger_->Line() << "SetSP: " << hex << (int)sp << " is not in valid RAM range";
+    }
     // assert(false); Some ROMS such as CPU_INSTRS, Pokemon, Final Fantasy set weird SPs.
   }
   sp_ = sp; 
@@ -521,3 +537,12 @@ void CPU::SkipBootROM() {
   ss.sp = 0xFFFE;
   SetState(ss);
 }
+
+void CPU::ForkFrom(CPU &other) {
+  CPUSaveState state;
+  other.GetState(state);
+  SetState(state);
+  cycles_ = other.cycles_;
+  haltNextLoop_ = other.haltNextLoop_;
+  stopNextLoop_ = other.stopNextLoop_;
+}
@@ -0,0 +1,70 @@
+#include "edge.h"
+
+#include <cstring>
+#include <vector>
+
+#include "emulator.h"
+#include "screen.h"
+
+static_assert(EDGE_SCREEN_WIDTH == SCREEN_WIDTH && EDGE_SCREEN_HEIGHT == SCREEN_HEIGHT,
+              "C screen size must match the Screen's");
+static_assert(EDGE_BUTTON_RIGHT == Button_Right && EDGE_BUTTON_START == Button_Start,
+              "C button bits must match Button");
+
+// The opaque handle is the Emulator itself.
+static Emulator *AsEmulator(edge_emulator *emulator) {
+  return reinterpret_cast<Emulator *>(emulator);
+}
+
+void edge_default_options(edge_options *options) {
+  EmulatorOptions defaults;
+  options->sample_rate = defaults.sample_rate;
+  options->resample = defaults.resample;
+  options->audio_buffer_ms = defaults.audio_buffer_ms;
+  options->rtc_time = defaults.rtc_time;
+}
+
+edge_emulator *edge_create(const uint8_t *rom, size_t size, const edge_options *options) {
+  EmulatorOptions emulator_options;
+  if (options) {
+    emulator_options.sample_rate = options->sample_rate;
+    emulator_options.resample = options->resample != 0;
+    emulator_options.audio_buffer_ms = options->audio_buffer_ms;
+    emulator_options.rtc_time = options->rtc_time;
+  }
+  return reinterpret_cast<edge_emulator *>(Emulator::Create(rom, size, emulator_options));
+}
+
+void edge_destroy(edge_emulator *emulator) { delete AsEmulator(emulator); }
+
+void edge_run_frames(edge_emulator *emulator, int count) { AsEmulator(emulator)->RunFrames(count); }
+
+void edge_set_input(edge_emulator *emulator, uint8_t buttons) {
+  AsEmulator(emulator)->SetInput(buttons);
+}
+
+const uint32_t *edge_framebuffer(edge_emulator *emulator) {
+  return AsEmulator(emulator)->framebuffer();
+}
+
+int edge_audio(edge_emulator *emulator, int16_t *samples, int max_samples) {
+  return AsEmulator(emulator)->ReadAudio(samples, max_samples);
+}
+
+size_t edge_snapshot(edge_emulator *emulator, uint8_t *data, size_t size) {
+  std::vector<uint8_t> snapshot = AsEmulator(emulator)->Snapshot();
+  if (data && size >= snapshot.size()) {
+    memcpy(data, snapshot.data(), snapshot.size());
+  }
+  return snapshot.size();
+}
+
+int edge_restore(edge_emulator *emulator, const uint8_t *data, size_t size) {
+  return AsEmulator(emulator)->Restore(data, size) ? 1 : 0;
+}
+
+int64_t edge_frame_count(edge_emulator *emulator) { return AsEmulator(emulator)->frame_count(); }
+
+const char *edge_serial_output(edge_emulator *emulator) {
+  return AsEmulator(emulator)->serial_output().c_str();
+}
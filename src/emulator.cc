@@ -0,0 +1,305 @@
+#include "emulator.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "address_router.h"
+#include "audio_sink.h"
+#include "cartridge.h"
+#include "cpu.h"
+#include "input_controller.h"
+#include "interrupt_controller.h"
+#include "mmu.h"
+#include "polyphase_resampler.h"
+#include "ppu.h"
+#include "screen.h"
+#include "serial_controller.h"
+#include "sound_controller.h"
+#include "timer_controller.h"
+#include "video_sink.h"
+
+// The cartridge header ends at 0x14F.
+const size_t MIN_ROM_SIZE = 0x150;
+
+Emulator::Emulator(Cartridge *cartridge, EmulatorOptions options, VideoSink *video_sink,
+                   AudioSink *audio_sink) {
+  cartridge_ = cartridge;
+  options_ = options;
+  if (audio_sink) {
+    // So forks without a sink of their own make audio at the same rate.
+    options_.sample_rate = audio_sink->sample_rate();
+  }
+  if (options.rtc_time) {
+    cartridge_->SetRTCSessionStartTime(options.rtc_time);
+    cartridge_->SetRTCTimeOverride(options.rtc_time);
+  }
+  mmu_ = new MMU();
+  mmu_->SetCartridge(cartridge_);
+
+  if (!video_sink) {
+    owned_video_sink_ = new HeadlessVideoSink();
+    video_sink = owned_video_sink_;
+  }
+  if (!audio_sink) {
+    if (options.audio_buffer_ms > 0) {
+      buffering_sink_ = new BufferingAudioSink(options.sample_rate,
+                                               options.sample_rate * options.audio_buffer_ms / 1000);
+      owned_audio_sink_ = buffering_sink_;
+    } else {
+      owned_audio_sink_ = new HeadlessAudioSink(options.sample_rate);
+    }
+    audio_sink = owned_audio_sink_;
+  }
+
+  screen_ = new Screen(video_sink);
+  ppu_ = new PPU(screen_);
+
+  serial_controller_ = new SerialController();
+  serial_controller_->set_echo(options.echo_serial);
+  serial_controller_->SetClock(&cycles_);
+  interrupt_controller_ = new InterruptController();
+  input_controller_ = new InputController();
+  input_controller_->SetInterruptHandler(interrupt_controller_);
+  timer_controller_ = new TimerController();
+  timer_controller_->SetInterruptHandler(interrupt_controller_);
+  serial_controller_->SetInterruptHandler(interrupt_controller_);
+  if (options.resample) {
+    resampling_sink_ = new ResamplingAudioSink(audio_sink, NATIVE_SAMPLE_RATE);
+    sound_controller_ = new SoundController(resampling_sink_);
+  } else {
+    sound_controller_ = new SoundController(audio_sink);
+  }
+  sound_controller_->SetClock(&frame_cycles_);
+
+  router_ = new AddressRouter(mmu_, ppu_, serial_controller_,
+                              interrupt_controller_, input_controller_,
+                              timer_controller_, sound_controller_);
+
+  interrupt_controller_->set_input_controller(input_controller_);
+
+  ppu_->SetInterruptHandler(interrupt_controller_);
+
+  cpu_ = new CPU(router_);
+  cpu_->SetInterruptController(interrupt_controller_);
+
+  if (options.log) {
+    logger_ = new Logger(options.log);
+    cartridge_->SetLogger(logger_);
+    mmu_->SetLogger(logger_);
+    ppu_->SetLogger(logger_);
+    sound_controller_->SetLogger(logger_);
+    router_->SetLogger(logger_);
+    cpu_->SetLogger(logger_);
+  }
+
+  cpu_->SkipBootROM();
+  router_->SkipBootROM();
+}
+
+Emulator::~Emulator() {
+  delete cpu_;
+  delete router_;
+  delete sound_controller_;
+  delete resampling_sink_;
+  delete timer_controller_;
+  delete input_controller_;
+  delete interrupt_controller_;
+  delete serial_controller_;
+  delete ppu_;
+  delete screen_;
+  delete owned_audio_sink_;
+  delete owned_video_sink_;
+  delete mmu_;
+  delete cartridge_;
+  delete logger_;
+}
+
+Emulator *Emulator::Create(const uint8_t *rom, size_t size, EmulatorOptions options) {
+  if (!rom || size < MIN_ROM_SIZE || options.sample_rate <= 0 ||
+      options.sample_rate > MAX_SAMPLE_RATE) {
+    return nullptr;
+  }
+  Cartridge *cartridge = new Cartridge(rom, size);
+  if (cartridge->GetCartridgeType() == CartridgeType_Unsupported ||
+      cartridge->GetROMSizeType() == ROMSize_Unsupported ||
+      cartridge->GetRAMSizeType() == RAMSize_Unsupported ||
+      (size_t)cartridge->ROMSize() > size) {
+    delete cartridge;
+    return nullptr;
+  }
+  return new Emulator(cartridge, options);
+}
+
+Emulator *Emulator::Fork(VideoSink *video_sink, AudioSink *audio_sink) {
+  // The forked cartridge already has this one's clock.
+  EmulatorOptions options = options_;
+  options.rtc_time = 0;
+  Emulator *fork = new Emulator(cartridge_->Fork(), options, video_sink, audio_sink);
+  fork->options_ = options_;
+  fork->ForkFrom(*this);
+  return fork;
+}
+
+void Emulator::ForkFrom(Emulator &other) {
+  cartridge_->ForkFrom(*other.cartridge_);
+  mmu_->ForkFrom(*other.mmu_);
+  ppu_->ForkFrom(*other.ppu_);
+  screen_->ForkFrom(*other.screen_);
+  cpu_->ForkFrom(*other.cpu_);
+  router_->ForkFrom(*other.router_);
+  input_controller_->ForkFrom(*other.input_controller_);
+  serial_controller_->ForkFrom(*other.serial_controller_);
+  sound_controller_->ForkFrom(*other.sound_controller_);
+  InterruptControllerSaveState interrupt_state;
+  other.interrupt_controller_->GetState(interrupt_state);
+  interrupt_controller_->SetState(interrupt_state);
+  TimerSaveState timer_state;
+  other.timer_controller_->GetState(timer_state);
+  timer_controller_->SetState(timer_state);
+
+  input_ = other.input_;
+  frame_count_ = other.frame_count_;
+  frame_cycles_ = other.frame_cycles_;
+  cycles_ = other.cycles_;
+}
+
+void Emulator::RunFrame() {
+  while (!AdvanceDevices(cpu_->Step())) {
+  }
+  EndFrame();
+}
+
+bool Emulator::AdvanceDevices(int cycles) {
+  bool entered_vsync = ppu_->Advance(cycles);
+  timer_controller_->Advance(cycles);
+  cycles_ += cycles;
+  serial_controller_->Advance();
+  interrupt_controller_->Advance(cycles);
+  int interrupt_steps = interrupt_controller_->HandleInterruptRequest();
+  // TODO: Interrupt handling should avance everything except CPU 20 cycles. #39.
+  assert(interrupt_steps == 0);
+
+  frame_cycles_ += cycles;
+  return entered_vsync;
+}
+
+void Emulator::EndFrame() {
+  // The APU reads frame_cycles_ as its clock, and renders the frame here.
+  sound_controller_->Advance(frame_cycles_);
+
+  frame_cycles_ = 0;
+  frame_count_++;
+}
+
+bool Emulator::RunUntil(int64_t cycle) {
+  while (cycles_ < cycle) {
+    if (AdvanceDevices(cpu_->Step())) {
+      EndFrame();
+      return true;
+    }
+    if (serial_controller_->TakeLinkEvent()) {
+      return false;
+    }
+  }
+  return false;
+}
+
+void Emulator::RunFrames(int count) {
+  for (int i = 0; i < count; i++) {
+    RunFrame();
+  }
+}
+
+void Emulator::SetInput(uint8_t buttons) {
+  input_ = buttons;
+  input_controller_->SetButtons(buttons & Button_Up, buttons & Button_Down, buttons & Button_Left,
+                                buttons & Button_Right, buttons & Button_A, buttons & Button_B,
+                                buttons & Button_Select, buttons & Button_Start);
+}
+
+const uint32_t *Emulator::framebuffer() { return screen_->last_frame(); }
+
+uint64_t Emulator::FrameHash() {
+  const uint32_t *pixels = framebuffer();
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < SCREEN_PIXELS; i++) {
+    hash = (hash ^ pixels[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+void Emulator::SetAudioMuted(bool muted) { sound_controller_->SetMuted(muted); }
+
+int Emulator::ReadAudio(int16_t *samples, int max_samples) {
+  if (!buffering_sink_) {
+    return 0;
+  }
+  return buffering_sink_->ReadSamples(samples, max_samples);
+}
+
+const string &Emulator::serial_output() { return serial_controller_->output(); }
+
+void Emulator::SetSerialEcho(bool echo) { serial_controller_->set_echo(echo); }
+
+void Emulator::GetState(struct SaveState &save_state) {
+  save_state.magic = SaveState::MAGIC;
+  save_state.version = SaveState::VERSION;
+  save_state.rom_hash = cartridge_->ROMHash();
+  cpu_->GetState(save_state.cpu);
+  mmu_->GetState(save_state.mmu);
+  cartridge_->GetState(save_state.cartridge);
+  router_->SaveState(save_state.memory);
+  interrupt_controller_->GetState(save_state.interrupt_controller);
+  ppu_->GetState(save_state.ppu);
+  timer_controller_->GetState(save_state.timer);
+  serial_controller_->GetState(save_state.serial);
+  save_state.cycles = cycles_;
+}
+
+void Emulator::SetState(const struct SaveState &save_state) {
+  cpu_->SetState(save_state.cpu);
+  router_->LoadState(save_state.memory);
+  mmu_->SetState(save_state.mmu);
+  cartridge_->SetState(save_state.cartridge);
+  interrupt_controller_->SetState(save_state.interrupt_controller);
+  ppu_->SetState(save_state.ppu);
+  cycles_ = save_state.cycles;
+  serial_controller_->SetState(save_state.serial);
+}
+
+vector<uint8_t> Emulator::Snapshot() {
+  // Zeroed first so padding is too, and equal states give equal bytes.
+  struct SaveState save_state;
+  memset(&save_state, 0, sizeof(save_state));
+  GetState(save_state);
+  const uint8_t *ram = save_state.cartridge.ram;
+  save_state.cartridge.ram = nullptr;
+
+  // The state, then the cartridge RAM it points to.
+  vector<uint8_t> data(sizeof(save_state) + save_state.cartridge.ram_size);
+  memcpy(data.data(), &save_state, sizeof(save_state));
+  if (save_state.cartridge.ram_size) {
+    memcpy(data.data() + sizeof(save_state), ram, save_state.cartridge.ram_size);
+  }
+  return data;
+}
+
+bool Emulator::Restore(const uint8_t *data, size_t size) {
+  struct SaveState save_state;
+  if (!data || size < sizeof(save_state)) {
+    return false;
+  }
+  memcpy(&save_state, data, sizeof(save_state));
+  if (save_state.magic != SaveState::MAGIC || save_state.version != SaveState::VERSION ||
+      save_state.rom_hash != cartridge_->ROMHash() ||
+      save_state.cartridge.ram_size != (uint32_t)cartridge_->RAMSize() ||
+      size != sizeof(save_state) + save_state.cartridge.ram_size) {
+    return false;
+  }
+  // Only read from.
+  save_state.cartridge.ram = const_cast<uint8_t *>(data + sizeof(save_state));
+  SetState(save_state);
+  // After memory, since restoring DIV through memory clears it.
+  timer_controller_->SetState(save_state.timer);
+  return true;
+}
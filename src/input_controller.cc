@@ -179,3 +179,10 @@ uint8_t InputController::GetByteAt(uint16_t address) {
   uint8_t memory = p0_select_ | selected_nibble;
   return memory;
 }
+
+void InputController::ForkFrom(InputController &other) {
+  p0_select_ = other.p0_select_;
+  dpad_nibble_ = other.dpad_nibble_;
+  button_nibble_ = other.button_nibble_;
+  cycles_since_poll_ = other.cycles_since_poll_;
+}
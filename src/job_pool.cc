@@ -0,0 +1,128 @@
+#include "job_pool.h"
+
+#include <cassert>
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+JobPool::JobPool(int threads, bool pin) {
+  if (threads <= 0) {
+    threads = max(1, (int)thread::hardware_concurrency());
+  }
+  for (int i = 0; i < threads; i++) {
+    queues_.push_back(new Queue());
+  }
+  for (int i = 0; i < threads; i++) {
+    threads_.emplace_back(&JobPool::Work, this, i, pin);
+  }
+}
+
+JobPool::~JobPool() {
+  Wait();
+  {
+    lock_guard<mutex> guard(lock_);
+    stopping_ = true;
+  }
+  work_available_.notify_all();
+  for (thread &worker : threads_) {
+    worker.join();
+  }
+  for (Queue *queue : queues_) {
+    delete queue;
+  }
+}
+
+void JobPool::Submit(function<void()> job) {
+  int index;
+  {
+    // Counted first, so Wait can't return before the job has run.
+    lock_guard<mutex> guard(lock_);
+    index = next_queue_;
+    next_queue_ = (next_queue_ + 1) % queues_.size();
+    queued_++;
+    pending_++;
+  }
+  {
+    lock_guard<mutex> guard(queues_[index]->lock);
+    queues_[index]->jobs.push_back(move(job));
+  }
+  work_available_.notify_one();
+}
+
+void JobPool::Wait() {
+  unique_lock<mutex> guard(lock_);
+  all_done_.wait(guard, [this] { return pending_ == 0; });
+}
+
+bool JobPool::TakeJob(int index, function<void()> &job) {
+  int count = queues_.size();
+  for (int i = 0; i < count; i++) {
+    Queue *queue = queues_[(index + i) % count];
+    lock_guard<mutex> guard(queue->lock);
+    if (queue->jobs.empty()) {
+      continue;
+    }
+    // Newest of our own, so its ROM is likely still in cache. Oldest of
+    // anyone else's.
+    if (i == 0) {
+      job = move(queue->jobs.back());
+      queue->jobs.pop_back();
+    } else {
+      job = move(queue->jobs.front());
+      queue->jobs.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void JobPool::Work(int index, bool pin) {
+  if (pin) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % CPU_SETSIZE, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+      cout << "Could not pin thread " << index << " to a CPU" << endl;
+    }
+#else
+    cout << "Pinning threads to CPUs isn't supported here" << endl;
+#endif
+  }
+
+  while (true) {
+    {
+      unique_lock<mutex> guard(lock_);
+      work_available_.wait(guard, [this] { return stopping_ || queued_ > 0; });
+      if (stopping_ && queued_ == 0) {
+        return;
+      }
+    }
+
+    function<void()> job;
+    if (!TakeJob(index, job)) {
+      // Another thread got there first, or the job is still being queued.
+      this_thread::yield();
+      continue;
+    }
+    {
+      lock_guard<mutex> guard(lock_);
+      queued_--;
+    }
+
+    job();
+
+    bool done;
+    {
+      lock_guard<mutex> guard(lock_);
+      pending_--;
+      done = pending_ == 0;
+    }
+    if (done) {
+      all_done_.notify_all();
+    }
+  }
+}
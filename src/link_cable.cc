@@ -0,0 +1,81 @@
+#include "link_cable.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "emulator.h"
+#include "serial_controller.h"
+
+LinkCable::LinkCable(Emulator *a, Emulator *b) {
+  emulators_[0] = a;
+  emulators_[1] = b;
+  a->serial_controller()->set_linked(true);
+  b->serial_controller()->set_linked(true);
+}
+
+LinkCable::~LinkCable() {
+  emulators_[0]->serial_controller()->set_linked(false);
+  emulators_[1]->serial_controller()->set_linked(false);
+}
+
+void LinkCable::RunFrame() {
+  Emulator *a = emulators_[0];
+  Emulator *b = emulators_[1];
+  int64_t frame = a->frame_count();
+  Exchange();
+  while (a->frame_count() == frame || b->cycles() < a->cycles()) {
+    // Run whichever is behind, as far as it may go. One that is behind can
+    // always go further.
+    bool a_done = a->frame_count() != frame;
+    int i = !a_done && a->cycles() <= b->cycles() ? 0 : 1;
+    int64_t limit = Limit(i);
+    if (a_done) {
+      limit = std::min(limit, a->cycles());
+    }
+    emulators_[i]->RunUntil(limit);
+    runs_++;
+    Exchange();
+  }
+}
+
+void LinkCable::RunFrames(int count) {
+  for (int i = 0; i < count; i++) {
+    RunFrame();
+  }
+}
+
+int64_t LinkCable::Limit(int i) {
+  SerialController *port = emulators_[i]->serial_controller();
+  SerialController *other_port = emulators_[1 - i]->serial_controller();
+  if (port->clocking()) {
+    return port->transfer_end();
+  }
+  if (port->listening()) {
+    // The other end can start clocking no sooner than where it is now, so
+    // can't finish a byte before then plus a byte's time.
+    return other_port->clocking() ? other_port->transfer_end()
+                                  : emulators_[1 - i]->cycles() + SERIAL_TRANSFER_CYCLES;
+  }
+  // Nothing for the other end to do with it yet.
+  return INT64_MAX;
+}
+
+void LinkCable::Exchange() {
+  for (int i = 0; i < 2; i++) {
+    SerialController *port = emulators_[i]->serial_controller();
+    SerialController *other_port = emulators_[1 - i]->serial_controller();
+    int64_t end = port->transfer_end();
+    if (!port->clocking() || emulators_[0]->cycles() < end || emulators_[1]->cycles() < end) {
+      continue;
+    }
+    // The other end only takes part if it was listening when the last bit
+    // went. Otherwise its line stays high.
+    bool listened = other_port->listening() && other_port->listening_since() <= end;
+    uint8_t sent = port->sb();
+    port->CompleteTransfer(listened ? other_port->sb() : 0xFF);
+    if (listened) {
+      other_port->CompleteTransfer(sent);
+    }
+    transfers_++;
+  }
+}
@@ -0,0 +1,33 @@
+#include "loopback_transport.h"
+
+LoopbackLink::LoopbackLink(LoopbackOptions options) : options_(options), random_(options.seed) {
+  for (int i = 0; i < 2; i++) {
+    ends_[i].link = this;
+    ends_[i].peer = &ends_[1 - i];
+  }
+}
+
+void LoopbackLink::End::Send(const RollbackInput &input) {
+  int64_t arrival = link->now_ + link->options_.latency_frames;
+  if (link->options_.jitter_frames > 0) {
+    arrival += link->random_() % (link->options_.jitter_frames + 1);
+  }
+  peer->in_flight.push_back({arrival, input});
+}
+
+bool LoopbackLink::End::Receive(RollbackInput *input) {
+  // The first to arrive, sent first among those arriving together.
+  size_t next = in_flight.size();
+  for (size_t i = 0; i < in_flight.size(); i++) {
+    if (in_flight[i].arrival <= link->now_ &&
+        (next == in_flight.size() || in_flight[i].arrival < in_flight[next].arrival)) {
+      next = i;
+    }
+  }
+  if (next == in_flight.size()) {
+    return false;
+  }
+  *input = in_flight[next].input;
+  in_flight.erase(in_flight.begin() + next);
+  return true;
+}
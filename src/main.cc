@@ -1,29 +1,83 @@
+#include <cstring>
 #include <errno.h>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include "system.h"
+#include "utils.h"
 
 int main(int argc, char* argv[]) {
+  // --headless runs without a window or audio device, as fast as possible.
+  // --audio-latency-ms N sets how much audio is buffered ahead of the device.
+  // --audio-pacing paces frames against the audio device's buffer.
+  // --pacing-stats logs audio pacing's state every 10 seconds.
+  // --sample-rate N makes audio at N Hz, e.g. 44100, 48000 or 96000, rather
+  // than the device's rate.
+  // --resample renders audio at the APU's native rate and resamples it.
+  // --shared-memory NAME also writes frames and audio to the POSIX shared
+  // memory object NAME, e.g. /edge, for edge_shm_reader and other consumers.
+  // --control PATH serves the control protocol on a Unix socket at PATH.
+  // --run-ahead N shows each frame as it will be N frames on, 1 to 3, to
+  // cut input latency.
+  SystemOptions options;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--headless") {
+      options.headless = true;
+    } else if (arg == "--audio-latency-ms" && i + 1 < argc) {
+      if (!ParseInt(argv[++i], options.audio_latency_ms) || options.audio_latency_ms <= 0 ||
+          options.audio_latency_ms > MAX_AUDIO_LATENCY_MS) {
+        std::cout << "Audio latency must be between 1 and " << MAX_AUDIO_LATENCY_MS << " ms" << std::endl;
+        return 1;
+      }
+    } else if (arg == "--sample-rate" && i + 1 < argc) {
+      if (!ParseInt(argv[++i], options.sample_rate) || options.sample_rate <= 0 || options.sample_rate > MAX_SAMPLE_RATE) {
+        std::cout << "Sample rate must be between 1 and " << MAX_SAMPLE_RATE << std::endl;
+        return 1;
+      }
+    } else if (arg == "--resample") {
+      options.resample = true;
+    } else if (arg == "--audio-pacing") {
+      options.pacing = FramePacing_Audio;
+    } else if (arg == "--pacing-stats") {
+      options.pacing_stats = true;
+    } else if (arg == "--shared-memory" && i + 1 < argc) {
+      options.shared_memory_name = argv[++i];
+    } else if (arg == "--control" && i + 1 < argc) {
+      options.control_socket = argv[++i];
+    } else if (arg == "--run-ahead" && i + 1 < argc) {
+      if (!ParseInt(argv[++i], options.run_ahead) || options.run_ahead < 0 || options.run_ahead > 3) {
+        std::cout << "Run-ahead must be between 0 and 3 frames" << std::endl;
+        return 1;
+      }
+    } else {
+      args.push_back(arg);
+    }
+  }
+
   int state_number = -1;
-  if (argc < 3 || argc > 4) {
-    std::cout << "Usage: rom.gb StateDirectory (state_number)" << std::endl;
+  if (args.size() < 2 || args.size() > 3) {
+    std::cout << "Usage: [--headless] [--audio-latency-ms N] [--audio-pacing] [--pacing-stats] [--sample-rate N] [--resample] [--shared-memory NAME] [--control PATH] [--run-ahead N] rom.gb StateDirectory (state_number)" << std::endl;
     return 1;
-  } else if (argc == 4) { 
-    state_number = std::stoi(argv[3]);
+  } else if (args.size() == 3) {
+    state_number = std::stoi(args[2]);
   }
-  // Log to file.
-  std::ofstream log("log.txt");
-  std::cout.rdbuf(log.rdbuf());
+  // Log to file. Never freed, like system below, so cout's buffer outlives
+  // every write, including the flush at exit.
+  std::ofstream *log = new std::ofstream("log.txt");
+  std::cout.rdbuf(log->rdbuf());
 
-  std::string rom_file = argv[1];
+  std::string rom_file = args[0];
   std::cout << "Loading ROM " << rom_file << std::endl;
 
-  std::string state_dir = argv[2];
+  std::string state_dir = args[1];
   // Check if state directory exists, create if necessary.
-  struct stat st = {0};
+  struct stat st = {};
   if (stat(state_dir.c_str(), &st) == -1) {
     std::cout << "Creating state directory: " << state_dir << std::endl;
     if (mkdir(state_dir.c_str(), 0700) == -1) {
@@ -48,7 +102,7 @@ int main(int argc, char* argv[]) {
     std::cout << "Game State directory exists: " << game_state_dir << std::endl;
   }
 
-  System *system = new System(rom_file, game_state_dir);
+  System *system = new System(rom_file, game_state_dir, options);
   if (state_number >= 0) {
     std::cout << "Loading state " << state_number << std::endl;
     system->LoadStateSlot(state_number);
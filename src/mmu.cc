@@ -1,6 +1,7 @@
 #include "mmu.h"
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
 #include "constants.h"
@@ -9,11 +10,11 @@
 using namespace std;
 
 MMU::MMU() {
-  ram_ = new uint8_t[0x8000];
+  ram_ = new PagedMemory(WORK_RAM_END - WORK_RAM_START + 1);
   boot_rom_ = NULL;
   cartridge_ = NULL;
   overlay_boot_rom_ = false;
-  high_memory_ = new uint8_t[HIGH_RAM_END - HIGH_RAM_START + 1];
+  high_memory_ = new uint8_t[HIGH_RAM_END - HIGH_RAM_START + 1]();
 }
 
 void MMU::SetBootROM(uint8_t *bytes) {
@@ -71,8 +72,9 @@ uint8_t MMU::GetByteAt(uint16_t address) {
     if (UseBootROMForAddress(address)) {
       return boot_rom_[address];
     } else if (address > 0x14E) {
-      cout << "ROM access above logo while overlaid at 0x" << hex
-           << unsigned(address) << endl;
+      if (logger_) {
+        logger_->Line() << "ROM access above logo while overlaid at 0x" << hex << unsigned(address);
+      }
       assert(false);
     } else {
       assert(false);
@@ -102,13 +104,17 @@ uint8_t MMU::GetByteAt(uint16_t address) {
   } else if (address >= FORBIDDEN_RAM_START && address <= FORBIDDEN_RAM_END) {
     return 0xFF;
   } else if (address >= IO_RAM_START && address <= IO_RAM_END) {
-    std::cout << "Unexpected IO RAM Get: 0x" << hex << unsigned(address) << endl;
+    if (logger_) {
+      logger_->Line() << "Unexpected IO RAM Get: 0x" << hex << unsigned(address);
+    }
     return 0x00;
   } else if (address >= HIGH_RAM_START && address <= HIGH_RAM_END) {
     return high_memory_[address - HIGH_RAM_START];
   } 
 
-  std::cout << "Unknown access to 0x" << hex << unsigned(address) << endl;
+  if (logger_) {
+    logger_->Line() << "Unknown access to 0x" << hex << unsigned(address);
+  }
   assert(false);
   return 0;
 }
@@ -153,27 +159,29 @@ void MMU::SetByteAt(uint16_t address, uint8_t byte) {
     // PPU should handle this.
     assert(false);
   } else if (address >= FORBIDDEN_RAM_START && address <= FORBIDDEN_RAM_END) {
-    cout << "FORBIDDEN RAM: ";
-    cout << AddressRegion(address) << "[0x" << hex << unsigned(address)
-          << "]";
-    cout << " = 0x" << hex << unsigned(byte) << " (SET)" << endl;
+    if (logger_) {
+      logger_->Line() << "FORBIDDEN RAM: " << AddressRegion(address) << "[0x" << hex
+                      << unsigned(address) << "] = 0x" << hex << unsigned(byte) << " (SET)";
+    }
     // assert(false);
   } else if (address >= HIGH_RAM_START && address <= HIGH_RAM_END) {
     high_memory_[address - HIGH_RAM_START] = byte;
     return;
   } else if (address == 0xFF50) {
     overlay_boot_rom_ = false;
-    cout << "**** REMOVED OVERLAY BOOT ROM ***" << endl;
+    if (logger_) {
+      logger_->Line() << "**** REMOVED OVERLAY BOOT ROM ***";
+    }
   } else if (address >= IO_RAM_START && address <= IO_RAM_END) {
-    cout << "IO RAM: ";
-    cout << AddressRegion(address) << "[0x" << hex << unsigned(address)
-          << "]";
-    cout << " = 0x" << hex << unsigned(byte) << " (SET)" << endl;
+    if (logger_) {
+      logger_->Line() << "IO RAM: " << AddressRegion(address) << "[0x" << hex
+                      << unsigned(address) << "] = 0x" << hex << unsigned(byte) << " (SET)";
+    }
   } else {
-    cout << "Can't Write to: ";
-    cout << AddressRegion(address) << "[0x" << hex << unsigned(address)
-          << "]";
-    cout << " = 0x" << hex << unsigned(byte) << " (SET)" << endl;
+    if (logger_) {
+      logger_->Line() << "Can't Write to: " << AddressRegion(address) << "[0x" << hex
+                      << unsigned(address) << "] = 0x" << hex << unsigned(byte) << " (SET)";
+    }
 
     assert(false);
   }
@@ -181,13 +189,13 @@ void MMU::SetByteAt(uint16_t address, uint8_t byte) {
 
 uint8_t MMU::GetRAM(uint16_t address) {
   assert(address <= WORK_RAM_END - WORK_RAM_START);
-  return ram_[address];
+  return ram_->Get(address);
 }
 
 void MMU::SetRAM(uint16_t address, uint8_t byte) {
   // TODO: For CBB, the second half is switchable.
   assert(address <= WORK_RAM_END - WORK_RAM_START);
-  ram_[address] = byte;
+  ram_->Set(address, byte);
 }
 
 void MMU::UpdateROMBank() {
@@ -199,7 +207,9 @@ void MMU::UpdateROMBank() {
   }
 
   if (rom_bank_ >= cartridge_->ROMBankCount()) {
-    std::cout << "ROM bank out of bounds: " << std::hex << int(rom_bank_) << std::endl;
+    if (logger_) {
+      logger_->Line() << "ROM bank out of bounds: " << hex << int(rom_bank_);
+    }
     assert(false);
   }
 }
@@ -213,7 +223,10 @@ void MMU::SetWordAt(uint16_t address, uint16_t word) {
   SetByteAt(address + 1, HIGHER8(word));
 }
 
-MMU::~MMU() {}
+MMU::~MMU() {
+  delete ram_;
+  delete[] high_memory_;
+}
 
 void MMU::SetState(const struct MMUSaveState &state) {
   overlay_boot_rom_ = state.overlay_boot_rom;
@@ -230,3 +243,14 @@ void MMU::GetState(struct MMUSaveState& state) {
   state.switchable_ram_bank_enabled = switchable_ram_bank_enabled_;
   state.register_2000_3fff = register_2000_3fff_;
 }
+
+void MMU::ForkFrom(MMU &other) {
+  ram_->Share(*other.ram_);
+  memcpy(high_memory_, other.high_memory_, HIGH_RAM_END - HIGH_RAM_START + 1);
+  boot_rom_ = other.boot_rom_;
+  overlay_boot_rom_ = other.overlay_boot_rom_;
+  rom_bank_ = other.rom_bank_;
+  switchable_ram_bank_active_ = other.switchable_ram_bank_active_;
+  switchable_ram_bank_enabled_ = other.switchable_ram_bank_enabled_;
+  register_2000_3fff_ = other.register_2000_3fff_;
+}
@@ -1,15 +1,27 @@
 #include "noise_voice.h"
 
-#include <math.h>
-
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <mutex>
 
+#include "blip_buffer.h"
 #include "constants.h"
 #include "utils.h"
 
+int16_t NoiseVoice::amplitudes_[16][2];
+
+void NoiseVoice::InitAmplitudes() {
+  for (int volume = 0; volume < 16; volume++) {
+    int sample_volume = (VOICE_MAX_VOLUME * volume) / 15;
+    amplitudes_[volume][0] = -sample_volume;
+    amplitudes_[volume][1] = sample_volume;
+  }
+}
+
 NoiseVoice::NoiseVoice() {
+  static std::once_flag once;
+  std::call_once(once, InitAmplitudes);
 }
 
 void NoiseVoice::SetFF20(uint8_t value) { 
@@ -49,10 +61,10 @@ void NoiseVoice::SetFF23(uint8_t value) {
         lfsr_ = 0x7FFF;
 
 
-        // timer_ updated in the advance.
-        cycles_per_lfsr_ = CYCLES_PER_SECOND / FrequencyHz();
-        lsfr_cycles_ = cycles_per_lfsr_;
-        envelope_cycles_ = CYCLES_PER_ENVELOPE_TICK * SweepPace();
+        // The length timer is the frame sequencer's, which triggering doesn't
+        // reset.
+        lsfr_cycles_ = CyclesPerLFSR();
+        envelope_timer_ = SweepPace();
     }
     // PrintDebug();
 }
@@ -62,11 +74,10 @@ void NoiseVoice::PrintDebug() {
     std::cout << "Length: " << (int)length_ << std::endl;
     std::cout << "Length enable: " << length_enable_ << std::endl;
     std::cout << "LFSR: " << lfsr_ << std::endl;
-    std::cout << "Frequency: " << FrequencyHz() << std::endl;
     std::cout << "Volume: " << (int)volume_ << std::endl;
     std::cout << "Sweep pace: " << (int)SweepPace() << std::endl;
     std::cout << "Sweep up: " << SweepUp() << std::endl;
-    std::cout << "Cycles per LFSR: " << (int)cycles_per_lfsr_ << std::endl;
+    std::cout << "Cycles per LFSR: " << CyclesPerLFSR() << std::endl;
 }
 
 bool NoiseVoice::TickLFSR() {
@@ -79,66 +90,52 @@ bool NoiseVoice::TickLFSR() {
     return 0x1 & lfsr_;
 }
 
-int16_t NoiseVoice::GetSample() {
-  timer_cycles_ -= CYCLES_PER_SAMPLE;
-  if (timer_cycles_ <= 0) {
-    timer_cycles_ += CYCLES_PER_SOUND_TIMER_TICK;
-    if (length_enable_) {
-      length_ = std::max(length_ - 1, 0);
-      if (length_ == 0) {
-        enabled_ = false;
-        return 0;
-      }
-    }
-  }
-
+int NoiseVoice::Amplitude() {
   if (!enabled_) {
     return 0;
   }
+  return amplitudes_[volume_][0x1 & lfsr_];
+}
 
-  bool current_lfsr = 0x1 & lfsr_;
-  lsfr_cycles_ -= CYCLES_PER_SAMPLE;
-  if (lsfr_cycles_ <= 0) {
-    current_lfsr = TickLFSR();
-    lsfr_cycles_ += cycles_per_lfsr_;
+void NoiseVoice::Run(int start_time, int end_time, BlipBuffer* buffer) {
+  output_.Update(buffer, start_time, Amplitude());
+  if (!enabled_) {
+    return;
   }
 
-  if (SweepPace() > 0) {
-    envelope_cycles_ -= CYCLES_PER_SAMPLE;
-    if (envelope_cycles_ <= 0) {
-      volume_ += SweepUp() ? 1 : -1;
-      if (volume_ > 15) {
-        volume_ = 15;
-      } else if (volume_ < 0) {
-        volume_ = 0;
-      }
-      envelope_cycles_ += CYCLES_PER_ENVELOPE_TICK * SweepPace();
-    }
+  int period = CyclesPerLFSR();
+  int time = start_time + lsfr_cycles_;
+  while (time < end_time) {
+    TickLFSR();
+    output_.Update(buffer, time, Amplitude());
+    time += period;
   }
-
-  int sample_volume = (VOICE_MAX_VOLUME * volume_) / 15;
-  int16_t sample = current_lfsr ? sample_volume : -sample_volume;
-
-  return sample;
+  lsfr_cycles_ = time - end_time;
 }
 
-void NoiseVoice::AddSamplesToBuffer(int16_t* buffer, int samples) {
-    if (!enabled_) {
-        return;
-    }
-
-    for (int i = 0; i < samples; i++) {
-        buffer[i] += GetSample();
+void NoiseVoice::ClockLength() {
+  if (length_enable_ && length_ > 0) {
+    length_--;
+    if (length_ == 0) {
+      enabled_ = false;
     }
+  }
 }
 
-float NoiseVoice::FrequencyHz() {
-    float divider = ClockDivider();
-    if (divider == 0) {
-        // Divider 0 is actually divider 0.5.
-        divider = 0.5;
+void NoiseVoice::ClockEnvelope() {
+  if (SweepPace() == 0) {
+    return;
+  }
+  envelope_timer_--;
+  if (envelope_timer_ <= 0) {
+    volume_ += SweepUp() ? 1 : -1;
+    if (volume_ > 15) {
+      volume_ = 15;
+    } else if (volume_ < 0) {
+      volume_ = 0;
     }
-    return 262144.0f / float(divider * (1 << ClockShift()));
+    envelope_timer_ = SweepPace();
+  }
 }
 
 NoiseVoice::~NoiseVoice() {}
@@ -0,0 +1,66 @@
+#include "paged_memory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+PagedMemory::PagedMemory(size_t size) {
+  // Every memory starts out sharing one zero page, so even unwritten memory
+  // costs nothing.
+  static const shared_ptr<Page> zero_page = make_shared<Page>(Page());
+  size_ = size;
+  size_t page_count = (size + MEMORY_PAGE_SIZE - 1) / MEMORY_PAGE_SIZE;
+  pages_.assign(page_count, zero_page);
+  owned_.assign(page_count, 0);
+}
+
+void PagedMemory::Read(size_t offset, uint8_t *to, size_t size) const {
+  assert(offset + size <= size_);
+  while (size > 0) {
+    size_t in_page = offset % MEMORY_PAGE_SIZE;
+    size_t count = min(size, (size_t)MEMORY_PAGE_SIZE - in_page);
+    memcpy(to, pages_[offset / MEMORY_PAGE_SIZE]->bytes + in_page, count);
+    to += count;
+    offset += count;
+    size -= count;
+  }
+}
+
+void PagedMemory::Write(size_t offset, const uint8_t *from, size_t size) {
+  assert(offset + size <= size_);
+  while (size > 0) {
+    size_t page = offset / MEMORY_PAGE_SIZE;
+    size_t in_page = offset % MEMORY_PAGE_SIZE;
+    size_t count = min(size, (size_t)MEMORY_PAGE_SIZE - in_page);
+    if (!owned_[page] && memcmp(pages_[page]->bytes + in_page, from, count) != 0) {
+      Own(page);
+    }
+    if (owned_[page]) {
+      memcpy(pages_[page]->bytes + in_page, from, count);
+    }
+    from += count;
+    offset += count;
+    size -= count;
+  }
+}
+
+void PagedMemory::Share(PagedMemory &other) {
+  assert(other.size_ == size_);
+  pages_ = other.pages_;
+  // Both sides now copy a page before writing to it.
+  fill(owned_.begin(), owned_.end(), 0);
+  fill(other.owned_.begin(), other.owned_.end(), 0);
+}
+
+int PagedMemory::owned_pages() const {
+  return count(owned_.begin(), owned_.end(), 1);
+}
+
+void PagedMemory::Own(size_t page) {
+  // Only this memory can make new references to its pages, so a page nothing
+  // else holds stays that way.
+  if (pages_[page].use_count() > 1) {
+    pages_[page] = make_shared<Page>(*pages_[page]);
+  }
+  owned_[page] = 1;
+}
@@ -4,42 +4,39 @@
 #include <cstddef>
 #include <iostream>
 
+#include "logger.h"
 #include "ppu.h"
 #include "screen.h"
 #include "utils.h"
 
 const int FETCH_CYCLES = 3;
-const int FIFO_LENGTH = 16;
 
 PixelFIFO::PixelFIFO(PPU *ppu) {
   ppu_ = ppu; 
  
   fetch_ = new Fetch();
   fetch_->cycles_remaining_ = 0;
-  fetch_->pixels_ = (Pixel *)calloc(8, sizeof(Pixel));
+  fetch_->pixels_ = 0;
   fetch_->strategy_ = AppendFetchStrategy;
   
-  fifo_ = (Pixel *)calloc(FIFO_LENGTH, sizeof(Pixel));
   ClearFifo();
 }
 
 PixelFIFO::~PixelFIFO() {
-  free(fetch_->pixels_);
-  free(fetch_);
-  free(fifo_);
+  delete fetch_;
 }
 
 void PixelFIFO::ClearFifo() {
   fifo_length_ = 0;
-  fifo_start_ = 0;
-  for (int i = 0; i < FIFO_LENGTH; i++) {
-    fifo_[i] = Pixel{0x00, BackgroundWindowPalette, false};
-  }
+  fifo_front_ = 0;
+  fifo_back_ = 0;
 }
 
-void PixelFIFO::NewRow(int pixely, Sprite *row_sprites, int row_sprites_count) {
+void PixelFIFO::NewRow(int pixely, Sprite *row_sprites, int row_sprites_count, bool draw) {
   ClearFifo();
 
+  draw_ = draw;
+
   window_triggered_ = false;
   window_x_ = 0;
 
@@ -52,6 +49,7 @@ void PixelFIFO::NewRow(int pixely, Sprite *row_sprites, int row_sprites_count) {
   sprite_fetch_x = -7;
   row_sprites_ = row_sprites;
   row_sprites_count_ = row_sprites_count;
+  row_sprite_cursor_ = 0;
 
   scx_shift_ = ppu_->scx() % 8;
   bgx_ = int(ppu_->scx()) - scx_shift_;
@@ -59,17 +57,26 @@ void PixelFIFO::NewRow(int pixely, Sprite *row_sprites, int row_sprites_count) {
 }
 
 Pixel PixelFIFO::PopFrontPixel() {
-  Pixel pixel = fifo_[fifo_start_];
-  fifo_start_++;
-  fifo_start_ = fifo_start_ % 16;
+  Pixel pixel = fifo_front_ & 0xFF;
+  fifo_front_ = (fifo_front_ >> 8) | (fifo_back_ << 56);
+  fifo_back_ >>= 8;
   fifo_length_--;
   return pixel;
 }
 
-void PixelFIFO::Append(Pixel pixel) {
-  int pos = (fifo_start_ + fifo_length_) % 16;
-  fifo_[pos] = pixel;
-  fifo_length_ += 1;
+void PixelFIFO::AppendRow(PixelRow row) {
+  assert(fifo_length_ <= 8);
+  if (fifo_length_ == 0) {
+    fifo_front_ = row;
+    fifo_back_ = 0;
+  } else if (fifo_length_ == 8) {
+    fifo_back_ = row;
+  } else {
+    int shift = fifo_length_ * 8;
+    fifo_front_ |= row << shift;
+    fifo_back_ = row >> (64 - shift);
+  }
+  fifo_length_ += 8;
 }
 
 bool PixelFIFO::Advance(Screen *screen) {
@@ -98,7 +105,9 @@ bool PixelFIFO::Advance(Screen *screen) {
     sprite_fetch_x = pixelx_ - 7;
 
     if (!window_triggered_) {
-      std::cout << "Unexpected: Window disabled during the line." << std::endl;
+      if (ppu_->logger()) {
+        ppu_->logger()->Line() << "Unexpected: Window disabled during the line.";
+      }
       // assert(false); FF Legend does this during battle transitions.
     }
   }
@@ -150,7 +159,10 @@ bool PixelFIFO::Advance(Screen *screen) {
     return false;
   }
 
-  screen->DrawPixel(PopFrontPixel());
+  Pixel pixel = PopFrontPixel();
+  if (draw_) {
+    screen->DrawPixel(pixel);
+  }
   pixelx_++;
 
   return (++pixels_outputted_ == SCREEN_WIDTH);
@@ -161,58 +173,73 @@ void PixelFIFO::ApplyFetch() {
 
   switch (fetch_->strategy_) {
     case AppendFetchStrategy:
-      assert(fifo_length_ <= 8);
-      for (int i = 0; i < 8; i++) {
-        Append(fetch_->pixels_[i]);
-      }
-      assert(fifo_length_ != 0);
+      AppendRow(fetch_->pixels_);
       break;
     case OverlayFirst8FetchStrategy:
       assert(fifo_length_ >= 8);
-      for (int i = 0; i < 8; i++) {
-        OverlaySpriteFetch(i);
+      if (draw_) {
+        fifo_front_ = OverlaySpritePixelRow(fifo_front_, fetch_->pixels_);
       }
       break;
   }
 }
 
-void PixelFIFO::OverlaySpriteFetch(int i) {
-  Pixel sprite_pixel = fetch_->pixels_[i];
-  int pos = (fifo_start_ + i) % 16;
-  Pixel fifo_pixel = fifo_[pos];
-  if (fifo_pixel.palette_ == BackgroundWindowPalette) {
-    if (sprite_pixel.sprite_over_background_window_ || fifo_pixel.two_bit_color_ == 0x00) {
-      if (sprite_pixel.two_bit_color_ != 0x00) {
-        fifo_[pos] = sprite_pixel;
-      }
-    }
-  } else {
-    // Sprite over sprite if existing pixel is transparent.
-    if (fifo_pixel.two_bit_color_ == 0x00) {
-      fifo_[pos] = sprite_pixel;
-    }
+// Spreads the 8 bits of a byte into the low bit of 8 byte lanes, with bit 7
+// (the leftmost pixel) in the lowest lane.
+static PixelRow SpreadBits(uint8_t bits) {
+  PixelRow row = 0;
+  for (int i = 0; i < 8; i++) {
+    row |= PixelRow((bits >> (7 - i)) & 0x1) << (i * 8);
   }
+  return row;
 }
 
-void PixelList(uint16_t pixels, Palette palette, Pixel *list, bool sprite_over_background_window) {
-  uint8_t high = HIGHER8(pixels);
-  uint8_t low = LOWER8(pixels);
-  for (int i = 7; i >= 0; i--) {
-    list[i].palette_ = palette;
-    list[i].two_bit_color_ = ((high & 0x1)) | ((low & 0x1) << 1);
-    list[i].sprite_over_background_window_ = sprite_over_background_window;
-    high >>= 1;
-    low >>= 1;
+struct SpreadBitsTable {
+  PixelRow rows[256];
+  SpreadBitsTable() {
+    for (int i = 0; i < 256; i++) {
+      rows[i] = SpreadBits(i);
+    }
   }
+};
+
+static const SpreadBitsTable SPREAD_BITS;
+
+PixelRow MakePixelRow(uint16_t tile_row, Palette palette, bool sprite_over_background_window) {
+  PixelRow row = SPREAD_BITS.rows[HIGHER8(tile_row)] |
+                 (SPREAD_BITS.rows[LOWER8(tile_row)] << 1);
+  return row | (PIXEL_ROW_LOW_BITS * MakePixel(0x0, palette, sprite_over_background_window));
+}
+
+PixelRow OverlaySpritePixelRow(PixelRow fifo, PixelRow sprite) {
+  // Each of these has the low bit of a lane set when true for that pixel.
+  PixelRow fifo_color = fifo & (PIXEL_ROW_LOW_BITS * 0x3);
+  PixelRow fifo_opaque = (fifo_color | (fifo_color >> 1)) & PIXEL_ROW_LOW_BITS;
+  PixelRow sprite_color = sprite & (PIXEL_ROW_LOW_BITS * 0x3);
+  PixelRow sprite_opaque = (sprite_color | (sprite_color >> 1)) & PIXEL_ROW_LOW_BITS;
+  // Only the background / window palette has bit 1 of the palette set.
+  PixelRow fifo_background = (fifo >> 3) & PIXEL_ROW_LOW_BITS;
+  PixelRow sprite_priority = (sprite >> 4) & PIXEL_ROW_LOW_BITS;
+
+  PixelRow over_background = fifo_background & (sprite_priority | ~fifo_opaque) & sprite_opaque;
+  PixelRow over_sprite = ~fifo_background & ~fifo_opaque;
+  PixelRow replace = ((over_background | over_sprite) & PIXEL_ROW_LOW_BITS) * 0xFF;
+
+  return (fifo & ~replace) | (sprite & replace);
 }
 
-// Returns the first sprite at x past sprite_index_, or -1 if there is no such
-// sprite.
+// Returns the first sprite at x, or -1 if there is no such sprite. Row sprites
+// are sorted by x and x mostly increases, so this walks a cursor rather than
+// scanning. The window can move x back, so the cursor can rewind too.
 int PixelFIFO::FirstSpriteIndexForX(int x) {
-  for (int i = 0; i < row_sprites_count_; i++) {
-    if (row_sprites_[i].x_ == x) {
-      return i;
-    }
+  while (row_sprite_cursor_ > 0 && row_sprites_[row_sprite_cursor_ - 1].x_ >= x) {
+    row_sprite_cursor_--;
+  }
+  while (row_sprite_cursor_ < row_sprites_count_ && row_sprites_[row_sprite_cursor_].x_ < x) {
+    row_sprite_cursor_++;
+  }
+  if (row_sprite_cursor_ < row_sprites_count_ && row_sprites_[row_sprite_cursor_].x_ == x) {
+    return row_sprite_cursor_;
   }
   return -1;
 }
@@ -220,18 +247,14 @@ int PixelFIFO::FirstSpriteIndexForX(int x) {
 void PixelFIFO::StartSpriteFetch(Sprite sprite, bool immediately_apply, int left_shift) {
   assert(fetch_->cycles_remaining_ == 0);
 
-  uint16_t sprite_row_pixels = ppu_->SpritePixels(sprite, pixely_ - sprite.y_);
-  Palette p = SpriteUsesPalette1(sprite) ? SpritePalette1 : SpritePalette0;
+  if (draw_) {
+    uint16_t sprite_row_pixels = ppu_->SpritePixels(sprite, pixely_ - sprite.y_);
+    Palette p = SpriteUsesPalette1(sprite) ? SpritePalette1 : SpritePalette0;
 
-  PixelList(sprite_row_pixels, p, fetch_->pixels_, SpriteOverBackgroundWindow(sprite));
-  if (left_shift) {
-    for (int x = 0; x < 8; x++) {
-      if (x + left_shift < 8) {
-        fetch_->pixels_[x] = fetch_->pixels_[x + left_shift];
-      }  else {
-        fetch_->pixels_[x] = Pixel{0x0, SpritePalette0, false};
-      }
-    }
+    fetch_->pixels_ = MakePixelRow(sprite_row_pixels, p, SpriteOverBackgroundWindow(sprite));
+    // Shift off pixels left of the FIFO, filling with transparent pixels.
+    assert(left_shift < 8);
+    fetch_->pixels_ >>= left_shift * 8;
   }
 
   fetch_->strategy_ = OverlayFirst8FetchStrategy;
@@ -251,8 +274,10 @@ void PixelFIFO::StartBackgroundFetch() {
   fetch_->cycles_remaining_ = FETCH_CYCLES;
 
   bgx_ += fifo_length_;
-  uint16_t background_tile = ppu_->BackgroundTile(bgx_, pixely_ + ppu_->scy());
-  PixelList(background_tile, BackgroundWindowPalette, fetch_->pixels_, false);
+  if (draw_) {
+    uint16_t background_tile = ppu_->BackgroundTile(bgx_, pixely_ + ppu_->scy());
+    fetch_->pixels_ = MakePixelRow(background_tile, BackgroundWindowPalette, false);
+  }
   fetch_->strategy_ = AppendFetchStrategy;
 }
 
@@ -261,8 +286,10 @@ void PixelFIFO::StartWindowFetch() {
     return;
   }
   fetch_->cycles_remaining_ = FETCH_CYCLES;
-  uint16_t window_tile = ppu_->WindowTile(window_x_);
-  PixelList(window_tile, BackgroundWindowPalette, fetch_->pixels_, false);
+  if (draw_) {
+    uint16_t window_tile = ppu_->WindowTile(window_x_);
+    fetch_->pixels_ = MakePixelRow(window_tile, BackgroundWindowPalette, false);
+  }
   fetch_->strategy_ = AppendFetchStrategy;
   window_x_ += 8;
 }
@@ -0,0 +1,192 @@
+#include "polyphase_resampler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+// Builds an AVX2 kernel beside the baseline one, used when the machine has
+// AVX2. Baseline x86-64 has SSE2.
+#if defined(__GNUC__) && defined(__x86_64__)
+#define RESAMPLER_AVX2 __attribute__((target("avx2")))
+#endif
+#if defined(RESAMPLER_AVX2) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Cutoff as a fraction of the lower rate's Nyquist frequency. Leaves room for
+// the window's transition band, so nothing above Nyquist folds back.
+const double RESAMPLER_CUTOFF = 0.9;
+
+PolyphaseResampler::PolyphaseResampler(int in_rate, int out_rate, bool use_avx2) {
+  assert(in_rate > 0 && out_rate > 0);
+#if defined(RESAMPLER_AVX2)
+  avx2_ = use_avx2 && __builtin_cpu_supports("avx2");
+#endif
+  double ratio = double(in_rate) / out_rate;
+  step_ = (uint64_t)llround(ratio * ((uint64_t)1 << FRAC_BITS));
+
+  // Long enough to span ZERO_CROSSINGS samples at the lower rate, in whole
+  // vectors.
+  taps_ = (int)ceil(ZERO_CROSSINGS * std::max(1.0, ratio));
+  taps_ = (taps_ + 15) & ~15;
+
+  // Cycles per input sample.
+  double cutoff = RESAMPLER_CUTOFF * 0.5 * std::min(in_rate, out_rate) / in_rate;
+  double half = taps_ / 2.0;
+  kernel_ = new int16_t[PHASES * taps_];
+  std::vector<double> row(taps_);
+  for (int phase = 0; phase < PHASES; phase++) {
+    double center = half - 1 + double(phase) / PHASES;
+    double total = 0;
+    for (int i = 0; i < taps_; i++) {
+      double t = i - center;
+      double x = 2 * M_PI * cutoff * t;
+      double sinc = (x == 0) ? 1.0 : sin(x) / x;
+      // Blackman window over the width of the filter.
+      double u = M_PI * t / half;
+      double window = std::abs(t) >= half ? 0 : 0.42 + 0.5 * cos(u) + 0.08 * cos(2 * u);
+      row[i] = sinc * window;
+      total += row[i];
+    }
+
+    // Scale to fixed point, then put the rounding error on the largest tap so
+    // DC passes exactly.
+    int16_t *taps = kernel_ + phase * taps_;
+    int sum = 0;
+    int largest = 0;
+    for (int i = 0; i < taps_; i++) {
+      taps[i] = (int16_t)lround(row[i] * (1 << KERNEL_BITS) / total);
+      sum += taps[i];
+      if (abs(taps[i]) > abs(taps[largest])) {
+        largest = i;
+      }
+    }
+    taps[largest] += (1 << KERNEL_BITS) - sum;
+  }
+}
+
+PolyphaseResampler::~PolyphaseResampler() { delete[] kernel_; }
+
+int PolyphaseResampler::MaxOutput(int count) const {
+  // Unconsumed history is less than taps_ plus one step.
+  uint64_t input = (uint64_t)count + taps_ + (step_ >> FRAC_BITS) + 1;
+  return (int)((input << FRAC_BITS) / step_) + 1;
+}
+
+#if defined(RESAMPLER_AVX2)
+RESAMPLER_AVX2 static inline int32_t HorizontalSum(__m256i v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+RESAMPLER_AVX2 void PolyphaseResampler::DotAVX2(const int16_t *kernel, const int16_t *left,
+                                                const int16_t *right, int taps,
+                                                int32_t *left_sum, int32_t *right_sum) {
+  __m256i l = _mm256_setzero_si256();
+  __m256i r = _mm256_setzero_si256();
+  for (int i = 0; i < taps; i += 16) {
+    __m256i k = _mm256_loadu_si256((const __m256i *)(kernel + i));
+    l = _mm256_add_epi32(l, _mm256_madd_epi16(k, _mm256_loadu_si256((const __m256i *)(left + i))));
+    r = _mm256_add_epi32(r, _mm256_madd_epi16(k, _mm256_loadu_si256((const __m256i *)(right + i))));
+  }
+  *left_sum = HorizontalSum(l);
+  *right_sum = HorizontalSum(r);
+}
+#else
+void PolyphaseResampler::DotAVX2(const int16_t *kernel, const int16_t *left,
+                                 const int16_t *right, int taps, int32_t *left_sum,
+                                 int32_t *right_sum) {
+  Dot(kernel, left, right, taps, left_sum, right_sum);
+}
+#endif
+
+#if defined(__SSE2__)
+static inline int32_t HorizontalSum(__m128i sum) {
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+void PolyphaseResampler::Dot(const int16_t *kernel, const int16_t *left, const int16_t *right,
+                             int taps, int32_t *left_sum, int32_t *right_sum) {
+  // madd multiplies 16 bit pairs and adds neighbours into 32 bits. Taps are
+  // well under full scale, so the sums can't overflow.
+#if defined(__SSE2__)
+  __m128i l = _mm_setzero_si128();
+  __m128i r = _mm_setzero_si128();
+  for (int i = 0; i < taps; i += 8) {
+    __m128i k = _mm_loadu_si128((const __m128i *)(kernel + i));
+    l = _mm_add_epi32(l, _mm_madd_epi16(k, _mm_loadu_si128((const __m128i *)(left + i))));
+    r = _mm_add_epi32(r, _mm_madd_epi16(k, _mm_loadu_si128((const __m128i *)(right + i))));
+  }
+  *left_sum = HorizontalSum(l);
+  *right_sum = HorizontalSum(r);
+#else
+  int32_t l = 0;
+  int32_t r = 0;
+  for (int i = 0; i < taps; i++) {
+    l += kernel[i] * left[i];
+    r += kernel[i] * right[i];
+  }
+  *left_sum = l;
+  *right_sum = r;
+#endif
+}
+
+static inline int16_t ClampSample(int32_t sum, int bits) {
+  int sample = (sum + (1 << (bits - 1))) >> bits;
+  return (int16_t)std::max(-32768, std::min(sample, 32767));
+}
+
+int PolyphaseResampler::Process(const int16_t *in, int count, int16_t *out) {
+  for (int channel = 0; channel < 2; channel++) {
+    std::vector<int16_t> &history = history_[channel];
+    size_t start = history.size();
+    history.resize(start + count);
+    for (int i = 0; i < count; i++) {
+      history[start + i] = in[2 * i + channel];
+    }
+  }
+
+  int available = (int)history_[0].size();
+  int written = 0;
+  while ((int)(position_ >> FRAC_BITS) + taps_ <= available) {
+    int index = (int)(position_ >> FRAC_BITS);
+    int phase = (int)(position_ >> (FRAC_BITS - PHASE_BITS)) & (PHASES - 1);
+    int32_t left;
+    int32_t right;
+    const int16_t *kernel = kernel_ + phase * taps_;
+    if (avx2_) {
+      DotAVX2(kernel, history_[0].data() + index, history_[1].data() + index, taps_, &left,
+              &right);
+    } else {
+      Dot(kernel, history_[0].data() + index, history_[1].data() + index, taps_, &left, &right);
+    }
+    out[2 * written] = ClampSample(left, KERNEL_BITS);
+    out[2 * written + 1] = ClampSample(right, KERNEL_BITS);
+    written++;
+    position_ += step_;
+  }
+
+  int consumed = std::min((int)(position_ >> FRAC_BITS), available);
+  for (int channel = 0; channel < 2; channel++) {
+    history_[channel].erase(history_[channel].begin(), history_[channel].begin() + consumed);
+  }
+  position_ -= (uint64_t)consumed << FRAC_BITS;
+  return written;
+}
+
+ResamplingAudioSink::ResamplingAudioSink(AudioSink *sink, int in_rate)
+    : sink_(sink), in_rate_(in_rate), resampler_(in_rate, sink->sample_rate()) {}
+
+ResamplingAudioSink::~ResamplingAudioSink() {}
+
+void ResamplingAudioSink::QueueSamples(const int16_t *samples, int count) {
+  out_.resize(resampler_.MaxOutput(count) * AUDIO_CHANNELS);
+  int written = resampler_.Process(samples, count, out_.data());
+  sink_->QueueSamples(out_.data(), written);
+}
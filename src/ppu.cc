@@ -3,9 +3,11 @@
 #include <array>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 
 #include "interrupt_controller.h"
+#include "logger.h"
 #include "pixel_fifo.h"
 #include "screen.h"
 #include "sprite.h"
@@ -48,17 +50,50 @@ const int NUM_OAM_SPRITES = 40;
 
 PPU::PPU(Screen *screen) {
   oam_ram_ = (uint8_t *)calloc(0xA0, sizeof(uint8_t));
-  video_ram_ = (uint8_t *)calloc(0x2000, sizeof(uint8_t));
+  video_ram_ = new PagedMemory(0x2000);
   io_ram_ = (uint8_t *)calloc(0xD, sizeof(uint8_t));
 
   frame_cycles_ = 0;
   state_ = OAM_Search;
   row_sprites_ = (Sprite *)calloc(10, sizeof(Sprite));
+  row_oam_index_ = (uint64_t *)calloc(ROWS, sizeof(uint64_t));
   screen_ = screen;
   fifo_ = new PixelFIFO(this);
+  // Match the screen's palettes, so they survive a save and load.
+  SetIORAM(BGP_ADDRESS, DEFAULT_PALETTE);
+  SetIORAM(OBP0_ADDRESS, DEFAULT_PALETTE);
+  SetIORAM(OBP1_ADDRESS, DEFAULT_PALETTE);
+}
+
+PPU::~PPU() {
+  delete fifo_;
+  free(oam_ram_);
+  delete video_ram_;
+  free(io_ram_);
+  free(row_sprites_);
+  free(row_oam_index_);
 }
 
 bool PPU::Advance(int machine_cycles) {
+  // Nothing observable happens between mode and LY transitions, so jump
+  // straight to the next one.
+  if (frame_cycles_ + machine_cycles < next_event_cycles_) {
+    frame_cycles_ += machine_cycles;
+    return false;
+  }
+
+  if (!LCDEnabled()) {
+    // Nothing is fetched or drawn while the LCD is off, and LY stays at 0.
+    // Frames are still counted so the emulator keeps its pace.
+    frame_cycles_ += machine_cycles;
+    next_event_cycles_ = TOTAL_FRAME_CYCLES;
+    if (frame_cycles_ < TOTAL_FRAME_CYCLES) {
+      return false;
+    }
+    frame_cycles_ -= TOTAL_FRAME_CYCLES;
+    return true;
+  }
+
   advance_cycles_ = machine_cycles;
 
   // Naive version - immediately do all the things for that particular cycle
@@ -77,14 +112,33 @@ bool PPU::Advance(int machine_cycles) {
     if (frame_cycles_ == TOTAL_FRAME_CYCLES) {
       frame_cycles_ = 0;
       EndVBlank();
+      next_event_cycles_ = NextEventCycles();
       // This leaves a few frames "on the table" but it's on the order of 0-10 out of 69K.
       return true;
     }
     assert(frame_cycles_ < TOTAL_FRAME_CYCLES);
   }
+  next_event_cycles_ = NextEventCycles();
   return false;
 }
 
+int PPU::NextEventCycles() {
+  int row_cycles = frame_cycles_ % ROW_CYCLES;
+  int row_start = frame_cycles_ - row_cycles;
+
+  if (row_cycles == 0 || state_ == Pixel_Transfer) {
+    // Row starts are handled by the next Advance, and pixel transfer runs the
+    // FIFO every cycle.
+    return frame_cycles_;
+  }
+  if (state_ == OAM_Search) {
+    return row_cycles < OAM_SEARCH_CYCLES ? row_start + OAM_SEARCH_CYCLES
+                                          : frame_cycles_;
+  }
+  // HBlank and VBlank last until the end of the row.
+  return row_start + ROW_CYCLES;
+}
+
 void PPU::AdvanceFrame(int frame_cycles) {
   advance_cycles_ -= frame_cycles;
   frame_cycles_ += frame_cycles;
@@ -99,11 +153,14 @@ void PPU::InvisibleCycle(int max_cycles) {
   }
   while (max_cycles) {
     int invisible_cycles = frame_cycles_ - VISIBLE_CYCLES;
-    if (invisible_cycles % ROW_CYCLES == 0) {
+    int row_cycles = invisible_cycles % ROW_CYCLES;
+    if (row_cycles == 0) {
       set_ly(invisible_cycles / ROW_CYCLES + ROWS);
     }
-    AdvanceFrame(1);
-    max_cycles--;
+    // LY only changes at row boundaries, so skip to the next one.
+    int row_progress = min(max_cycles, ROW_CYCLES - row_cycles);
+    AdvanceFrame(row_progress);
+    max_cycles -= row_progress;
   }
 }
 
@@ -119,7 +176,7 @@ void PPU::VisibleCycle(int remaining_cycles) {
     state_ = OAM_Search;
     OAMSearchY(row);
     set_ly(row);
-    fifo_->NewRow(row, row_sprites_, row_sprites_count_);
+    fifo_->NewRow(row, row_sprites_, row_sprites_count_, draw_frame_);
   }
 
   if (row_cycles < OAM_SEARCH_CYCLES) {
@@ -171,8 +228,9 @@ uint8_t PPU::scx() { return GetIORAM(SCX_ADDRESS); }
 void PPU::set_scx(uint8_t value) { 
   // std::cout << "setscx: " << std::hex << (int)value << std::endl;
   if (!CanAccessVRAM() && value != GetIORAM(SCX_ADDRESS)) {
-    cout << "SCX should not be updated: " << hex << int(scx()) << " -> "
-         << hex << int(value) << endl;
+    if (logger_) {
+      logger_->Line() << "SCX should not be updated: " << hex << int(scx()) << " -> " << hex << int(value);
+    }
   }
   SetIORAM(SCX_ADDRESS, value);
 }
@@ -181,8 +239,9 @@ uint8_t PPU::scy() { return scy_; }
 
 void PPU::set_scy(uint8_t value) {
   if (!CanAccessVRAM() && value != scy_) {
-    cout << "SCY should not be updated: " << hex << int(scy_) << " -> "
-         << hex << int(value) << endl;
+    if (logger_) {
+      logger_->Line() << "SCY should not be updated: " << hex << int(scy_) << " -> " << hex << int(value);
+    }
   }
   scy_ = value;
 }
@@ -235,14 +294,40 @@ uint8_t PPU::obp1() { return GetIORAM(OBP1_ADDRESS); }
 uint8_t PPU::lcdc() { return GetIORAM(LCDC_ADDRESS); }
 
 void PPU::set_lcdc(uint8_t value) {
+  bool was_on = LCDEnabled();
   bool screen_on = bit_set(value, 7);
   // cout << "LCDC " << screen_on << " 0x" << hex << unsigned(value) << endl;
   screen_->set_on(screen_on);
-  if (!screen_on && state_ != VBlank) {
-    cout << "Turning off screen must happen in vblank but is " << hex << unsigned(state_) << endl;
+  if (was_on && !screen_on && state_ != VBlank) {
+    if (logger_) {
+      logger_->Line() << "Turning off screen must happen in vblank but is " << hex << unsigned(state_);
+    }
   }
 
   SetIORAM(LCDC_ADDRESS, value);
+
+  if (was_on && !screen_on) {
+    TurnOffLCD();
+  } else if (!was_on && screen_on) {
+    TurnOnLCD();
+  }
+}
+
+bool PPU::LCDEnabled() { return bit_set(lcdc(), 7); }
+
+void PPU::TurnOffLCD() {
+  // The PPU reports mode 0 and LY 0 until it is turned back on.
+  state_ = HBlank;
+  SetIORAM(LY_ADDRESS, 0);
+  next_event_cycles_ = TOTAL_FRAME_CYCLES;
+}
+
+void PPU::TurnOnLCD() {
+  // Restart the frame at the top of the screen.
+  frame_cycles_ = 0;
+  window_render_line_ = 0;
+  next_event_cycles_ = 0;
+  screen_->VBlankBegan();
 }
 
 uint8_t PPU::stat() {
@@ -277,7 +362,7 @@ void PPU::set_stat(uint8_t value) { SetIORAM(STAT_ADDRESS, value); }
 
 uint8_t PPU::GetByteAt(uint16_t address) {
   if (address >= 0x8000 && address < 0xA000) {
-    return video_ram_[address - 0x8000];
+    return video_ram_->Get(address - 0x8000);
   } else if (address >= 0xFE00 && address < 0xFEA0) {
     return oam_ram_[address - OAM_RAM_ADDRESS];
   } else if (address >= 0xFF40 && address < 0xFF4C) {
@@ -305,12 +390,16 @@ uint8_t PPU::GetByteAt(uint16_t address) {
       case WX_ADDRESS:
         return GetWXPlus7();
       default:
-        cout << "Unknown GetByte " << hex << unsigned(address) << endl;
+        if (logger_) {
+          logger_->Line() << "Unknown GetByte " << hex << unsigned(address);
+        }
         assert(false);
         return 0;
     }
   } else {
-    cout << "Unknown GET TPPU address: 0x" << hex << unsigned(address) << endl;
+    if (logger_) {
+      logger_->Line() << "Unknown GET TPPU address: 0x" << hex << unsigned(address);
+    }
     assert(false);
     return 0x00;
   }
@@ -323,12 +412,16 @@ void PPU::SetByteAt(uint16_t address, uint8_t byte) {
       // cout << "Can not access Video RAM during " << hex << unsigned(state_)
       // << endl;
     }
-    video_ram_[address - 0x8000] = byte;
+    video_ram_->Set(address - 0x8000, byte);
   } else if (address >= 0xFE00 && address < 0xFEA0) {
     if (!CanAccessOAM()) {
 //      cout << "Can not access OAM during " << hex << unsigned(state_) << endl;
     }
-    oam_ram_[address - 0xFE00] = byte;
+    int offset = address - 0xFE00;
+    if (offset % 4 == 0) {
+      UpdateRowOAMIndex(offset / 4, oam_ram_[offset], byte);
+    }
+    oam_ram_[offset] = byte;
   } else if (address >= 0xFF40 && address < 0xFF4C) {
     switch (address) {
       case LCDC_ADDRESS:
@@ -344,7 +437,9 @@ void PPU::SetByteAt(uint16_t address, uint8_t byte) {
         set_scx(byte);
         break;
       case LY_ADDRESS:
-        cout << "Writing LY via memory to: 0x" << hex << unsigned(byte) << endl;
+        if (logger_) {
+          logger_->Line() << "Writing LY via memory to: 0x" << hex << unsigned(byte);
+        }
         // assert(false);
         set_ly(byte);
         break;
@@ -367,12 +462,16 @@ void PPU::SetByteAt(uint16_t address, uint8_t byte) {
         SetWXPlus7(byte);
         break;
       default:
-        cout << "Unknown GetByte " << hex << unsigned(address) << endl;
+        if (logger_) {
+          logger_->Line() << "Unknown GetByte " << hex << unsigned(address);
+        }
         assert(false);
         return;
     }
   } else {
-    cout << "Unknown SET PPU address: 0x" << hex << unsigned(address) << endl;
+    if (logger_) {
+      logger_->Line() << "Unknown SET PPU address: 0x" << hex << unsigned(address);
+    }
     assert(false);
   }
 }
@@ -398,8 +497,25 @@ void PPU::BeginVBlank() {
 }
 
 void PPU::EndVBlank() { 
-  screen_->VBlankEnded();
+  if (draw_frame_) {
+    screen_->VBlankEnded();
+  }
   window_render_line_ = 0;
+
+  if (skipped_frames_ < frame_skip_) {
+    skipped_frames_++;
+    draw_frame_ = false;
+  } else {
+    skipped_frames_ = 0;
+    draw_frame_ = true;
+  }
+}
+
+void PPU::SkipNextFrames(int frames) {
+  draw_frame_ = frames == 0;
+  // EndVBlank draws the frame after the one where skipped_frames_ reaches
+  // frame_skip_.
+  skipped_frames_ = frames == 0 ? 0 : frame_skip_ - frames + 1;
 }
 
 bool PPU::CanAccessOAM() { return state_ == HBlank || state_ == VBlank; }
@@ -416,7 +532,10 @@ void PPU::OAMSearchY(int row) {
 
   // We should still find sprites, even if they are disabled in LCDC currently.
   int sprites_found = 0;
-  for (int i = 0; i < NUM_OAM_SPRITES; i++) {
+  uint64_t candidates = row_oam_index_[row];
+  while (candidates && sprites_found < 10) {
+    int i = __builtin_ctzll(candidates);
+    candidates &= candidates - 1;
     int offset = 4 * i;
 
     int sprite_y = oam_ram_[offset + 0];
@@ -425,22 +544,37 @@ void PPU::OAMSearchY(int row) {
     // Transform sprite origin to be top left from bottom right 8x16.
     sprite_x -= 8;
     sprite_y -= 16;
-    if (SpriteYIntersectsRow(sprite_y, row, SpriteHeight())) {
-      assert(sprite_y - row < SpriteHeight());
-
-      row_sprites_[sprites_found].x_ = sprite_x;
-      row_sprites_[sprites_found].y_ = sprite_y;
-      row_sprites_[sprites_found].tile_number_ = oam_ram_[offset + 2];
-      row_sprites_[sprites_found].flags_ = oam_ram_[offset + 3];
-      sprites_found++;
+    if (!SpriteYIntersectsRow(sprite_y, row, SpriteHeight())) {
+      continue;
     }
-    if (sprites_found == 10) {
-      break;
+    assert(sprite_y - row < SpriteHeight());
+
+    // Insert sorted by x so the FIFO can walk sprites left to right.
+    int j = sprites_found;
+    while (j > 0 && row_sprites_[j - 1].x_ > sprite_x) {
+      row_sprites_[j] = row_sprites_[j - 1];
+      j--;
     }
+    row_sprites_[j].x_ = sprite_x;
+    row_sprites_[j].y_ = sprite_y;
+    row_sprites_[j].tile_number_ = oam_ram_[offset + 2];
+    row_sprites_[j].flags_ = oam_ram_[offset + 3];
+    sprites_found++;
   }
   row_sprites_count_ = sprites_found;
 }
 
+void PPU::UpdateRowOAMIndex(int sprite_index, int old_oam_y, int new_oam_y) {
+  uint64_t bit = 1ULL << sprite_index;
+  // Sprites cover rows oam_y - 16 up to oam_y - 1 at the tallest size.
+  for (int row = max(old_oam_y - 16, 0); row < min(old_oam_y, ROWS); row++) {
+    row_oam_index_[row] &= ~bit;
+  }
+  for (int row = max(new_oam_y - 16, 0); row < min(new_oam_y, ROWS); row++) {
+    row_oam_index_[row] |= bit;
+  }
+}
+
 uint16_t PPU::BackgroundTile(int x, int y) {
   if (!BackgroundWindowEnablePriority()) {
     return 0x0000;
@@ -479,7 +613,9 @@ uint16_t PPU::BackgroundTile(int x, int y) {
 
 uint16_t PPU::SpritePixels(Sprite sprite, int sprite_row) {
   if (sprite_row < 0 || sprite_row >= SpriteHeight()) {
-    cout << "Sprite row out of range: " << sprite_row << endl;
+    if (logger_) {
+      logger_->Line() << "Sprite row out of range: " << sprite_row;
+    }
     assert(false);
     return 0x0000;
   }
@@ -630,3 +766,19 @@ void PPU::GetState(struct PPUSaveState& state) {
   state.wy = wy();
   state.wx = GetWXPlus7();
 }
+
+void PPU::ForkFrom(PPU &other) {
+  video_ram_->Share(*other.video_ram_);
+  // OAM is smaller than a page, so is simply copied.
+  memcpy(oam_ram_, other.oam_ram_, 0xA0);
+  memcpy(io_ram_, other.io_ram_, 0xD);
+  memcpy(row_oam_index_, other.row_oam_index_, ROWS * sizeof(uint64_t));
+  state_ = other.state_;
+  frame_cycles_ = other.frame_cycles_;
+  next_event_cycles_ = other.next_event_cycles_;
+  frame_skip_ = other.frame_skip_;
+  skipped_frames_ = other.skipped_frames_;
+  draw_frame_ = other.draw_frame_;
+  scy_ = other.scy_;
+  window_render_line_ = other.window_render_line_;
+}
@@ -1,11 +1,11 @@
 #include "pulse_voice.h"
 
-#include <math.h>
-
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <mutex>
 
+#include "blip_buffer.h"
 #include "constants.h"
 #include "utils.h"
 
@@ -16,65 +16,88 @@ const uint8_t PulseVoice::waveform_[4][16] = {
   {1, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 0, 1}   // 75% (12/16)
 };
 
+int16_t PulseVoice::amplitudes_[16][4][16];
+
+void PulseVoice::InitAmplitudes() {
+  for (int volume = 0; volume < 16; volume++) {
+    int sample_volume = (VOICE_MAX_VOLUME * volume) / 15;
+    for (int duty = 0; duty < 4; duty++) {
+      for (int step = 0; step < 16; step++) {
+        amplitudes_[volume][duty][step] = waveform_[duty][step] ? sample_volume : -sample_volume;
+      }
+    }
+  }
+}
+
 PulseVoice::PulseVoice(int voice_number) {
+  static std::once_flag once;
+  std::call_once(once, InitAmplitudes);
   voice_number_ = voice_number;
 }
 
 PulseVoice::~PulseVoice() {}
 
-int16_t PulseVoice::GetSample() {
-  timer_cycles_ -= CYCLES_PER_SAMPLE;
-  if (timer_cycles_ <= 0) {
-    timer_cycles_ += CYCLES_PER_SOUND_TIMER_TICK;
-    if (length_enable_) {
-      length_ = std::max(length_ - 1, 0);
-      if (length_ == 0) {
-        enabled_ = false;
-        return 0;
-      }
-    }
-  }
-
+int PulseVoice::Amplitude() {
   if (!enabled_) {
     return 0;
   }
+  return amplitudes_[volume_][DutyCycle()][waveform_position_];
+}
 
-  if (VolumeSweepPace() > 0) {
-    envelope_cycles_ -= CYCLES_PER_SAMPLE;
-    if (envelope_cycles_ <= 0) {
-      volume_ += VolumeSweepUp() ? 1 : -1;
-      volume_ = std::max(0, std::min((int)volume_, 15));
-      envelope_cycles_ += CYCLES_PER_ENVELOPE_TICK * VolumeSweepPace();
-    }
+void PulseVoice::Run(int start_time, int end_time, BlipBuffer* buffer) {
+  output_.Update(buffer, start_time, Amplitude());
+  if (!enabled_) {
+    return;
   }
 
-  duty_cycle_timer_cycles_ -= CYCLES_PER_SAMPLE;
-  if (duty_cycle_timer_cycles_ <= 0) {
-    waveform_position_ = (waveform_position_ + 1) & 15;
-    duty_cycle_timer_cycles_ += CyclesPerDutyCycle();
+  int period = CyclesPerDutyCycle();
+  int time = start_time + duty_cycle_timer_cycles_;
+  if (volume_ == 0 || output_.Silent()) {
+    // Silent, so only the waveform position matters.
+    if (time < end_time) {
+      int steps = (end_time - time + period - 1) / period;
+      waveform_position_ = (waveform_position_ + steps) & 15;
+      time += steps * period;
+    }
+  } else {
+    while (time < end_time) {
+      waveform_position_ = (waveform_position_ + 1) & 15;
+      output_.Update(buffer, time, Amplitude());
+      time += period;
+    }
   }
+  duty_cycle_timer_cycles_ = time - end_time;
+}
 
-  if (PeriodSweepPace() > 0) {
-    period_sweep_cycles_ -= CYCLES_PER_SAMPLE;
-    if (period_sweep_cycles_ <= 0) {
-      DoPeriodSweep();
-      period_sweep_cycles_ += CYCLES_PER_PERIOD_SWEEP_TICK * PeriodSweepPace();
+void PulseVoice::ClockLength() {
+  if (length_enable_ && length_ > 0) {
+    length_--;
+    if (length_ == 0) {
+      enabled_ = false;
     }
   }
-
-  int sample_volume = (VOICE_MAX_VOLUME * volume_) / 15;
-  int16_t sample = waveform_[DutyCycle()][waveform_position_] ? sample_volume : -sample_volume;
-
-  return sample;
 }
 
-void PulseVoice::AddSamplesToBuffer(int16_t* buffer, int samples) {
-  if (!enabled_) {
+void PulseVoice::ClockEnvelope() {
+  if (VolumeSweepPace() == 0) {
     return;
   }
+  envelope_timer_--;
+  if (envelope_timer_ <= 0) {
+    volume_ += VolumeSweepUp() ? 1 : -1;
+    volume_ = std::max(0, std::min((int)volume_, 15));
+    envelope_timer_ = VolumeSweepPace();
+  }
+}
 
-  for (int i = 0; i < samples; i++) {
-    buffer[i] += GetSample();
+void PulseVoice::ClockSweep() {
+  if (PeriodSweepPace() == 0) {
+    return;
+  }
+  period_sweep_timer_--;
+  if (period_sweep_timer_ <= 0) {
+    DoPeriodSweep();
+    period_sweep_timer_ = PeriodSweepPace();
   }
 }
 
@@ -109,7 +132,6 @@ void PulseVoice::PrintDebug() {
   std::cout << "Volume Sweep pace: " << (int)VolumeSweepPace() << std::endl;
   std::cout << "Volume Sweep up: " << (int)VolumeSweepUp() << std::endl;
   std::cout << "Period: " << std::hex << PeriodValue() << std::endl;
-  std::cout << "Frequency: " << FrequencyHz() << std::endl;
   std::cout << "Cycles per duty cycle: " << CyclesPerDutyCycle() << std::endl;
 }
 
@@ -121,7 +143,7 @@ void PulseVoice::SetNRX1(uint8_t byte) {
 void PulseVoice::SetNRX2(uint8_t byte) { 
     nrx2_ = byte;
     if (DACEnabled()) {
-      volume_ = nrx2_ & 0xF0;
+      volume_ = (nrx2_ & 0xF0) >> 4;
     } else {
       enabled_ = false;
       volume_ = 0;
@@ -143,9 +165,9 @@ void PulseVoice::SetNRX4(uint8_t byte) {
       length_ = PULSE_MAX_LENGTH;
     }
 
-    // Do not update timer_cycles_ bc Triggering does not affect the timer cycling.
-    envelope_cycles_ = CYCLES_PER_ENVELOPE_TICK * VolumeSweepPace();
-    period_sweep_cycles_ = CYCLES_PER_PERIOD_SWEEP_TICK * PeriodSweepPace();
+    // The length timer is the frame sequencer's, which triggering doesn't reset.
+    envelope_timer_ = VolumeSweepPace();
+    period_sweep_timer_ = PeriodSweepPace();
 
     volume_ = (nrx2_ & 0xF0) >> 4;
 
@@ -163,7 +185,4 @@ uint16_t PulseVoice::PeriodValue() {
   return period;
 }
 
-float PulseVoice::FrequencyHz() {
-  return 131072 / (2048 - PeriodValue());
-}
 
@@ -0,0 +1,111 @@
+#include "rollback_session.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "emulator.h"
+#include "ppu.h"
+
+RollbackSession::RollbackSession(Emulator *emulator, RollbackTransport *transport,
+                                 RollbackOptions options)
+    : emulator_(emulator), transport_(transport), options_(options) {
+  assert(options_.input_delay >= 0);
+  assert(options_.max_rollback >= 1);
+  // Rolling back max_rollback frames needs the state before the oldest.
+  for (int i = 0; i <= options_.max_rollback; i++) {
+    saved_.push_back(emulator_->Fork());
+  }
+  remote_used_.resize(saved_.size());
+
+  // Nothing is held during the frames before the first input takes effect.
+  for (int64_t frame = 0; frame < options_.input_delay; frame++) {
+    local_inputs_[frame] = 0;
+    transport_->Send({frame, 0});
+  }
+}
+
+RollbackSession::~RollbackSession() {
+  for (Emulator *saved : saved_) {
+    delete saved;
+  }
+}
+
+bool RollbackSession::AdvanceFrame(uint8_t local_buttons) {
+  Poll();
+  if (frame_ + 1 - remote_confirmed_ > options_.max_rollback) {
+    stalls_++;
+    return false;
+  }
+
+  RollbackInput input = {frame_ + options_.input_delay, local_buttons};
+  local_inputs_[input.frame] = local_buttons;
+  transport_->Send(input);
+  RunFrame();
+
+  // Inputs older than the oldest saved frame are never needed again.
+  int64_t oldest = frame_ - (int64_t)saved_.size();
+  local_inputs_.erase(local_inputs_.begin(), local_inputs_.lower_bound(oldest));
+  remote_inputs_.erase(remote_inputs_.begin(), remote_inputs_.lower_bound(oldest));
+  return true;
+}
+
+void RollbackSession::Poll() {
+  int64_t first_wrong = frame_;
+  RollbackInput input;
+  while (transport_->Receive(&input)) {
+    if (input.frame < remote_confirmed_ || remote_inputs_.count(input.frame)) {
+      continue;
+    }
+    remote_inputs_[input.frame] = input.buttons;
+    if (input.frame < frame_) {
+      // Unconfirmed frames are never older than the saved ones.
+      assert(frame_ - input.frame <= options_.max_rollback);
+      if (remote_used_[input.frame % saved_.size()] != input.buttons) {
+        first_wrong = std::min(first_wrong, input.frame);
+      }
+    }
+  }
+  auto confirmed = remote_inputs_.find(remote_confirmed_);
+  while (confirmed != remote_inputs_.end() && confirmed->first == remote_confirmed_) {
+    last_confirmed_remote_ = confirmed->second;
+    remote_confirmed_++;
+    confirmed++;
+  }
+
+  if (first_wrong < frame_) {
+    RollBackTo(first_wrong);
+  }
+}
+
+int64_t RollbackSession::confirmed_frames() { return std::min(frame_, remote_confirmed_); }
+
+uint8_t RollbackSession::RemoteInput(int64_t frame) {
+  auto input = remote_inputs_.find(frame);
+  return input != remote_inputs_.end() ? input->second : last_confirmed_remote_;
+}
+
+void RollbackSession::RunFrame() {
+  size_t index = frame_ % saved_.size();
+  saved_[index]->ForkFrom(*emulator_);
+  remote_used_[index] = RemoteInput(frame_);
+  assert(local_inputs_.count(frame_));
+  emulator_->SetInput(local_inputs_[frame_] | remote_used_[index]);
+  emulator_->RunFrame();
+  frame_++;
+}
+
+void RollbackSession::RollBackTo(int64_t frame) {
+  int64_t end = frame_;
+  emulator_->ForkFrom(*saved_[frame % saved_.size()]);
+  frame_ = frame;
+  // The frames were already shown and heard, so only the next new frame is
+  // drawn, and the audio already played stands.
+  emulator_->ppu()->SkipNextFrames(end - frame);
+  emulator_->SetAudioMuted(true);
+  while (frame_ < end) {
+    RunFrame();
+  }
+  emulator_->SetAudioMuted(false);
+  rollbacks_++;
+  resimulated_frames_ += end - frame;
+}
@@ -1,54 +1,52 @@
 #include "screen.h"
 
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 
-#include <SDL3/SDL.h>
+#include "video_sink.h"
 
-const uint8_t DEFAULT_PALETTE = 0xE4;  // 11100100.
+static unsigned long long NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
 
-#ifndef BUILD_IOS
-const int PIXEL_SCALE = 4;
-#endif
+// Stands in for frames until the first one is drawn.
+static const uint32_t BLANK_FRAME[SCREEN_PIXELS] = {};
 
-Screen::Screen() { 
-  InitSDL(); 
+Screen::Screen(VideoSink *video_sink) {
+  video_sink_ = video_sink;
 
-  pixels_front_ = new uint32_t[SCREEN_WIDTH * SCREEN_HEIGHT];
-  pixels_back_ = new uint32_t[SCREEN_WIDTH * SCREEN_HEIGHT];
+  shared_buffer_ = 2;
+  pixels_front_ = BLANK_FRAME;
+  last_frame_ = BLANK_FRAME;
   palettes_ = new uint32_t[3];
   palettes_[0] = palettes_[1] = palettes_[2] = DEFAULT_PALETTE;
-  frame_start_ms_ = SDL_GetTicks();
+  frame_start_ms_ = NowMs();
   frames_ = 0;
 }
 
-void Screen::InitSDL() {
-    if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
-        const char* error = SDL_GetError();
-        std::cout << "Error in SDL_Init: " << error << std::endl;
-        assert(false);
-    }
-
-#ifndef BUILD_IOS
-    window_ = SDL_CreateWindow("EDGE",
-        SCREEN_WIDTH * PIXEL_SCALE,
-        SCREEN_HEIGHT * PIXEL_SCALE,
-        SDL_WINDOW_HIGH_PIXEL_DENSITY);
-
-    renderer_ = SDL_CreateRenderer(window_, 0);
-#endif
-
-    texture_ = SDL_CreateTexture(renderer_,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_STATIC,
-        SCREEN_WIDTH,
-        SCREEN_HEIGHT);
+Screen::~Screen() {
+  for (int i = 0; i < 3; i++) {
+    delete[] buffers_[i];
+  }
+  delete[] palettes_;
+}
 
-    SDL_RenderClear(renderer_);
-    SDL_RenderPresent(renderer_);
+void Screen::AllocateBuffers() {
+  for (int i = 0; i < 3; i++) {
+    buffers_[i] = new uint32_t[SCREEN_PIXELS]();
+  }
+  pixels_back_ = buffers_[back_buffer_];
 }
 
 void Screen::DrawPixel(Pixel pixel) {
+  if (!pixels_back_) {
+    AllocateBuffers();
+  }
   int pixel_index = x_ + y_ * SCREEN_WIDTH;
   assert(pixel_index < SCREEN_PIXELS);
   pixels_back_[pixel_index] = GetScreenColor(pixel);
@@ -56,8 +54,8 @@ void Screen::DrawPixel(Pixel pixel) {
 }
 
 uint32_t Screen::GetScreenColor(Pixel pixel) {
-  uint8_t palette_pixel = palettes_[pixel.palette_];
-  palette_pixel >>= (pixel.two_bit_color_ * 2);
+  uint8_t palette_pixel = palettes_[PixelPalette(pixel)];
+  palette_pixel >>= (PixelColor(pixel) * 2);
 
   if (style_ == ScreenStyle_Green) {
     switch (palette_pixel & 0x3) {
@@ -97,26 +95,42 @@ void Screen::NewLine() {
 
 void Screen::VBlankBegan() { y_ = 0; }
 
+void Screen::PublishFrame() {
+  // Publish the frame and take whichever buffer the reader isn't using.
+  last_frame_ = pixels_back_;
+  int previous = shared_buffer_.exchange(back_buffer_ | FRESH_FRAME_BIT, std::memory_order_acq_rel);
+  back_buffer_ = previous & ~FRESH_FRAME_BIT;
+  pixels_back_ = buffers_[back_buffer_];
+}
+
 void Screen::VBlankEnded() {
-  std::lock_guard<std::mutex> lock(pixels_mutex_);
-  std::swap(pixels_front_, pixels_back_);
-
-  SDL_UpdateTexture(texture_, nullptr, pixels_front_, SCREEN_WIDTH * sizeof(uint32_t));
-  SDL_RenderClear(renderer_);
-  SDL_RenderTexture(renderer_, texture_, nullptr, nullptr);
-  SDL_RenderPresent(renderer_);
-        
+  if (!pixels_back_) {
+    AllocateBuffers();
+  }
+  PublishFrame();
+  video_sink_->FrameReady(this);
+
   if (++frames_ == 60) {
     if (debugger_) {
-      unsigned long long sixty_frames_ms = SDL_GetTicks() - frame_start_ms_;
+      unsigned long long sixty_frames_ms = NowMs() - frame_start_ms_;
       cout << "1 second: avg " << dec << unsigned((1000 * sixty_frames_ms) / 60)
            << " ms / frame." << endl;
     }
     frames_ = 0;
-    frame_start_ms_ = SDL_GetTicks();
+    frame_start_ms_ = NowMs();
   }
 }
 
+const uint32_t* Screen::pixels() {
+  if (shared_buffer_.load(std::memory_order_relaxed) & FRESH_FRAME_BIT) {
+    int previous = shared_buffer_.exchange(front_buffer_, std::memory_order_acq_rel);
+    front_buffer_ = previous & ~FRESH_FRAME_BIT;
+    // The buffers were made before the first frame was published.
+    pixels_front_ = buffers_[front_buffer_];
+  }
+  return pixels_front_;
+}
+
 void Screen::SetPalette(Palette palette, uint8_t value) {
   palettes_[palette] = value;
 }
@@ -130,25 +144,71 @@ void Screen::SaveScreenshot(const string& base_name) {
     SaveScreenshotToPath(filename);
 }
 
+static void WriteLE(ofstream& file, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    file.put((char)((value >> (8 * i)) & 0xFF));
+  }
+}
+
+// Writes a 32 bit uncompressed BMP, so screenshots don't need SDL.
 void Screen::SaveScreenshotToPath(const string& filepath) {
-    SDL_Surface* surface = SDL_CreateSurfaceFrom(
-                                                 SCREEN_WIDTH,
-                                                 SCREEN_HEIGHT,
-                                                 SDL_PIXELFORMAT_ARGB8888,
-            pixels_front_,
-            SCREEN_WIDTH * 4
-        );
-
-    if (surface == NULL) {
-        cout << "Failed to create surface for screenshot: " << SDL_GetError() << endl;
+    ofstream file(filepath, ios::binary);
+    if (!file) {
+        cout << "Failed to save screenshot: could not open " << filepath << endl;
         return;
     }
 
-    if (SDL_SaveBMP(surface, filepath.c_str())) {
+    const uint32_t HEADERS_SIZE = 14 + 40;
+    const uint32_t IMAGE_SIZE = SCREEN_PIXELS * sizeof(uint32_t);
+
+    // BITMAPFILEHEADER.
+    file.put('B');
+    file.put('M');
+    WriteLE(file, HEADERS_SIZE + IMAGE_SIZE, 4);
+    WriteLE(file, 0, 4);
+    WriteLE(file, HEADERS_SIZE, 4);
+
+    // BITMAPINFOHEADER, bottom up rows, BI_RGB.
+    WriteLE(file, 40, 4);
+    WriteLE(file, SCREEN_WIDTH, 4);
+    WriteLE(file, SCREEN_HEIGHT, 4);
+    WriteLE(file, 1, 2);
+    WriteLE(file, 32, 2);
+    WriteLE(file, 0, 4);
+    WriteLE(file, IMAGE_SIZE, 4);
+    WriteLE(file, 2835, 4);  // 72 DPI.
+    WriteLE(file, 2835, 4);
+    WriteLE(file, 0, 4);
+    WriteLE(file, 0, 4);
+
+    // ARGB8888 is BGRA in memory order on little endian.
+    for (int y = SCREEN_HEIGHT - 1; y >= 0; y--) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            WriteLE(file, last_frame_[x + y * SCREEN_WIDTH], 4);
+        }
+    }
+
+    if (file) {
         cout << "Screenshot saved as: " << filepath << endl;
     } else {
-        cout << "Failed to save screenshot: " << SDL_GetError() << endl;
+        cout << "Failed to save screenshot: " << filepath << endl;
     }
+}
 
-    SDL_DestroySurface(surface);
+void Screen::ForkFrom(Screen &other) {
+  memcpy(palettes_, other.palettes_, 3 * sizeof(uint32_t));
+  on_ = other.on_;
+  style_ = other.style_;
+  x_ = other.x_;
+  y_ = other.y_;
+
+  if (other.last_frame_ == BLANK_FRAME) {
+    last_frame_ = BLANK_FRAME;
+    return;
+  }
+  if (!pixels_back_) {
+    AllocateBuffers();
+  }
+  memcpy(pixels_back_, other.last_frame_, SCREEN_PIXELS * sizeof(uint32_t));
+  PublishFrame();
 }
@@ -0,0 +1,139 @@
+#include "sdl_sinks.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#include <SDL3/SDL.h>
+
+#include "constants.h"
+#include "screen.h"
+
+#ifndef BUILD_IOS
+const int PIXEL_SCALE = 4;
+#endif
+
+SDLVideoSink::SDLVideoSink() {
+    if (!SDL_InitSubSystem(SDL_INIT_VIDEO)) {
+        const char* error = SDL_GetError();
+        std::cout << "Error in SDL_Init: " << error << std::endl;
+        assert(false);
+    }
+
+#ifndef BUILD_IOS
+    window_ = SDL_CreateWindow("EDGE",
+        SCREEN_WIDTH * PIXEL_SCALE,
+        SCREEN_HEIGHT * PIXEL_SCALE,
+        SDL_WINDOW_HIGH_PIXEL_DENSITY);
+
+    // iOS reads frames with Screen::pixels() and draws them itself.
+    renderer_ = SDL_CreateRenderer(window_, 0);
+    texture_ = SDL_CreateTexture(renderer_,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STATIC,
+        SCREEN_WIDTH,
+        SCREEN_HEIGHT);
+
+    SDL_RenderClear(renderer_);
+    SDL_RenderPresent(renderer_);
+#endif
+}
+
+SDLVideoSink::~SDLVideoSink() {
+  if (texture_) {
+    SDL_DestroyTexture(texture_);
+  }
+  if (renderer_) {
+    SDL_DestroyRenderer(renderer_);
+  }
+}
+
+void SDLVideoSink::FrameReady(Screen *screen) {
+  screen_ = screen;
+  frame_ready_ = true;
+}
+
+bool SDLVideoSink::Present() {
+  if (!renderer_ || !frame_ready_.exchange(false)) {
+    return false;
+  }
+  SDL_UpdateTexture(texture_, nullptr, screen_.load()->pixels(), SCREEN_WIDTH * sizeof(uint32_t));
+  SDL_RenderClear(renderer_);
+  SDL_RenderTexture(renderer_, texture_, nullptr, nullptr);
+  SDL_RenderPresent(renderer_);
+  return true;
+}
+
+int SDLAudioSink::ChooseSampleRate(int sample_rate) {
+    if (!SDL_InitSubSystem(SDL_INIT_AUDIO)) {
+        std::cerr << "Failed to init audio: " << SDL_GetError() << std::endl;
+        return sample_rate ? sample_rate : DEFAULT_SAMPLE_RATE;
+    }
+    if (sample_rate) {
+        return sample_rate;
+    }
+    SDL_AudioSpec device_spec;
+    SDL_zero(device_spec);
+    if (!SDL_GetAudioDeviceFormat(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &device_spec, nullptr) ||
+        device_spec.freq <= 0 || device_spec.freq > MAX_SAMPLE_RATE) {
+        return DEFAULT_SAMPLE_RATE;
+    }
+    return device_spec.freq;
+}
+
+SDLAudioSink::SDLAudioSink(int latency_ms, int sample_rate)
+    : sample_rate_(ChooseSampleRate(sample_rate)),
+      ring_(latency_ms * sample_rate_ / 1000 * AUDIO_CHANNELS), started_(false) {
+    SDL_AudioSpec spec;
+    SDL_zero(spec);
+    spec.freq = sample_rate_;
+    spec.format = SDL_AUDIO_S16;
+    spec.channels = AUDIO_CHANNELS;
+
+    audio_stream_ = SDL_OpenAudioDeviceStream(
+        SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK,
+        &spec,
+        &SDLAudioSink::FillStream,
+        this
+    );
+
+    if (!audio_stream_) {
+        std::cerr << "Failed to open audio stream: " << SDL_GetError() << std::endl;
+        return;
+    }
+    SDL_ResumeAudioDevice(SDL_GetAudioStreamDevice(audio_stream_));
+}
+
+SDLAudioSink::~SDLAudioSink() {
+    if (audio_stream_) {
+        // Also stops callbacks before the ring goes away.
+        SDL_DestroyAudioStream(audio_stream_);
+        audio_stream_ = nullptr;
+    }
+}
+
+void SDLAudioSink::QueueSamples(const int16_t *samples, int count) {
+  ring_.Write(samples, count * AUDIO_CHANNELS);
+  if (!started_ && ring_.Available() >= ring_.capacity() / 2) {
+    started_ = true;
+  }
+}
+
+// Called on SDL's audio thread when the device wants more data.
+void SDLAudioSink::FillStream(void *userdata, SDL_AudioStream *stream, int additional_amount, int) {
+  SDLAudioSink *sink = (SDLAudioSink *)userdata;
+  int16_t samples[1024];
+  int wanted = additional_amount / sizeof(int16_t);
+  while (wanted > 0) {
+    int count = std::min(wanted, 1024);
+    if (sink->started_) {
+      sink->ring_.Read(samples, count);
+    } else {
+      // Play silence while the ring first fills.
+      memset(samples, 0, count * sizeof(int16_t));
+    }
+    SDL_PutAudioStreamData(stream, samples, count * sizeof(int16_t));
+    wanted -= count;
+  }
+}
@@ -3,6 +3,9 @@
 #include <cassert>
 #include <iostream>
 
+#include "interrupt_controller.h"
+#include "state.h"
+
 using namespace std;
 
 SerialController::SerialController() {}
@@ -34,12 +37,65 @@ void SerialController::SetByteAt(uint16_t address, uint8_t byte) {
 }
 
 void SerialController::set_sc(uint8_t byte) {
-  sc_ = byte;
+  bool was_listening = listening();
+  sc_ = byte & 0x81;
 
-  if (byte == 0x81) {
-    line->push_back((char)sb());
-    cout << "**** SERIAL: [" << *line << "]" << endl;
-  } else {
-    // Ignore.
+  transfer_start_ = NEVER;
+  listening_since_ = NEVER;
+  if (clocking()) {
+    // Writing SC again restarts the transfer.
+    transfer_start_ = *clock_;
+    line_.push_back((char)sb());
+    if (echo_) {
+      cout << "**** SERIAL: [" << line_ << "]" << endl;
+    }
+    link_event_ = true;
+  } else if (listening()) {
+    listening_since_ = was_listening ? listening_since_ : *clock_;
+    link_event_ = link_event_ || !was_listening;
   }
+  UpdateCompleteAt();
+}
+
+void SerialController::set_linked(bool linked) {
+  linked_ = linked;
+  UpdateCompleteAt();
+}
+
+void SerialController::UpdateCompleteAt() {
+  // Unlinked, nothing else will complete the transfer.
+  complete_at_ = linked_ ? NEVER : transfer_end();
+}
+
+void SerialController::CompleteTransfer(uint8_t received) {
+  sb_ = received;
+  sc_ &= ~0x80;
+  transfer_start_ = NEVER;
+  listening_since_ = NEVER;
+  UpdateCompleteAt();
+  interrupt_handler_->RequestInterrupt(Interrupt_SerialTransferCompletion);
+}
+
+void SerialController::ForkFrom(SerialController &other) {
+  line_ = other.line_;
+  sb_ = other.sb_;
+  sc_ = other.sc_;
+  transfer_start_ = other.transfer_start_;
+  listening_since_ = other.listening_since_;
+  UpdateCompleteAt();
+}
+
+void SerialController::SetState(const struct SerialSaveState &state) {
+  sb_ = state.sb;
+  sc_ = state.sc & 0x81;
+  transfer_start_ = state.transfer_start;
+  listening_since_ = state.listening_since;
+  UpdateCompleteAt();
+}
+
+void SerialController::GetState(struct SerialSaveState &state) {
+  state.sb = sb_;
+  state.sc = sc_;
+  state.transfer_start = transfer_start_;
+  state.listening_since = listening_since_;
 }
@@ -0,0 +1,237 @@
+#include "shared_memory_export.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+uint64_t SharedFrameHash(const uint32_t *pixels) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < SCREEN_PIXELS; i++) {
+    hash = (hash ^ pixels[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Futexes on a shared mapping work across processes. Elsewhere readers poll.
+static void WakeAll(atomic<uint32_t> *word) {
+#ifdef __linux__
+  syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+  (void)word;
+#endif
+}
+
+static void WaitWhile(atomic<uint32_t> *word, uint32_t value, int timeout_ms) {
+#ifdef __linux__
+  struct timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+  syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, value, &timeout, nullptr, 0);
+#else
+  (void)word;
+  (void)value;
+  std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms, 1)));
+#endif
+}
+
+// Marks a slot or block as being written, and as written again.
+static void BeginWrite(atomic<uint32_t> &sequence) {
+  sequence.store(sequence.load(memory_order_relaxed) + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static void EndWrite(atomic<uint32_t> &sequence) {
+  sequence.store(sequence.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+SharedMemoryExport *SharedMemoryExport::Create(const string &name, VideoSink *video_sink,
+                                               AudioSink *audio_sink) {
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd < 0) {
+    cout << "Could not open shared memory " << name << ": " << strerror(errno) << endl;
+    return nullptr;
+  }
+  // Truncating first zeroes anything a previous writer left behind.
+  if (ftruncate(fd, 0) != 0 || ftruncate(fd, sizeof(SharedExport)) != 0) {
+    cout << "Could not size shared memory " << name << ": " << strerror(errno) << endl;
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  void *memory = mmap(nullptr, sizeof(SharedExport), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    cout << "Could not map shared memory " << name << ": " << strerror(errno) << endl;
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  return new SharedMemoryExport(name, (SharedExport *)memory, video_sink, audio_sink);
+}
+
+SharedMemoryExport::SharedMemoryExport(const string &name, SharedExport *shared,
+                                       VideoSink *video_sink, AudioSink *audio_sink)
+    : name_(name), shared_(shared), video_sink_(video_sink), audio_sink_(audio_sink) {
+  SharedExportHeader &header = shared_->header;
+  header.width = SCREEN_WIDTH;
+  header.height = SCREEN_HEIGHT;
+  header.frame_slots = SHARED_EXPORT_FRAME_SLOTS;
+  header.audio_blocks = SHARED_EXPORT_AUDIO_BLOCKS;
+  header.block_samples = SHARED_EXPORT_BLOCK_SAMPLES;
+  header.sample_rate = audio_sink_->sample_rate();
+  header.writer_pid = getpid();
+  header.version = SHARED_EXPORT_VERSION;
+  // Readers check the magic last, once the rest is filled in.
+  atomic_thread_fence(memory_order_release);
+  header.magic = SHARED_EXPORT_MAGIC;
+}
+
+SharedMemoryExport::~SharedMemoryExport() {
+  shared_->header.closed.store(1, memory_order_release);
+  Publish();
+  munmap(shared_, sizeof(SharedExport));
+  shm_unlink(name_.c_str());
+}
+
+void SharedMemoryExport::FrameReady(Screen *screen) {
+  // The Screen's reader may be another sink, so take the frame the emulation
+  // thread is allowed to read.
+  const uint32_t *pixels = screen->last_frame();
+  frames_++;
+  SharedFrameSlot &slot = shared_->frames[(frames_ - 1) % SHARED_EXPORT_FRAME_SLOTS];
+  BeginWrite(slot.sequence);
+  memcpy(slot.pixels, pixels, sizeof(slot.pixels));
+  slot.input = input_;
+  slot.frame_number = frames_;
+  slot.hash = SharedFrameHash(slot.pixels);
+  EndWrite(slot.sequence);
+  shared_->header.frames_written.store(frames_, memory_order_release);
+  Publish();
+
+  video_sink_->FrameReady(screen);
+}
+
+void SharedMemoryExport::QueueSamples(const int16_t *samples, int count) {
+  int written = 0;
+  while (written < count) {
+    int block_count = std::min(count - written, SHARED_EXPORT_BLOCK_SAMPLES);
+    blocks_++;
+    SharedAudioBlock &block = shared_->audio[(blocks_ - 1) % SHARED_EXPORT_AUDIO_BLOCKS];
+    BeginWrite(block.sequence);
+    memcpy(block.samples, samples + written * AUDIO_CHANNELS,
+           block_count * AUDIO_CHANNELS * sizeof(int16_t));
+    block.count = block_count;
+    block.block_number = blocks_;
+    block.frame_number = frames_;
+    EndWrite(block.sequence);
+    written += block_count;
+  }
+  shared_->header.blocks_written.store(blocks_, memory_order_release);
+  Publish();
+
+  audio_sink_->QueueSamples(samples, count);
+}
+
+void SharedMemoryExport::Publish() {
+  SharedExportHeader &header = shared_->header;
+  header.changes.fetch_add(1, memory_order_acq_rel);
+  if (header.waiters.load(memory_order_acquire)) {
+    WakeAll(&header.changes);
+  }
+}
+
+SharedMemoryReader *SharedMemoryReader::Open(const string &name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st = {};
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SharedExport)) {
+    close(fd);
+    return nullptr;
+  }
+  // Readers only write the waiter count.
+  void *memory = mmap(nullptr, sizeof(SharedExport), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+  SharedExport *shared = (SharedExport *)memory;
+  const SharedExportHeader &header = shared->header;
+  if (header.magic != SHARED_EXPORT_MAGIC || header.version != SHARED_EXPORT_VERSION ||
+      header.frame_slots != SHARED_EXPORT_FRAME_SLOTS ||
+      header.audio_blocks != SHARED_EXPORT_AUDIO_BLOCKS ||
+      header.block_samples != SHARED_EXPORT_BLOCK_SAMPLES) {
+    munmap(memory, sizeof(SharedExport));
+    return nullptr;
+  }
+  atomic_thread_fence(memory_order_acquire);
+  return new SharedMemoryReader(shared);
+}
+
+SharedMemoryReader::~SharedMemoryReader() { munmap(shared_, sizeof(SharedExport)); }
+
+bool SharedMemoryReader::WriterGone() {
+  if (shared_->header.closed.load(memory_order_acquire)) {
+    return true;
+  }
+  return kill(shared_->header.writer_pid, 0) != 0 && errno == ESRCH;
+}
+
+bool SharedMemoryReader::WaitForFrame(uint64_t frame_number, int timeout_ms) {
+  SharedExportHeader &header = shared_->header;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (true) {
+    // Read changes first, so a publish after this check wakes the wait.
+    uint32_t changes = header.changes.load(memory_order_acquire);
+    if (frames_written() >= frame_number) {
+      return true;
+    }
+    if (WriterGone()) {
+      return false;
+    }
+    int remaining_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                           deadline - std::chrono::steady_clock::now())
+                           .count();
+    if (remaining_ms <= 0) {
+      return false;
+    }
+    header.waiters.fetch_add(1, memory_order_acq_rel);
+    // Wake at least every 100 ms to notice a writer that died.
+    WaitWhile(&header.changes, changes, std::min(remaining_ms, 100));
+    header.waiters.fetch_sub(1, memory_order_acq_rel);
+  }
+}
+
+const SharedFrameSlot *SharedMemoryReader::BeginReadFrame(uint64_t frame_number, uint32_t *ticket) {
+  const SharedFrameSlot &slot = shared_->frames[(frame_number - 1) % SHARED_EXPORT_FRAME_SLOTS];
+  *ticket = slot.sequence.load(memory_order_acquire);
+  if (frame_number == 0 || (*ticket & 1) || slot.frame_number != frame_number) {
+    return nullptr;
+  }
+  return &slot;
+}
+
+const SharedAudioBlock *SharedMemoryReader::BeginReadAudio(uint64_t block_number, uint32_t *ticket) {
+  const SharedAudioBlock &block = shared_->audio[(block_number - 1) % SHARED_EXPORT_AUDIO_BLOCKS];
+  *ticket = block.sequence.load(memory_order_acquire);
+  if (block_number == 0 || (*ticket & 1) || block.block_number != block_number) {
+    return nullptr;
+  }
+  return &block;
+}
+
+bool SharedMemoryReader::EndRead(const atomic<uint32_t> &sequence, uint32_t ticket) {
+  atomic_thread_fence(memory_order_acquire);
+  return sequence.load(memory_order_relaxed) == ticket;
+}
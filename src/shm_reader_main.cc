@@ -0,0 +1,115 @@
+// edge_shm_reader follows an edge --shared-memory export from another
+// process, reading each frame and audio block in place. It checks frames and
+// blocks arrive in sequence, and that each frame's pixels match its hash, then
+// prints what it saw. It's both a check of the export and a sample consumer.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shared_memory_export.h"
+
+// The entry after skipped, or the oldest still in a ring of size entries when
+// that's later.
+static uint64_t OldestAfter(uint64_t skipped, uint64_t written, int size) {
+  uint64_t oldest = written > (uint64_t)size ? written - size + 1 : 1;
+  return std::max(oldest, skipped + 1);
+}
+
+int main(int argc, char *argv[]) {
+  // --frames N stops after N frames rather than when the writer exits.
+  // --wait-ms N waits up to N ms for the writer to start and for each frame.
+  uint64_t max_frames = 0;
+  int wait_ms = 5000;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--frames" && i + 1 < argc) {
+      max_frames = std::stoull(argv[++i]);
+    } else if (arg == "--wait-ms" && i + 1 < argc) {
+      wait_ms = std::stoi(argv[++i]);
+    } else {
+      args.push_back(arg);
+    }
+  }
+  if (args.size() != 1) {
+    std::cerr << "Usage: [--frames N] [--wait-ms N] /shared_memory_name" << std::endl;
+    return 1;
+  }
+
+  SharedMemoryReader *reader = nullptr;
+  for (int waited = 0; !reader && waited < wait_ms; waited += 10) {
+    reader = SharedMemoryReader::Open(args[0]);
+    // A writer that was killed leaves its export behind until the next one
+    // takes it over.
+    if (reader && reader->WriterGone()) {
+      delete reader;
+      reader = nullptr;
+    }
+    if (!reader) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  if (!reader) {
+    std::cerr << "No export at " << args[0] << std::endl;
+    return 1;
+  }
+  std::cout << "Reading " << reader->header().width << "x" << reader->header().height
+            << " frames and " << reader->header().sample_rate << " Hz audio from pid "
+            << reader->header().writer_pid << std::endl;
+
+  // Start from the newest frame, since older ones may be overwritten at any
+  // moment.
+  uint64_t next_frame = std::max<uint64_t>(reader->frames_written(), 1);
+  uint64_t next_block = std::max<uint64_t>(reader->blocks_written(), 1);
+  uint64_t frames = 0, dropped_frames = 0, bad_frames = 0, torn_frames = 0;
+  uint64_t blocks = 0, dropped_blocks = 0, samples = 0;
+  while (!max_frames || frames < max_frames) {
+    if (!reader->WaitForFrame(next_frame, wait_ms)) {
+      break;
+    }
+    uint32_t ticket;
+    const SharedFrameSlot *slot = reader->BeginReadFrame(next_frame, &ticket);
+    if (slot) {
+      bool hash_matches = SharedFrameHash(slot->pixels) == slot->hash;
+      if (!reader->EndRead(slot->sequence, ticket)) {
+        // Overwritten while we read it, so the hash proves nothing.
+        torn_frames++;
+      } else {
+        frames++;
+        bad_frames += !hash_matches;
+      }
+      next_frame++;
+    } else {
+      // Fell a whole ring behind. Skip to the oldest frame still there.
+      uint64_t oldest = OldestAfter(next_frame, reader->frames_written(), SHARED_EXPORT_FRAME_SLOTS);
+      dropped_frames += oldest - next_frame;
+      next_frame = oldest;
+    }
+
+    while (next_block <= reader->blocks_written()) {
+      const SharedAudioBlock *block = reader->BeginReadAudio(next_block, &ticket);
+      int count = block ? block->count : 0;
+      if (block && reader->EndRead(block->sequence, ticket)) {
+        blocks++;
+        samples += count;
+        next_block++;
+      } else {
+        uint64_t oldest = OldestAfter(next_block, reader->blocks_written(), SHARED_EXPORT_AUDIO_BLOCKS);
+        dropped_blocks += oldest - next_block;
+        next_block = oldest;
+      }
+    }
+  }
+
+  std::cout << "frames " << frames << " dropped " << dropped_frames << " torn " << torn_frames
+            << " bad hash " << bad_frames << std::endl;
+  std::cout << "audio blocks " << blocks << " dropped " << dropped_blocks << " samples " << samples
+            << std::endl;
+  delete reader;
+  return bad_frames ? 1 : 0;
+}
@@ -1,122 +1,168 @@
 #include "sound_controller.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
-#include <SDL3/SDL.h>
-
+#include "audio_sink.h"
+#include "blip_buffer.h"
 #include "constants.h"
+#include "logger.h"
 #include "noise_voice.h"
 #include "pulse_voice.h"
 #include "utils.h"
 #include "wave_voice.h"
 
-SoundController::SoundController() {
+SoundController::SoundController(AudioSink *audio_sink) {
     voice1_ = new PulseVoice(1);
     voice2_ = new PulseVoice(2);
     voice3_ = new WaveVoice();
     voice4_ = new NoiseVoice();
     global_sound_on_ = true;
-
-    SDL_AudioSpec spec;
-    SDL_zero(spec);
-    spec.freq = SAMPLE_RATE;
-    spec.format = SDL_AUDIO_S16;
-    spec.channels = 1;
-
-    audio_stream_ = SDL_OpenAudioDeviceStream(
-        SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK,
-        &spec,
-        NULL,
-        NULL
-    );
-
-    if (!audio_stream_) {
-        std::cerr << "Failed to open audio stream: " << SDL_GetError() << std::endl;
-        return;
-    }
-    SDL_ResumeAudioDevice(SDL_GetAudioStreamDevice(audio_stream_));
+    audio_sink_ = audio_sink;
+
+    sample_rate_ = audio_sink->sample_rate();
+    assert(sample_rate_ > 0 && sample_rate_ <= NATIVE_SAMPLE_RATE);
+    max_samples_per_frame_ = (int)((int64_t)sample_rate_ * CYCLES_PER_FRAME / CYCLES_PER_SECOND * 101 / 100) + 64;
+    blip_ = new BlipBuffer(max_samples_per_frame_);
+    blip_->SetRates(CYCLES_PER_SECOND, sample_rate_);
+    UpdateOutputLevels();
 }
 
-// Add destructor to clean up the audio stream
 SoundController::~SoundController() {
-    if (audio_stream_) {
-        SDL_CloseAudioDevice(SDL_GetAudioStreamDevice(audio_stream_));
-        audio_stream_ = nullptr;
-    }
     delete voice1_;
     delete voice2_;
     delete voice3_;
     delete voice4_;
+    delete blip_;
+    delete[] frame_samples_;
+    delete[] writes_;
 }
 
-void SoundController::MixSamplesToBuffer(int16_t* buffer, int samples) {
-    if (!global_sound_on_) {
-        return;
-    }
-    if (ChannelLeftEnabled(0) || ChannelRightEnabled(0)) {
-        voice1_->AddSamplesToBuffer(buffer, samples);
-    }
-    if (ChannelLeftEnabled(1) || ChannelRightEnabled(1)) {
-        voice2_->AddSamplesToBuffer(buffer, samples);
-    }
-    if (ChannelLeftEnabled(2) || ChannelRightEnabled(2)) {
-        voice3_->AddSamplesToBuffer(buffer, samples);
-    }
-    if (ChannelLeftEnabled(3) || ChannelRightEnabled(3)) {
-        voice4_->AddSamplesToBuffer(buffer, samples);
-    }
+int SoundController::MixSamplesToBuffer(int16_t* buffer, int samples) {
+  return blip_->ReadSamples(buffer, samples);
 }
 
-int16_t SoundController::GetSample() {
-  if (!global_sound_on_) {
-    return 0;
+void SoundController::SetRateRatio(double ratio) {
+  blip_->SetRates(CYCLES_PER_SECOND, sample_rate_ * ratio);
+}
+
+bool SoundController::Advance(int cycles) {
+  now_ += cycles;
+  while (now_ >= CYCLES_PER_FRAME) {
+    EndFrame(CYCLES_PER_FRAME);
   }
+  return true;
+}
 
-  // We may not use the samples, but we need to ensure that they're advanced.
-  int16_t sample1 = voice1_->GetSample();
-  int16_t sample2 = voice2_->GetSample();
-  int16_t sample3 = voice3_->GetSample();
-  int16_t sample4 = voice4_->GetSample();
+void SoundController::EndFrame(int time) {
+  RenderUntil(time);
+  blip_->EndFrame(time);
+  sequencer_time_ -= time;
+  now_ -= time;
+  frame_time_ = 0;
+  for (int i = 0; i < write_count_; i++) {
+    writes_[i].time -= time;
+  }
 
-  int16_t sample = 0;
-  if (ChannelLeftEnabled(0) || ChannelRightEnabled(0)) {
-    sample += sample1;
+  if (!frame_samples_) {
+    frame_samples_ = new int16_t[max_samples_per_frame_ * AUDIO_CHANNELS];
+  }
+  int samples = MixSamplesToBuffer(frame_samples_, max_samples_per_frame_);
+  if (!muted_) {
+    audio_sink_->QueueSamples(frame_samples_, samples);
   }
-  if (ChannelLeftEnabled(1) || ChannelRightEnabled(1)) {
-    sample += sample2;
+}
+
+void SoundController::RenderUntil(int time) {
+  // Reads and writes can come past the end of the audio frame when the
+  // emulator's frame runs long, so close the frames in between first.
+  while (time > CYCLES_PER_FRAME) {
+    EndFrame(CYCLES_PER_FRAME);
+    time -= CYCLES_PER_FRAME;
   }
-  if (ChannelLeftEnabled(2) || ChannelRightEnabled(2)) {
-    sample += sample3;
+  int applied = 0;
+  while (applied < write_count_ && writes_[applied].time <= time) {
+    RegisterWrite &write = writes_[applied];
+    RunUntil(write.time);
+    WriteRegister(write.address, write.byte);
+    applied++;
   }
-  if (ChannelLeftEnabled(3) || ChannelRightEnabled(3)) {
-    sample += sample4;
+  // Writes after time, from an Advance spanning several frames, wait for the
+  // next frame.
+  write_count_ -= applied;
+  for (int i = 0; i < write_count_; i++) {
+    writes_[i] = writes_[applied + i];
   }
+  RunUntil(time);
+}
 
-  return sample;
+void SoundController::RunUntil(int time) {
+  if (time <= frame_time_) {
+    return;
+  }
+  while (sequencer_time_ <= time) {
+    RunVoices(frame_time_, sequencer_time_);
+    frame_time_ = sequencer_time_;
+    ClockFrameSequencer();
+    sequencer_time_ += CYCLES_PER_SEQUENCER_STEP;
+  }
+  RunVoices(frame_time_, time);
+  frame_time_ = time;
 }
 
-bool SoundController::Advance(int cycles) {
-  cycles_ += cycles;
-  if (cycles_ > CYCLES_PER_SAMPLE) {
-    int16_t sample = GetSample();
-
-    sample_buffer_[buffer_pos_++] = sample;
-    if (buffer_pos_ >= SAMPLE_BUFFER_SIZE) {
-      if (!SDL_PutAudioStreamData(audio_stream_, sample_buffer_, SAMPLE_BUFFER_SIZE * sizeof(int16_t))) {
-          std::cerr << "Failed to queue audio sample: " << SDL_GetError() << std::endl;
-      }
-      buffer_pos_ = 0;
-    }
+void SoundController::RunVoices(int start_time, int end_time) {
+  voice1_->Run(start_time, end_time, blip_);
+  voice2_->Run(start_time, end_time, blip_);
+  voice3_->Run(start_time, end_time, blip_);
+  voice4_->Run(start_time, end_time, blip_);
+}
 
-    cycles_ -= CYCLES_PER_SAMPLE;
+void SoundController::ClockFrameSequencer() {
+  // Length on even steps, sweep on steps 2 and 6, and envelope on step 7.
+  if (sequencer_step_ % 2 == 0) {
+    voice1_->ClockLength();
+    voice2_->ClockLength();
+    voice3_->ClockLength();
+    voice4_->ClockLength();
   }
-  return true;
+  if (sequencer_step_ == 2 || sequencer_step_ == 6) {
+    voice1_->ClockSweep();
+  }
+  if (sequencer_step_ == 7) {
+    voice1_->ClockEnvelope();
+    voice2_->ClockEnvelope();
+    voice4_->ClockEnvelope();
+  }
+  sequencer_step_ = (sequencer_step_ + 1) & 7;
+}
+
+void SoundController::UpdateOutputLevels() {
+  // NR50 sets each terminal's volume from 1 to 8 eighths, and NR51 which
+  // voices it plays.
+  int left_volume = global_sound_on_ ? ((channel_control_ >> 4) & 0x7) + 1 : 0;
+  int right_volume = global_sound_on_ ? (channel_control_ & 0x7) + 1 : 0;
+  voice1_->SetOutputLevels(ChannelLeftEnabled(0) * left_volume, ChannelRightEnabled(0) * right_volume);
+  voice2_->SetOutputLevels(ChannelLeftEnabled(1) * left_volume, ChannelRightEnabled(1) * right_volume);
+  voice3_->SetOutputLevels(ChannelLeftEnabled(2) * left_volume, ChannelRightEnabled(2) * right_volume);
+  voice4_->SetOutputLevels(ChannelLeftEnabled(3) * left_volume, ChannelRightEnabled(3) * right_volume);
 }
 
 void SoundController::SetByteAt(uint16_t address, uint8_t byte) {
   assert(address >= 0xFF10 && address <= 0xFF3F);
 
+  int now = Now();
+  if (!writes_) {
+    writes_ = new RegisterWrite[MAX_REGISTER_WRITES];
+  }
+  if (write_count_ == MAX_REGISTER_WRITES) {
+    RenderUntil(now);
+  }
+  writes_[write_count_++] = {now, address, byte};
+}
+
+void SoundController::WriteRegister(uint16_t address, uint8_t byte) {
+
   if (address >= 0xFF30 && address <= 0xFF3F) {
     voice3_->SetWavePatternAddress(address, byte);
     return;
@@ -192,9 +238,11 @@ void SoundController::SetByteAt(uint16_t address, uint8_t byte) {
       break;
     case 0xFF24:
       channel_control_ = byte;
+      UpdateOutputLevels();
       break;
     case 0xFF25:
       sound_output_terminals_ = byte;
+      UpdateOutputLevels();
       break;
     case 0xFF26:
       SetFF26(byte);
@@ -214,7 +262,9 @@ void SoundController::SetByteAt(uint16_t address, uint8_t byte) {
     // 0xFF30-3F Wave Pattern - covered above.
 
     default:
-      std::cout << "Unknown SetByteAt: " << std::hex << (int)address << " to " << (int)byte << std::endl;
+      if (logger_) {
+        logger_->Line() << "Unknown SetByteAt: " << hex << (int)address << " to " << (int)byte;
+      }
       assert(false);
       break;
   }
@@ -223,6 +273,9 @@ void SoundController::SetByteAt(uint16_t address, uint8_t byte) {
 uint8_t SoundController::GetByteAt(uint16_t address) {
   assert(address >= 0xFF10 && address <= 0xFF3F);
 
+  // Reads see every earlier write, and status as of now.
+  RenderUntil(Now());
+
   if (address >= 0xFF30 && address <= 0xFF3F) {
     return voice3_->GetWavePatternByte(address);
   }
@@ -315,7 +368,9 @@ uint8_t SoundController::GetByteAt(uint16_t address) {
     default:
       break;
   }
-  std::cout << "No value for GetByteAt: " << std::hex << " at " << address << std::endl;
+  if (logger_) {
+    logger_->Line() << "No value for GetByteAt: " << hex << " at " << address;
+  }
   assert(false);
   return 0x00;
 }
@@ -329,12 +384,13 @@ void SoundController::SetFF26(uint8_t byte) {
 
     uint16_t address = 0xFF10;
     while (address < 0xFF26) {
-      SetByteAt(address, 0x00);
+      WriteRegister(address, 0x00);
       address++;
     }    
   }
 
   global_sound_on_ = new_global_sound_on;
+  UpdateOutputLevels();
 }
 
 uint8_t SoundController::GetFF26() {
@@ -351,9 +407,30 @@ uint8_t SoundController::GetFF26() {
 }
 
 bool SoundController::ChannelLeftEnabled(int channel) {
-  return bit_set(sound_output_terminals_, channel);
+  return bit_set(sound_output_terminals_, channel + 4);
 }
 
 bool SoundController::ChannelRightEnabled(int channel) {
-  return bit_set(sound_output_terminals_, channel + 4);
+  return bit_set(sound_output_terminals_, channel);
+}
+
+void SoundController::ForkFrom(SoundController &other) {
+  assert(other.sample_rate_ == sample_rate_);
+  *voice1_ = *other.voice1_;
+  *voice2_ = *other.voice2_;
+  *voice3_ = *other.voice3_;
+  *voice4_ = *other.voice4_;
+  blip_->CopyFrom(*other.blip_);
+  write_count_ = other.write_count_;
+  if (write_count_ && !writes_) {
+    writes_ = new RegisterWrite[MAX_REGISTER_WRITES];
+  }
+  std::copy(other.writes_, other.writes_ + write_count_, writes_);
+  now_ = other.now_;
+  frame_time_ = other.frame_time_;
+  sequencer_time_ = other.sequencer_time_;
+  sequencer_step_ = other.sequencer_step_;
+  sound_output_terminals_ = other.sound_output_terminals_;
+  global_sound_on_ = other.global_sound_on_;
+  channel_control_ = other.channel_control_;
 }
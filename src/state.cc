@@ -113,6 +113,8 @@ void State::WriteState(const std::string& path, const struct SaveState& state) {
   file.write(reinterpret_cast<const char*>(&state.mmu), sizeof(state.mmu));
   file.write(reinterpret_cast<const char*>(&state.interrupt_controller), sizeof(state.interrupt_controller));
   file.write(reinterpret_cast<const char*>(&state.ppu), sizeof(state.ppu));
+  file.write(reinterpret_cast<const char*>(&state.serial), sizeof(state.serial));
+  file.write(reinterpret_cast<const char*>(&state.cycles), sizeof(state.cycles));
   std::cout << "GetState: " << std::hex << unsigned(state.interrupt_controller.interrupts_enabled) << std::endl;
 
   std::cout << "END: Saved state to " << path << std::endl;
@@ -138,6 +140,8 @@ bool State::ReadState(const std::string& path, struct SaveState& state) {
   file.read(reinterpret_cast<char*>(&state.mmu), sizeof(state.mmu));
   file.read(reinterpret_cast<char*>(&state.interrupt_controller), sizeof(state.interrupt_controller));
   file.read(reinterpret_cast<char*>(&state.ppu), sizeof(state.ppu));
+  file.read(reinterpret_cast<char*>(&state.serial), sizeof(state.serial));
+  file.read(reinterpret_cast<char*>(&state.cycles), sizeof(state.cycles));
   std::cout << "ReadState: " << std::hex << unsigned(state.interrupt_controller.interrupts_enabled) << std::endl;
 
 
@@ -1,11 +1,6 @@
 #include "state_controller.h"
 
-#include "address_router.h"
-#include "cartridge.h"
-#include "cpu.h"
-#include "mmu.h"
-#include "interrupt_controller.h"
-#include "ppu.h"
+#include "emulator.h"
 #include "screen.h"
 #include "state.h"
 
@@ -15,10 +10,8 @@
 #include <iostream>
 #include <fstream>
 
-StateController::StateController(const std::string& game_state_dir, CPU* cpu, MMU* mmu, Cartridge* cartridge, 
-                               AddressRouter* router, InterruptController* interrupt_controller, PPU* ppu, Screen* screen)
-    : game_state_dir_(game_state_dir), cpu_(cpu), mmu_(mmu), cartridge_(cartridge), router_(router), 
-      interrupt_controller_(interrupt_controller), ppu_(ppu), screen_(screen) {
+StateController::StateController(const std::string& game_state_dir, Emulator* emulator)
+    : game_state_dir_(game_state_dir), emulator_(emulator) {
     memory_states_.resize(MEMORY_SAVES_COUNT);
 }
 
@@ -143,7 +136,7 @@ void StateController::SaveState(int slot) {
     new_state->SaveState(save_state);
     
     std::cout << "Taking state screenshot..." << std::endl;
-    screen_->SaveScreenshotToPath(new_state->GetScreenshotPath());
+    emulator_->screen()->SaveScreenshotToPath(new_state->GetScreenshotPath());
     if (slot != GetMainSlot()) {
         latest_rotating_slot_ = slot;
     }
@@ -174,23 +167,13 @@ bool StateController::LoadStateSlot(int slot) {
 
 struct SaveState StateController::GetSaveState() {
     struct SaveState save_state = {};
-    cpu_->GetState(save_state.cpu);
+    emulator_->GetState(save_state);
     std::cout << "CPU state saved at PC: " << std::hex << int(save_state.cpu.pc) << std::endl;
-    mmu_->GetState(save_state.mmu);
-    cartridge_->GetState(save_state.cartridge);
-    router_->SaveState(save_state.memory);
-    interrupt_controller_->GetState(save_state.interrupt_controller);
-    ppu_->GetState(save_state.ppu);
     return save_state;
 }
 
 bool StateController::LoadState(const struct SaveState& save_state) {
-    cpu_->SetState(save_state.cpu);
-    router_->LoadState(save_state.memory);
-    mmu_->SetState(save_state.mmu);
-    cartridge_->SetState(save_state.cartridge);
-    interrupt_controller_->SetState(save_state.interrupt_controller);
-    ppu_->SetState(save_state.ppu);
+    emulator_->SetState(save_state);
     
     std::cout << "Loaded state successfully" << std::endl;
     return true;
@@ -1,118 +1,148 @@
 #include "system.h"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <climits>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <string>
 #include <thread>
 
-#include "address_router.h"
-#include "bit_command.h"
-#include "command_factory.h"
+#include "audio_sink.h"
+#include "cartridge.h"
 #include "constants.h"
 #include "cpu.h"
+#include "emulator.h"
 #include "input_controller.h"
-#include "interrupt_controller.h"
-#include "mmu.h"
 #include "ppu.h"
 #include "screen.h"
-#include "serial_controller.h"
+#include "sdl_sinks.h"
+#include "shared_memory_export.h"
 #include "sound_controller.h"
 #include "state.h"
 #include "state_controller.h"
-#include "timer_controller.h"
-#include "utils.h"
-
-System::System(string rom_filename, string game_state_dir) {
-  bool skip_boot_rom = true;
-  mmu_ = GetMMU(skip_boot_rom);
-
-  cartridge_ = new Cartridge(rom_filename);
-  cartridge_->PrintDebugInfo();
-  mmu_->SetCartridge(cartridge_);
-
-  screen_ = new Screen();
-  ppu_ = new PPU(screen_);
+#include "video_sink.h"
+
+// Frames run-ahead may run on top of each real frame.
+const int MAX_RUN_AHEAD = 3;
+
+System::System(string rom_filename, string game_state_dir, SystemOptions options) {
+  headless_ = options.headless;
+  pacing_ = options.pacing;
+  pacing_stats_ = options.pacing_stats;
+
+  Cartridge *cartridge = new Cartridge(rom_filename);
+  cartridge->PrintDebugInfo();
+
+  if (headless_) {
+    video_sink_ = new HeadlessVideoSink();
+    audio_sink_ = new HeadlessAudioSink(options.sample_rate ? options.sample_rate : DEFAULT_SAMPLE_RATE);
+  } else {
+    sdl_video_sink_ = new SDLVideoSink();
+    video_sink_ = sdl_video_sink_;
+    audio_sink_ = new SDLAudioSink(options.audio_latency_ms, options.sample_rate);
+  }
 
-  serial_controller_ = new SerialController();
-  interrupt_controller_ = new InterruptController();
-  input_controller_ = new InputController();
-  input_controller_->SetInterruptHandler(interrupt_controller_);
+  EmulatorOptions emulator_options;
+  emulator_options.resample = options.resample;
+  emulator_options.echo_serial = true;
+  // main sends cout to log.txt.
+  emulator_options.log = [](const string &line) { std::cout << line << std::endl; };
+  if (!options.shared_memory_name.empty()) {
+    shared_memory_export_ =
+        SharedMemoryExport::Create(options.shared_memory_name, video_sink_, audio_sink_);
+  }
+  VideoSink *video_sink = video_sink_;
+  AudioSink *audio_sink = audio_sink_;
+  if (shared_memory_export_) {
+    video_sink = shared_memory_export_;
+    audio_sink = shared_memory_export_;
+  }
+  run_ahead_ = std::max(0, std::min(MAX_RUN_AHEAD, options.run_ahead));
+  if (run_ahead_) {
+    hidden_video_sink_ = new HeadlessVideoSink();
+    emulator_ = new Emulator(cartridge, emulator_options, hidden_video_sink_, audio_sink);
+    // Its frames are never shown, so don't draw them.
+    emulator_->ppu()->SetFrameSkip(INT_MAX);
+    // The fork's audio is thrown away, but must be made at the same rate.
+    ahead_audio_sink_ = new HeadlessAudioSink(audio_sink->sample_rate());
+    ahead_ = emulator_->Fork(video_sink, ahead_audio_sink_);
+    // It sees serial output before emulator_ does, and again after rewinds.
+    ahead_->SetSerialEcho(false);
+  } else {
+    emulator_ = new Emulator(cartridge, emulator_options, video_sink, audio_sink);
+  }
 #ifndef BUILD_IOS
-  input_controller_->SetScreenshotTaker(this);
-  input_controller_->SetStateNavigator(this);
+  emulator_->input_controller()->SetScreenshotTaker(this);
+  emulator_->input_controller()->SetStateNavigator(this);
 #endif  
-  timer_controller_ = new TimerController();
-  timer_controller_->SetInterruptHandler(interrupt_controller_);
-  sound_controller_ = new SoundController();
 
-  router_ = new AddressRouter(mmu_, ppu_, serial_controller_,
-                              interrupt_controller_, input_controller_,
-                              timer_controller_, sound_controller_);
-
-  interrupt_controller_->set_input_controller(input_controller_);
-
-  ppu_->SetInterruptHandler(interrupt_controller_);
-
-  cpu_ = new CPU(router_);
-  cpu_->SetInterruptController(interrupt_controller_);
+  if (!options.control_socket.empty()) {
+    control_server_ = ControlServer::Create(options.control_socket, emulator_, this);
+  }
 
-  state_controller_ = new StateController(game_state_dir, cpu_, mmu_, cartridge_, router_, 
-                                        interrupt_controller_, ppu_, screen_);
+  state_controller_ = new StateController(game_state_dir, emulator_);
   std::cout << "Saved state count: " << state_controller_->GetSaveStates().size() << std::endl;
 
-  frame_cycles_ = 0;
   last_frame_start_time_ = std::chrono::high_resolution_clock::now();
-
-  if (skip_boot_rom) {
-    cpu_->SkipBootROM();
-    router_->SkipBootROM();
-  }
+  next_frame_time_ = std::chrono::steady_clock::now();
 
   frame_count_ = 0;
 }
 
-MMU *System::GetMMU(bool skip_boot_rom) {
-  MMU *mmu = new MMU();
-
-  if (!skip_boot_rom) {
-    mmu->SetBootROM(UnsignedCartridgeBytes("Roms/boot.gb"));
-  }
-
-  return mmu;
-}
-
 void System::SetButtons(bool dpadUp, bool dpadDown, bool dpadLeft, bool dpadRight, bool buttonA, bool buttonB, bool buttonSelect, bool buttonStart) {
-  input_controller_->SetButtons(dpadUp, dpadDown, dpadLeft, dpadRight, buttonA, buttonB, buttonSelect, buttonStart);
+  emulator_->input_controller()->SetButtons(dpadUp, dpadDown, dpadLeft, dpadRight, buttonA, buttonB, buttonSelect, buttonStart);
 }
 
 void System::AdvanceOneFrame() {
-  state_controller_->WillStartFrame(frame_count_);
-  bool entered_vsync = false;
-  while (!entered_vsync) {
-    int stepped = cpu_->Step();
-    entered_vsync = ppu_->Advance(stepped);
-    timer_controller_->Advance(stepped);
-
-    sound_controller_->Advance(stepped);
-
-    interrupt_controller_->Advance(stepped);
-    int interrupt_steps = interrupt_controller_->HandleInterruptRequest();
-    // TODO: Interrupt handling should avance everything except CPU 20 cycles. #39.
-    assert(interrupt_steps == 0);
-
-    frame_cycles_ += stepped;
+  // Before the frame, so run-ahead sees the buttons too.
+  if (!headless_) {
+    emulator_->input_controller()->PollAndApplyEvents();
   }
+  RunOneFrame();
 
-  input_controller_->PollAndApplyEvents();
-  // std::cout << "Frame cycles: " << dec << frame_cycles_ << std::endl;
+#ifndef BUILD_IOS
+  if (headless_) {
+    return;
+  }
+  if (pacing_ == FramePacing_Audio) {
+    PaceToAudio();
+  }
+  WaitForNextFrame();
+#endif
+}
 
-  frame_cycles_ = 0;
+void System::RunOneFrame() {
+  state_controller_->WillStartFrame(frame_count_);
+  if (shared_memory_export_) {
+    shared_memory_export_->set_input(emulator_->input_controller()->held_buttons());
+  }
+  emulator_->RunFrame();
+  if (ahead_) {
+    RunAhead();
+  }
   frame_count_++;
+}
+
+void System::WaitForNextFrame() {
+  if (pacing_ == FramePacing_Audio) {
+    // Sleep until the next frame is due. Deadlines advance by exactly one
+    // frame so sleep overshoot doesn't accumulate.
+    static const std::chrono::duration<double> FRAME_TIME(double(CYCLES_PER_FRAME) / CYCLES_PER_SECOND);
+    next_frame_time_ += std::chrono::duration_cast<std::chrono::steady_clock::duration>(FRAME_TIME);
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_frame_time_) {
+      std::this_thread::sleep_until(next_frame_time_);
+    } else if (now - next_frame_time_ > 4 * FRAME_TIME) {
+      // Fell well behind, e.g. after loading a state. Don't try to catch up.
+      next_frame_time_ = now;
+    }
+    return;
+  }
 
-#ifndef BUILD_IOS
   static const std::chrono::duration<double> FRAME_TIME(1.0 / 60.0);
 
   auto current_time = std::chrono::high_resolution_clock::now();
@@ -122,7 +152,49 @@ void System::AdvanceOneFrame() {
     std::this_thread::sleep_for(FRAME_TIME - elapsed);
   }
   last_frame_start_time_ = std::chrono::high_resolution_clock::now();
-#endif
+  next_frame_time_ = std::chrono::steady_clock::now();
+}
+
+void System::RunAhead() {
+  // Forking from emulator_ each frame undoes the last run ahead, and costs
+  // only the memory pages either changes, rather than a save state.
+  ahead_->ForkFrom(*emulator_);
+  if (shared_memory_export_) {
+    shared_memory_export_->set_input(emulator_->input_controller()->held_buttons());
+  }
+  // Only the last frame is drawn, and shown.
+  ahead_->ppu()->SkipNextFrames(run_ahead_ - 1);
+  ahead_->RunFrames(run_ahead_);
+}
+
+// Most the audio rate is changed to keep the device buffer on target. Small
+// enough to be inaudible.
+const double MAX_AUDIO_RATE_DELTA = 0.005;
+
+void System::PaceToAudio() {
+  int buffered = audio_sink_->BufferedSamples();
+  int target = audio_sink_->TargetBufferedSamples();
+  if (buffered >= 0 && target > 0) {
+    // The frame clock and the device clock never quite agree. Produce a little
+    // more audio when the buffer is low and a little less when it is high.
+    double error = std::max(-1.0, std::min(1.0, double(target - buffered) / target));
+    audio_rate_ratio_ = 1.0 + MAX_AUDIO_RATE_DELTA * error;
+    emulator_->sound_controller()->SetRateRatio(audio_rate_ratio_);
+    audio_drift_samples_ += (audio_rate_ratio_ - 1.0) * audio_sink_->sample_rate() * CYCLES_PER_FRAME / CYCLES_PER_SECOND;
+    if (pacing_stats_ && frame_count_ % 600 == 0) {
+      std::cout << "Audio pacing: ratio " << audio_rate_ratio_ << " buffered " << std::dec << buffered
+                << " drift " << AudioDriftMs() << " ms underruns " << AudioUnderruns()
+                << " overruns " << AudioOverruns() << std::endl;
+    }
+  }
+}
+
+double System::AudioDriftMs() { return 1000.0 * audio_drift_samples_ / audio_sink_->sample_rate(); }
+
+void System::SetFrameSkip(int frame_skip) {
+  if (!ahead_) {
+    emulator_->ppu()->SetFrameSkip(frame_skip);
+  }
 }
 
 void System::SaveState() {
@@ -151,10 +223,14 @@ void System::GoBackInMemory() {
 }
 
 void System::TakeScreenshot() {
-    screen_->SaveScreenshot(cartridge_->GameTitle());
+    shown()->screen()->SaveScreenshot(emulator_->cartridge()->GameTitle());
 }
 
-const uint32_t* System::pixels() { return screen_->pixels(); }
+const uint32_t* System::pixels() { return shown()->screen()->pixels(); }
+
+uint64_t System::AudioUnderruns() { return audio_sink_->underruns(); }
+
+uint64_t System::AudioOverruns() { return audio_sink_->overruns(); }
 
 std::vector<std::unique_ptr<State>> System::GetSaveStates() {
   return state_controller_->GetSaveStates();
@@ -162,9 +238,46 @@ std::vector<std::unique_ptr<State>> System::GetSaveStates() {
 
 void System::Main() {
   if (SUPER_DEBUG) {
-    cpu_->SetDebugPrint(true);
+    emulator_->cpu()->SetDebugPrint(true);
   }
-  while (true) {
+  while (headless_) {
+    if (control_server_) {
+      // Frames only run when asked for, so wait for requests.
+      control_server_->Poll(-1);
+      continue;
+    }
     AdvanceOneFrame();
   }
+
+  // SDL only allows rendering and polling events on the main thread, and
+  // presenting can block for vsync, so frames run on a thread of their own
+  // and are handed over through the Screen's triple buffer.
+  emulation_thread_ = std::thread([this] { EmulationLoop(); });
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(emulator_mutex_);
+      emulator_->input_controller()->PollAndApplyEvents();
+      if (control_server_) {
+        // Requests are served between frames.
+        control_server_->Poll(0);
+      }
+    }
+    if (!sdl_video_sink_->Present()) {
+      // No new frame yet.
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+void System::EmulationLoop() {
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(emulator_mutex_);
+      RunOneFrame();
+      if (pacing_ == FramePacing_Audio) {
+        PaceToAudio();
+      }
+    }
+    WaitForNextFrame();
+  }
 }
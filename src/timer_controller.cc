@@ -5,6 +5,7 @@
 
 #include "constants.h"
 #include "interrupt_controller.h"
+#include "state.h"
 
 using std::cout;
 using std::endl;
@@ -128,6 +129,23 @@ void TimerController::Advance(int cycles) {
   }
 }
 
+void TimerController::SetState(const struct TimerSaveState& state) {
+  SetByteAt(0xFF07, state.tac);
+  tima_ = state.tima;
+  modulo_ = state.tma;
+  div_counter_ = state.div_counter;
+  advanced_ = state.tima_cycles;
+}
+
+void TimerController::GetState(struct TimerSaveState& state) {
+  state.div = GetByteAt(0xFF04);
+  state.tima = tima_;
+  state.tma = modulo_;
+  state.tac = GetByteAt(0xFF07);
+  state.div_counter = div_counter_;
+  state.tima_cycles = advanced_;
+}
+
 void TimerController::Debugger() {
   cout << "DIV: " << hex << unsigned(GetByteAt(0xFF04)) << endl;
   cout << "TIMA: " << hex << unsigned(tima_) << endl;
@@ -4,6 +4,7 @@
 
 #include "command_factory.h"
 #include "cpu.h"
+#include "logger.h"
 #include "mmu.h"
 
 UnimplementedCommand::UnimplementedCommand(uint8_t opcode) {
@@ -16,9 +17,9 @@ UnimplementedCommand::~UnimplementedCommand() {}
 
 void UnimplementedCommand::Run(CPU *cpu) {
   // Nop.
-  (void)cpu;
-
-  cout << "Unimplemented CPU opcode: " << hex << unsigned(opcode) << endl;
+  if (cpu->logger()) {
+    cpu->logger()->Line() << "Unimplemented CPU opcode: " << hex << unsigned(opcode);
+  }
   assert(false);
 }
 
@@ -1,6 +1,9 @@
 #include "utils.h"
 
 #include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 
@@ -9,9 +12,30 @@
 #include "mmu.h"
 #include "ppu.h"
 #include "screen.h"
+#include "video_sink.h"
 
 using namespace std;
 
+bool ParseInt64(const char *text, int64_t &value) {
+  char *end;
+  errno = 0;
+  long long number = strtoll(text, &end, 10);
+  if (end == text || *end != '\0' || errno == ERANGE) {
+    return false;
+  }
+  value = number;
+  return true;
+}
+
+bool ParseInt(const char *text, int &value) {
+  int64_t number;
+  if (!ParseInt64(text, number) || number < INT_MIN || number > INT_MAX) {
+    return false;
+  }
+  value = (int)number;
+  return true;
+}
+
 uint16_t buildMsbLsb16(uint8_t msb, uint8_t lsb) {
   uint16_t word = msb;
   word = word << 8;
@@ -108,7 +132,7 @@ bool bit_set(uint8_t byte, int bit) { return (byte >> bit) & 0x1; }
 
 std::string descriptionforPixel(Pixel p) {
   stringstream stream;
-  stream << hex << unsigned(p.two_bit_color_) << " P:" << p.palette_;
+  stream << hex << unsigned(PixelColor(p)) << " P:" << PixelPalette(p);
   return stream.str();
 }
 
@@ -145,7 +169,7 @@ MMU *getTestingMMURAM() {
 
 CPU *getTestingCPU() {
   MMU *mmu = getTestingMMU();
-  PPU *ppu = new PPU(new Screen());
+  PPU *ppu = new PPU(new Screen(new HeadlessVideoSink()));
   AddressRouter *address_router =
       new AddressRouter(mmu, ppu, NULL, NULL, NULL, NULL, NULL);
   CPU *cpu = new CPU(address_router);
@@ -157,7 +181,7 @@ CPU *getTestingCPU() {
 
 CPU *getTestingCPUWithInstructions(std::vector<uint8_t> instructions) {
   MMU *mmu = getTestingMMU();
-  PPU *ppu = new PPU(new Screen());
+  PPU *ppu = new PPU(new Screen(new HeadlessVideoSink()));
   AddressRouter *address_router =
       new AddressRouter(mmu, ppu, NULL, NULL, NULL, NULL, NULL);
   CPU *cpu = new CPU(address_router);
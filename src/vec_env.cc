@@ -0,0 +1,199 @@
+#include "vec_env.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "job_pool.h"
+#include "mmu.h"
+#include "ppu.h"
+#include "screen.h"
+
+const int WORK_RAM_SIZE = WORK_RAM_END - WORK_RAM_START + 1;
+const int HIGH_RAM_SIZE = HIGH_RAM_END - HIGH_RAM_START + 1;
+
+VecEnv *VecEnv::Create(const uint8_t *rom, size_t size, int envs, VecEnvOptions options,
+                       EmulatorOptions emulator_options) {
+  int downsample = options.downsample;
+  bool power_of_two = downsample > 0 && (downsample & (downsample - 1)) == 0;
+  if (envs <= 0 || options.action_repeat <= 0 || options.threads < 0 || !power_of_two ||
+      SCREEN_WIDTH % downsample != 0 || SCREEN_HEIGHT % downsample != 0) {
+    return nullptr;
+  }
+  vector<Emulator *> emulators;
+  for (int i = 0; i < envs; i++) {
+    Emulator *emulator = Emulator::Create(rom, size, emulator_options);
+    if (!emulator) {
+      for (Emulator *made : emulators) {
+        delete made;
+      }
+      return nullptr;
+    }
+    emulators.push_back(emulator);
+  }
+  return new VecEnv(emulators, options);
+}
+
+VecEnv::VecEnv(vector<Emulator *> emulators, VecEnvOptions options) {
+  emulators_ = emulators;
+  options_ = options;
+  if (options_.threads != 1) {
+    pool_ = new JobPool(options_.threads);
+  }
+  width_ = SCREEN_WIDTH / options_.downsample;
+  height_ = SCREEN_HEIGHT / options_.downsample;
+  channels_ = options_.grayscale ? 1 : 3;
+  block_shift_ = 0;
+  while ((1 << block_shift_) < options_.downsample * options_.downsample) {
+    block_shift_++;
+  }
+  if (options_.max_pool && options_.action_repeat >= 2) {
+    pooled_frames_.resize(emulators_.size() * SCREEN_PIXELS);
+  }
+
+  // Snapshots only restore exactly from a frame's end, and power on is part
+  // way through one.
+  for (Emulator *emulator : emulators_) {
+    emulator->RunFrame();
+  }
+  Emulator *first = emulators_[0];
+  initial_state_ = first->Snapshot();
+  initial_observation_.resize(observation_size());
+  Observe(first->framebuffer(), initial_observation_.data());
+  initial_ram_.resize(VEC_ENV_RAM_SIZE);
+  ReadRAM(0, initial_ram_.data());
+}
+
+VecEnv::~VecEnv() {
+  delete pool_;
+  for (Emulator *emulator : emulators_) {
+    delete emulator;
+  }
+}
+
+void VecEnv::Reset(uint8_t *observations, uint8_t *ram) {
+  for (int i = 0; i < envs(); i++) {
+    ResetEnv(i, observations, ram);
+  }
+}
+
+void VecEnv::ResetEnv(int env, uint8_t *observations, uint8_t *ram) {
+  emulators_[env]->Restore(initial_state_.data(), initial_state_.size());
+  emulators_[env]->SetInput(0);
+  if (observations) {
+    memcpy(observations + (size_t)env * observation_size(), initial_observation_.data(),
+           initial_observation_.size());
+  }
+  if (ram) {
+    memcpy(ram + (size_t)env * VEC_ENV_RAM_SIZE, initial_ram_.data(), initial_ram_.size());
+  }
+}
+
+void VecEnv::Step(const uint8_t *actions, uint8_t *observations, uint8_t *ram) {
+  actions_ = actions;
+  observations_ = observations;
+  ram_ = ram;
+  if (!pool_) {
+    StepEnvs(0, envs());
+    return;
+  }
+  // One share per thread, so a step queues a few jobs rather than one per
+  // environment.
+  int threads = pool_->thread_count();
+  for (int share = 0; share < threads; share++) {
+    int begin = envs() * share / threads;
+    int end = envs() * (share + 1) / threads;
+    if (begin < end) {
+      pool_->Submit([this, begin, end] { StepEnvs(begin, end); });
+    }
+  }
+  pool_->Wait();
+}
+
+void VecEnv::StepEnvs(int begin, int end) {
+  for (int i = begin; i < end; i++) {
+    StepEnv(i);
+  }
+}
+
+void VecEnv::StepEnv(int env) {
+  Emulator *emulator = emulators_[env];
+  emulator->SetInput(actions_[env]);
+  int repeat = options_.action_repeat;
+  // The frames observed: the last, and with pooling the one before.
+  bool pool = !pooled_frames_.empty();
+  int first_observed = repeat - (pool ? 2 : 1);
+  uint32_t *pooled = pool ? &pooled_frames_[(size_t)env * SCREEN_PIXELS] : nullptr;
+  for (int frame = 0; frame < repeat; frame++) {
+    // Each frame ends deciding whether the PPU draws the next, which after
+    // the last frame is the next step's first. Skipping at most repeat frames
+    // keeps the PPU's count bounded when nothing is observed.
+    int next = frame + 1 < repeat ? frame + 1 : 0;
+    bool draw_next = next >= first_observed && (observations_ || next == 0);
+    emulator->ppu()->SetFrameSkip(draw_next ? 0 : repeat);
+    emulator->RunFrame();
+    if (!observations_ || frame < first_observed) {
+      continue;
+    }
+    const uint32_t *pixels = emulator->framebuffer();
+    if (pool && frame == first_observed) {
+      memcpy(pooled, pixels, SCREEN_PIXELS * sizeof(uint32_t));
+    } else if (pool) {
+      MaxPool(pixels, pooled);
+      Observe(pooled, observations_ + (size_t)env * observation_size());
+    } else {
+      Observe(pixels, observations_ + (size_t)env * observation_size());
+    }
+  }
+  if (ram_) {
+    ReadRAM(env, ram_ + (size_t)env * VEC_ENV_RAM_SIZE);
+  }
+}
+
+void VecEnv::MaxPool(const uint32_t *pixels, uint32_t *pooled) {
+  for (int i = 0; i < SCREEN_PIXELS; i++) {
+    uint32_t a = pixels[i];
+    uint32_t b = pooled[i];
+    uint32_t argb = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      argb |= max((a >> shift) & 0xFF, (b >> shift) & 0xFF) << shift;
+    }
+    pooled[i] = argb;
+  }
+}
+
+void VecEnv::Observe(const uint32_t *pixels, uint8_t *observation) {
+  int downsample = options_.downsample;
+  // Sums of each block, for one row of blocks.
+  uint32_t sums[SCREEN_WIDTH * 3];
+  for (int y = 0; y < height_; y++) {
+    memset(sums, 0, sizeof(sums));
+    for (int row = y * downsample; row < (y + 1) * downsample; row++) {
+      const uint32_t *line = pixels + row * SCREEN_WIDTH;
+      for (int x = 0; x < SCREEN_WIDTH; x++) {
+        uint32_t argb = line[x];
+        uint32_t r = (argb >> 16) & 0xFF;
+        uint32_t g = (argb >> 8) & 0xFF;
+        uint32_t b = argb & 0xFF;
+        uint32_t *sum = &sums[(x / downsample) * channels_];
+        if (channels_ == 1) {
+          // BT.601 luma.
+          sum[0] += (r * 77 + g * 150 + b * 29) >> 8;
+        } else {
+          sum[0] += r;
+          sum[1] += g;
+          sum[2] += b;
+        }
+      }
+    }
+    uint8_t *out = observation + y * width_ * channels_;
+    for (int i = 0; i < width_ * channels_; i++) {
+      out[i] = sums[i] >> block_shift_;
+    }
+  }
+}
+
+void VecEnv::ReadRAM(int env, uint8_t *ram) {
+  MMU *mmu = emulators_[env]->mmu();
+  mmu->work_ram().Read(0, ram, WORK_RAM_SIZE);
+  memcpy(ram + WORK_RAM_SIZE, mmu->high_ram(), HIGH_RAM_SIZE);
+}
@@ -1,86 +1,74 @@
 #include "wave_voice.h"
 
-#include <math.h>
-
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <mutex>
 
+#include "blip_buffer.h"
 #include "constants.h"
 #include "utils.h"
 
 const uint16_t WaveVoice::BASE_WAVE_PATTERN_ADDRESS = 0xFF30;
 
-WaveVoice::WaveVoice() {}
-
-WaveVoice::~WaveVoice() {}
+int16_t WaveVoice::amplitudes_[4][16];
 
-int16_t WaveVoice::GetSample() {
-  timer_cycles_ -= CYCLES_PER_SAMPLE;
-  if (timer_cycles_ <= 0) {
-    timer_cycles_ += CYCLES_PER_SOUND_TIMER_TICK;
-    if (length_enable_) {
-      length_ = std::max(length_ - 1, 0);
-      if (length_ == 0) {
-        enabled_ = false;
-        return 0;
-      }
+void WaveVoice::InitAmplitudes() {
+  for (int nibble = 0; nibble < 16; nibble++) {
+    // Muted, then 100%, 50% and 25% of the nibble centered on 7.5.
+    amplitudes_[0][nibble] = 0;
+    for (int level = 1; level < 4; level++) {
+      amplitudes_[level][nibble] = (2 * nibble - 15) * VOICE_MAX_VOLUME / (15 << (level - 1));
     }
   }
+}
 
-  if (!enabled_) {
+WaveVoice::WaveVoice() {
+  static std::once_flag once;
+  std::call_once(once, InitAmplitudes);
+}
+
+WaveVoice::~WaveVoice() {}
+
+int WaveVoice::Amplitude() {
+  if (!enabled_ || !DACEnabled()) {
     return 0;
   }
+  return amplitudes_[output_level_][Nibble()];
+}
 
-  next_sample_cycles_ -= CYCLES_PER_SAMPLE;
-  if (next_sample_cycles_ <= 0) {
-    sample_index_ += 1;
-    if (sample_index_ >= 32) {
-      sample_index_ = 0;
-    }
-    next_sample_cycles_ += cycles_per_sample_;
+void WaveVoice::Run(int start_time, int end_time, BlipBuffer* buffer) {
+  output_.Update(buffer, start_time, Amplitude());
+  if (!enabled_) {
+    return;
   }
 
-  int16_t sample = CenteredSample() * VOICE_MAX_VOLUME;
-
-  return sample;
+  int period = CyclesPerSample();
+  int time = start_time + next_sample_cycles_;
+  while (time < end_time) {
+    sample_index_ = (sample_index_ + 1) & 31;
+    output_.Update(buffer, time, Amplitude());
+    time += period;
+  }
+  next_sample_cycles_ = time - end_time;
 }
 
-void WaveVoice::AddSamplesToBuffer(int16_t* buffer, int samples) {
-  for (int i = 0; i < samples; i++) {
-    buffer[i] += GetSample();
+void WaveVoice::ClockLength() {
+  if (length_enable_ && length_ > 0) {
+    length_--;
+    if (length_ == 0) {
+      enabled_ = false;
+    }
   }
 }
 
-float WaveVoice::CenteredSample() {
+uint8_t WaveVoice::Nibble() {
   assert(sample_index_ >= 0 && sample_index_ < 32);
   uint8_t byte = wave_pattern_[sample_index_ / 2]; // First sample packed high bits.
-  uint8_t nibble;
   if (sample_index_ % 2 == 0) {
-    nibble = byte >> 4;
-  } else {
-    nibble = byte & 0x0F;
+    return byte >> 4;
   }
-
-  if (!DACEnabled()) {
-    return 0.0f;
-  }
-  float centered = float(nibble) - 7.5f;
-
-  switch (output_level_) {
-    case 0b00:
-      return 0.0f; // Mute.
-    case 0b01:
-      centered /= 7.5f; // 100%
-      break;
-    case 0b10:
-      centered /= 15.0f; // 50%
-      break;
-    case 0b11:
-      centered /= 30.0f; // 25%
-      break;
-  }
-  return std::min(1.0f, std::max(centered, -1.0f));
+  return byte & 0x0F;
 }
 
 bool WaveVoice::DACEnabled() {
@@ -114,12 +102,11 @@ void WaveVoice::SetNR34(uint8_t byte) {
       length_ = WAVE_MAX_LENGTH;
     }
 
-    cycles_per_sample_ = CYCLES_PER_SECOND / FrequencyHz();
     output_level_ = (nr32_ & 0x60) >> 5;
 
     sample_index_ = 0;
-    // Do not adjust timer_cycles_. It is independent of trigger.
-    next_sample_cycles_ = cycles_per_sample_;
+    // The length timer is the frame sequencer's, which triggering doesn't reset.
+    next_sample_cycles_ = CyclesPerSample();
   }
 
   // PrintDebug();
@@ -130,9 +117,8 @@ void WaveVoice::PrintDebug() {
   std::cout << "enabled_: " << enabled_ << std::endl;
   std::cout << "length_: " << length_ << std::endl;
   std::cout << "sample_index_: " << (int)sample_index_ << std::endl;
-  std::cout << "Frequency: " << FrequencyHz() << std::endl;
   std::cout << "Period value: " << PeriodValue() << std::endl;
-  std::cout << "cycles_per_sample_: " << cycles_per_sample_ << std::endl;
+  std::cout << "Cycles per sample: " << CyclesPerSample() << std::endl;
   std::cout << "output_level_: " << output_level_ << std::endl;
 }
 
@@ -154,6 +140,3 @@ uint16_t WaveVoice::PeriodValue() {
   return period;
 }
 
-float WaveVoice::FrequencyHz() {
-  return 2097152 / (2048 - PeriodValue());
-}
@@ -0,0 +1,610 @@
+#include "wide_cpu.h"
+
+#include <cassert>
+
+#include "address_router.h"
+#include "cpu.h"
+#include "state.h"
+
+// Builds each kernel for AVX-512, AVX2 and baseline, picking one at load time
+// for the machine it runs on. Elsewhere the compiler vectorizes for the
+// baseline.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define WIDE_KERNEL __attribute__((target_clones("arch=skylake-avx512", "avx2", "default")))
+#else
+#define WIDE_KERNEL
+#endif
+
+const int REGISTER_B = 0;
+const int REGISTER_C = 1;
+const int REGISTER_D = 2;
+const int REGISTER_E = 3;
+const int REGISTER_H = 4;
+const int REGISTER_L = 5;
+const int REGISTER_F = 6;
+const int REGISTER_A = 7;
+// Where (HL) sits in the register encoding.
+const int OPERAND_HL = 6;
+
+const uint8_t FLAG_Z = 0x80;
+const uint8_t FLAG_N = 0x40;
+const uint8_t FLAG_H = 0x20;
+const uint8_t FLAG_C = 0x10;
+
+const uint16_t ROM_BANK_0_SIZE = 0x4000;
+
+// Kernels. Each runs over n lanes, and only changes those whose mask byte is
+// 0xFF, blending rather than branching so every lane takes the same path.
+
+static inline uint8_t Blend(uint8_t mask, uint8_t value, uint8_t old) {
+  return (value & mask) | (old & ~mask);
+}
+
+static inline uint16_t Blend16(uint8_t mask, uint16_t value, uint16_t old) {
+  uint16_t wide_mask = (uint16_t)(int16_t)(int8_t)mask;
+  return (value & wide_mask) | (old & ~wide_mask);
+}
+
+WIDE_KERNEL static void Move8(uint8_t *to, const uint8_t *from, const uint8_t *mask, int n) {
+  for (int i = 0; i < n; i++) {
+    to[i] = Blend(mask[i], from[i], to[i]);
+  }
+}
+
+// ADD and ADC. carry is 1 for ADC.
+WIDE_KERNEL static void Add8(uint8_t *a, const uint8_t *operand, uint8_t *f, uint8_t carry,
+                             const uint8_t *mask, int n) {
+  for (int i = 0; i < n; i++) {
+    unsigned x = a[i], y = operand[i], carry_in = (f[i] >> 4) & carry;
+    unsigned sum = x + y + carry_in;
+    unsigned half = (x & 0xF) + (y & 0xF) + carry_in;
+    uint8_t result = sum;
+    uint8_t flags = (result == 0 ? FLAG_Z : 0) | (half > 0xF ? FLAG_H : 0) |
+                    (sum > 0xFF ? FLAG_C : 0);
+    a[i] = Blend(mask[i], result, a[i]);
+    f[i] = Blend(mask[i], flags, f[i]);
+  }
+}
+
+// SUB, SBC and CP. carry is 1 for SBC, and store 0 for CP.
+WIDE_KERNEL static void Sub8(uint8_t *a, const uint8_t *operand, uint8_t *f, uint8_t carry,
+                             uint8_t store, const uint8_t *mask, int n) {
+  for (int i = 0; i < n; i++) {
+    int x = a[i], y = operand[i], carry_in = (f[i] >> 4) & carry;
+    int difference = x - y - carry_in;
+    int half = (x & 0xF) - (y & 0xF) - carry_in;
+    uint8_t result = difference;
+    uint8_t flags = (result == 0 ? FLAG_Z : 0) | FLAG_N | (half < 0 ? FLAG_H : 0) |
+                    (difference < 0 ? FLAG_C : 0);
+    a[i] = Blend(mask[i] & store, result, a[i]);
+    f[i] = Blend(mask[i], flags, f[i]);
+  }
+}
+
+WIDE_KERNEL static void And8(uint8_t *a, const uint8_t *operand, uint8_t *f, const uint8_t *mask,
+                             int n) {
+  for (int i = 0; i < n; i++) {
+    uint8_t result = a[i] & operand[i];
+    uint8_t flags = (result == 0 ? FLAG_Z : 0) | FLAG_H;
+    a[i] = Blend(mask[i], result, a[i]);
+    f[i] = Blend(mask[i], flags, f[i]);
+  }
+}
+
+// XOR, or OR if !exclusive.
+WIDE_KERNEL static void Or8(uint8_t *a, const uint8_t *operand, uint8_t *f, bool exclusive,
+                            const uint8_t *mask, int n) {
+  uint8_t xor_mask = exclusive ? 0xFF : 0x00;
+  for (int i = 0; i < n; i++) {
+    uint8_t x = a[i], y = operand[i];
+    // x | y when not exclusive, since (x ^ y) | (x & y) == x | y.
+    uint8_t result = (x ^ y) | (x & y & ~xor_mask);
+    uint8_t flags = result == 0 ? FLAG_Z : 0;
+    a[i] = Blend(mask[i], result, a[i]);
+    f[i] = Blend(mask[i], flags, f[i]);
+  }
+}
+
+// INC, or DEC if !increment. C is unaffected.
+WIDE_KERNEL static void Step8(uint8_t *r, uint8_t *f, bool increment, const uint8_t *mask, int n) {
+  uint8_t delta = increment ? 1 : 0xFF;
+  uint8_t half_nibble = increment ? 0xF : 0x0;
+  uint8_t n_flag = increment ? 0 : FLAG_N;
+  for (int i = 0; i < n; i++) {
+    uint8_t x = r[i];
+    uint8_t result = x + delta;
+    uint8_t flags = (f[i] & FLAG_C) | (result == 0 ? FLAG_Z : 0) | n_flag |
+                    ((x & 0xF) == half_nibble ? FLAG_H : 0);
+    r[i] = Blend(mask[i], result, r[i]);
+    f[i] = Blend(mask[i], flags, f[i]);
+  }
+}
+
+// 16 bit INC or DEC of a register pair.
+WIDE_KERNEL static void Step16(uint8_t *high, uint8_t *low, uint16_t delta, const uint8_t *mask,
+                               int n) {
+  for (int i = 0; i < n; i++) {
+    uint16_t result = ((high[i] << 8) | low[i]) + delta;
+    high[i] = Blend(mask[i], result >> 8, high[i]);
+    low[i] = Blend(mask[i], result & 0xFF, low[i]);
+  }
+}
+
+WIDE_KERNEL static void StepSP(uint16_t *sp, uint16_t delta, const uint8_t *mask, int n) {
+  for (int i = 0; i < n; i++) {
+    sp[i] = Blend16(mask[i], sp[i] + delta, sp[i]);
+  }
+}
+
+WIDE_KERNEL static void Split16(uint8_t *high, uint8_t *low, const uint16_t *value,
+                                const uint8_t *mask, int n) {
+  for (int i = 0; i < n; i++) {
+    high[i] = Blend(mask[i], value[i] >> 8, high[i]);
+    low[i] = Blend(mask[i], value[i] & 0xFF, low[i]);
+  }
+}
+
+WIDE_KERNEL static void Move16(uint16_t *to, const uint16_t *from, const uint8_t *mask, int n) {
+  for (int i = 0; i < n; i++) {
+    to[i] = Blend16(mask[i], from[i], to[i]);
+  }
+}
+
+// Moves pc to target where (f & flag) == expect, otherwise past the
+// instruction, and sets the cycles each lane took. flag 0 always jumps.
+WIDE_KERNEL static void Branch(uint16_t *pc, uint8_t *cycles, const uint8_t *f,
+                               const uint16_t *target, uint16_t next, uint8_t flag,
+                               uint8_t expect, uint8_t taken_cycles, uint8_t skipped_cycles,
+                               const uint8_t *mask, int n) {
+  for (int i = 0; i < n; i++) {
+    bool taken = (f[i] & flag) == expect;
+    pc[i] = Blend16(mask[i], taken ? target[i] : next, pc[i]);
+    cycles[i] = Blend(mask[i], taken ? taken_cycles : skipped_cycles, cycles[i]);
+  }
+}
+
+WIDE_KERNEL static void Finish(uint16_t *pc, uint8_t *cycles, uint16_t next, uint8_t took,
+                               const uint8_t *mask, int n) {
+  for (int i = 0; i < n; i++) {
+    pc[i] = Blend16(mask[i], next, pc[i]);
+    cycles[i] = Blend(mask[i], took, cycles[i]);
+  }
+}
+
+WIDE_KERNEL static void MatchPC(uint8_t *mask, const uint8_t *todo, const uint16_t *pc,
+                                uint16_t leader_pc, int n) {
+  for (int i = 0; i < n; i++) {
+    mask[i] = todo[i] & (pc[i] == leader_pc ? 0xFF : 0x00);
+  }
+}
+
+// Instruction length, or 0 if it has no wide form.
+static int WideLength(uint8_t opcode) {
+  uint8_t row = opcode >> 4;
+  uint8_t column = opcode & 0xF;
+  if (opcode >= 0x40 && opcode < 0xC0) {
+    // LD r,r' and ALU A,r, but not HALT.
+    return opcode == 0x76 ? 0 : 1;
+  }
+  if (row < 4) {
+    switch (column) {
+      case 0x0:
+        return opcode == 0x00 ? 1 : opcode == 0x10 ? 0 : 2;  // NOP, STOP, JR cc
+      case 0x1:
+        return 3;  // LD rr,nn
+      case 0x2:
+      case 0xA:
+      case 0x3:
+      case 0xB:
+        return 1;  // Loads through BC, DE, HL+ and HL-, and 16 bit INC/DEC.
+      case 0x4:
+      case 0x5:
+      case 0xC:
+      case 0xD:
+        return row == 3 && column < 8 ? 0 : 1;  // INC/DEC r, but not (HL).
+      case 0x6:
+      case 0xE:
+        return row == 3 && column < 8 ? 0 : 2;  // LD r,n, but not (HL).
+      case 0x8:
+        return opcode == 0x18 || opcode == 0x28 || opcode == 0x38 ? 2 : 0;
+      default:
+        return 0;
+    }
+  }
+  switch (opcode) {
+    case 0xC6:
+    case 0xCE:
+    case 0xD6:
+    case 0xDE:
+    case 0xE6:
+    case 0xEE:
+    case 0xF6:
+    case 0xFE:
+    case 0xE0:
+    case 0xF0:
+      return 2;
+    case 0xC2:
+    case 0xC3:
+    case 0xCA:
+    case 0xD2:
+    case 0xDA:
+    case 0xEA:
+    case 0xFA:
+      return 3;
+    default:
+      return 0;
+  }
+}
+
+void WideCPU::LaneExecutor::InterruptToPC(uint8_t pc) {
+  wide_cpu->ToCPU(lane);
+  wide_cpu->emulators_[lane]->cpu()->InterruptToPC(pc);
+  wide_cpu->FromCPU(lane);
+}
+
+WideCPU *WideCPU::Create(const uint8_t *rom, size_t size, int lanes, EmulatorOptions options) {
+  if (lanes <= 0) {
+    return nullptr;
+  }
+  vector<Emulator *> emulators;
+  for (int i = 0; i < lanes; i++) {
+    Emulator *emulator = Emulator::Create(rom, size, options);
+    if (!emulator) {
+      for (Emulator *made : emulators) {
+        delete made;
+      }
+      return nullptr;
+    }
+    emulators.push_back(emulator);
+  }
+  return new WideCPU(rom, size, emulators);
+}
+
+WideCPU::WideCPU(const uint8_t *rom, size_t size, vector<Emulator *> emulators) {
+  // Emulator::Create checked the header's ROM size, which is at least 32k.
+  assert(size >= ROM_BANK_0_SIZE);
+  bank0_.assign(rom, rom + ROM_BANK_0_SIZE);
+  emulators_ = emulators;
+  lanes_ = emulators_.size();
+  executors_.resize(lanes_);
+  for (int i = 0; i < lanes_; i++) {
+    executors_[i].wide_cpu = this;
+    executors_[i].lane = i;
+  }
+  for (vector<uint8_t> &r : r8_) {
+    r.resize(lanes_);
+  }
+  sp_.resize(lanes_);
+  pc_.resize(lanes_);
+  done_.resize(lanes_);
+  todo_.resize(lanes_);
+  mask_.resize(lanes_);
+  imm8_.resize(lanes_);
+  imm16_.resize(lanes_);
+  cycles_.resize(lanes_);
+}
+
+WideCPU::~WideCPU() {
+  for (Emulator *emulator : emulators_) {
+    delete emulator;
+  }
+}
+
+void WideCPU::ToCPU(int lane) {
+  struct CPUSaveState state;
+  state.b = r8_[REGISTER_B][lane];
+  state.c = r8_[REGISTER_C][lane];
+  state.d = r8_[REGISTER_D][lane];
+  state.e = r8_[REGISTER_E][lane];
+  state.h = r8_[REGISTER_H][lane];
+  state.l = r8_[REGISTER_L][lane];
+  state.f = r8_[REGISTER_F][lane];
+  state.a = r8_[REGISTER_A][lane];
+  state.flag_z = state.f & FLAG_Z;
+  state.flag_n = state.f & FLAG_N;
+  state.flag_h = state.f & FLAG_H;
+  state.flag_c = state.f & FLAG_C;
+  state.sp = sp_[lane];
+  state.pc = pc_[lane];
+  emulators_[lane]->cpu()->SetState(state);
+}
+
+void WideCPU::FromCPU(int lane) {
+  struct CPUSaveState state;
+  emulators_[lane]->cpu()->GetState(state);
+  r8_[REGISTER_B][lane] = state.b;
+  r8_[REGISTER_C][lane] = state.c;
+  r8_[REGISTER_D][lane] = state.d;
+  r8_[REGISTER_E][lane] = state.e;
+  r8_[REGISTER_H][lane] = state.h;
+  r8_[REGISTER_L][lane] = state.l;
+  r8_[REGISTER_F][lane] = state.f;
+  r8_[REGISTER_A][lane] = state.a;
+  sp_[lane] = state.sp;
+  pc_[lane] = state.pc;
+}
+
+void WideCPU::RunFrame() {
+  for (int i = 0; i < lanes_; i++) {
+    FromCPU(i);
+    emulators_[i]->interrupt_controller()->set_executor(&executors_[i]);
+    done_[i] = 0;
+  }
+  int running = lanes_;
+  while (running > 0) {
+    Step();
+    for (int i = 0; i < lanes_; i++) {
+      if (!done_[i] && emulators_[i]->AdvanceDevices(cycles_[i])) {
+        emulators_[i]->EndFrame();
+        done_[i] = 0xFF;
+        running--;
+      }
+    }
+  }
+  for (int i = 0; i < lanes_; i++) {
+    ToCPU(i);
+    emulators_[i]->interrupt_controller()->set_executor(emulators_[i]->cpu());
+  }
+}
+
+void WideCPU::RunFrames(int count) {
+  for (int i = 0; i < count; i++) {
+    RunFrame();
+  }
+}
+
+bool WideCPU::CanRunWide(int lane) {
+  return !emulators_[lane]->interrupt_controller()->IsHalted() &&
+         !emulators_[lane]->cpu()->halt_or_stop_pending();
+}
+
+int WideCPU::StepScalar(int lane) {
+  scalar_steps_++;
+  CPU *cpu = emulators_[lane]->cpu();
+  if (emulators_[lane]->interrupt_controller()->IsHalted() && !cpu->halt_or_stop_pending()) {
+    // Halted steps don't touch registers.
+    return cpu->Step();
+  }
+  ToCPU(lane);
+  int cycles = cpu->Step();
+  FromCPU(lane);
+  return cycles;
+}
+
+uint8_t WideCPU::Fetch(int lane, uint16_t address) {
+  if (address < ROM_BANK_0_SIZE) {
+    return bank0_[address];
+  }
+  return emulators_[lane]->router()->GetByteAt(address);
+}
+
+void WideCPU::Step() {
+  // Every lane still in its frame runs one instruction. The first lane left
+  // leads a group of all those at its PC, then the next lane left, and so
+  // on.
+  for (int i = 0; i < lanes_; i++) {
+    todo_[i] = ~done_[i];
+  }
+  for (int leader = 0; leader < lanes_; leader++) {
+    if (!todo_[leader]) {
+      continue;
+    }
+    if (!CanRunWide(leader)) {
+      cycles_[leader] = StepScalar(leader);
+      todo_[leader] = 0;
+      continue;
+    }
+
+    uint16_t pc = pc_[leader];
+    int begin = leader;
+    int n = lanes_ - begin;
+    MatchPC(&mask_[begin], &todo_[begin], &pc_[begin], pc, n);
+    uint8_t opcode = Fetch(leader, pc);
+    // Outside bank 0, lanes may have different banks or RAM at pc.
+    bool shared_code = pc + 3 <= ROM_BANK_0_SIZE;
+    int end = begin;
+    int count = 0;
+    for (int i = begin; i < lanes_; i++) {
+      if (!mask_[i]) {
+        continue;
+      }
+      if (i != leader && (!CanRunWide(i) || (!shared_code && Fetch(i, pc) != opcode))) {
+        mask_[i] = 0;
+        continue;
+      }
+      end = i + 1;
+      count++;
+    }
+
+    if (count > 1 && RunWide(opcode, pc, begin, end)) {
+      wide_steps_ += count;
+    } else {
+      for (int i = begin; i < end; i++) {
+        if (mask_[i]) {
+          cycles_[i] = StepScalar(i);
+        }
+      }
+    }
+    for (int i = begin; i < end; i++) {
+      todo_[i] &= ~mask_[i];
+    }
+  }
+}
+
+bool WideCPU::RunWide(uint8_t opcode, uint16_t pc, int begin, int end) {
+  int length = WideLength(opcode);
+  if (length == 0) {
+    return false;
+  }
+  int n = end - begin;
+  const uint8_t *mask = &mask_[begin];
+  uint8_t *r[8];
+  for (int i = 0; i < 8; i++) {
+    r[i] = &r8_[i][begin];
+  }
+  uint8_t *a = r[REGISTER_A];
+  uint8_t *f = r[REGISTER_F];
+  uint8_t *imm8 = &imm8_[begin];
+  uint16_t *imm16 = &imm16_[begin];
+  uint16_t *pc_out = &pc_[begin];
+  uint8_t *cycles = &cycles_[begin];
+
+  // Operands, read once when every lane has the same code.
+  if (length > 1) {
+    for (int i = 0; i < n; i++) {
+      if (!mask[i]) {
+        continue;
+      }
+      if (i > 0 && pc + 3 <= ROM_BANK_0_SIZE) {
+        imm8[i] = imm8[0];
+        imm16[i] = imm16[0];
+        continue;
+      }
+      imm8[i] = Fetch(begin + i, pc + 1);
+      imm16[i] = imm8[i] | (length == 3 ? Fetch(begin + i, pc + 2) << 8 : 0);
+    }
+  }
+
+  // Each lane's memory, one lane at a time, through its own router.
+  auto router = [this, begin](int i) { return emulators_[begin + i]->router(); };
+  auto hl = [&r](int i) { return (uint16_t)(r[REGISTER_H][i] << 8 | r[REGISTER_L][i]); };
+
+  uint16_t next = pc + length;
+  uint8_t row = opcode >> 4;
+  uint8_t column = opcode & 0xF;
+  uint8_t took = 4;
+
+  if (opcode >= 0x40 && opcode < 0x80) {
+    int to = (opcode >> 3) & 7;
+    int from = opcode & 7;
+    if (from == OPERAND_HL) {
+      for (int i = 0; i < n; i++) {
+        if (mask[i]) {
+          r[to][i] = router(i)->GetByteAt(hl(i));
+        }
+      }
+      took = 8;
+    } else if (to == OPERAND_HL) {
+      for (int i = 0; i < n; i++) {
+        if (mask[i]) {
+          router(i)->SetByteAt(hl(i), r[from][i]);
+        }
+      }
+      took = 8;
+    } else {
+      Move8(r[to], r[from], mask, n);
+    }
+  } else if ((opcode >= 0x80 && opcode < 0xC0) || (row >= 0xC && (column == 0x6 || column == 0xE))) {
+    // ALU A with a register, (HL) or an immediate.
+    int op = (opcode >> 3) & 7;
+    const uint8_t *operand;
+    if (opcode >= 0xC0) {
+      operand = imm8;
+      took = 8;
+    } else if ((opcode & 7) == OPERAND_HL) {
+      for (int i = 0; i < n; i++) {
+        if (mask[i]) {
+          imm8[i] = router(i)->GetByteAt(hl(i));
+        }
+      }
+      operand = imm8;
+      took = 8;
+    } else {
+      operand = r[opcode & 7];
+    }
+    switch (op) {
+      case 0:  // ADD
+      case 1:  // ADC
+        Add8(a, operand, f, op & 1, mask, n);
+        break;
+      case 2:  // SUB
+      case 3:  // SBC
+      case 7:  // CP
+        Sub8(a, operand, f, op == 3 ? 1 : 0, op == 7 ? 0x00 : 0xFF, mask, n);
+        break;
+      case 4:
+        And8(a, operand, f, mask, n);
+        break;
+      case 5:  // XOR
+      case 6:  // OR
+        Or8(a, operand, f, op == 5, mask, n);
+        break;
+    }
+  } else if (row < 4 && (column == 0x4 || column == 0x5 || column == 0xC || column == 0xD)) {
+    Step8(r[(opcode >> 3) & 7], f, (column & 1) == 0, mask, n);
+  } else if (row < 4 && (column == 0x6 || column == 0xE)) {
+    Move8(r[(opcode >> 3) & 7], imm8, mask, n);
+    took = 8;
+  } else if (row < 4 && (column == 0x1 || column == 0x3 || column == 0xB)) {
+    // LD rr,nn and 16 bit INC/DEC, of BC, DE, HL or SP.
+    uint16_t delta = column == 0x3 ? 1 : 0xFFFF;
+    if (row == 3) {
+      if (column == 0x1) {
+        Move16(&sp_[begin], imm16, mask, n);
+      } else {
+        StepSP(&sp_[begin], delta, mask, n);
+      }
+    } else if (column == 0x1) {
+      Split16(r[row * 2], r[row * 2 + 1], imm16, mask, n);
+    } else {
+      Step16(r[row * 2], r[row * 2 + 1], delta, mask, n);
+    }
+    took = column == 0x1 ? 12 : 8;
+  } else if (row < 4 && (column == 0x2 || column == 0xA)) {
+    // LD (BC),A, LD (DE),A, LD (HL+),A, LD (HL-),A and the reverse.
+    bool store = column == 0x2;
+    for (int i = 0; i < n; i++) {
+      if (!mask[i]) {
+        continue;
+      }
+      uint16_t address = row < 2 ? (r[row * 2][i] << 8 | r[row * 2 + 1][i]) : hl(i);
+      if (store) {
+        router(i)->SetByteAt(address, a[i]);
+      } else {
+        a[i] = router(i)->GetByteAt(address);
+      }
+      if (row >= 2) {
+        address += row == 2 ? 1 : -1;
+        r[REGISTER_H][i] = address >> 8;
+        r[REGISTER_L][i] = address & 0xFF;
+      }
+    }
+    took = 8;
+  } else if (opcode == 0xE0 || opcode == 0xF0 || opcode == 0xEA || opcode == 0xFA) {
+    // LDH and LD through an immediate address.
+    bool store = opcode == 0xE0 || opcode == 0xEA;
+    for (int i = 0; i < n; i++) {
+      if (!mask[i]) {
+        continue;
+      }
+      uint16_t address = length == 2 ? 0xFF00 + imm8[i] : imm16[i];
+      if (store) {
+        router(i)->SetByteAt(address, a[i]);
+      } else {
+        a[i] = router(i)->GetByteAt(address);
+      }
+    }
+    took = length == 2 ? 12 : 16;
+  } else if (opcode != 0x00) {
+    // Jumps. They set their own pc and cycles.
+    uint8_t flag = 0;
+    uint8_t expect = 0;
+    if (opcode != 0x18 && opcode != 0xC3) {
+      bool on_carry = row == 0x3 || row == 0xD;
+      flag = on_carry ? FLAG_C : FLAG_Z;
+      expect = (column == 0x8 || column == 0xA) ? flag : 0;
+    }
+    if (length == 2) {
+      for (int i = 0; i < n; i++) {
+        imm16[i] = next + (int8_t)imm8[i];
+      }
+      Branch(pc_out, cycles, f, imm16, next, flag, expect, 12, 8, mask, n);
+    } else {
+      Branch(pc_out, cycles, f, imm16, next, flag, expect, 16, 12, mask, n);
+    }
+    return true;
+  }
+
+  Finish(pc_out, cycles, next, took, mask, n);
+  return true;
+}
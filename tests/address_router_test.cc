@@ -6,6 +6,7 @@
 #include "ppu.h"
 #include "screen.h"
 #include "utils.h"
+#include "video_sink.h"
 
 class AddressRouterTest : public ::testing::Test {
  protected:
@@ -14,7 +15,7 @@ class AddressRouterTest : public ::testing::Test {
 };
 
 TEST(AddressRouterTest, PPU) {
-  PPU *ppu = new PPU(new Screen());
+  PPU *ppu = new PPU(new Screen(new HeadlessVideoSink()));
   MMU *mmu = getTestingMMU();
   AddressRouter *addressRouter =
       new AddressRouter(mmu, ppu, NULL, NULL, NULL, NULL, NULL);
@@ -28,7 +29,7 @@ TEST(AddressRouterTest, PPU) {
 }
 
 TEST(AddressRouterTest, MMU) {
-  PPU *ppu = new PPU(new Screen());
+  PPU *ppu = new PPU(new Screen(new HeadlessVideoSink()));
   MMU *mmu = getTestingMMU();
   AddressRouter *addressRouter =
       new AddressRouter(mmu, ppu, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,87 @@
+#include "audio_ring_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+class AudioRingBufferTest : public ::testing::Test {
+ protected:
+  AudioRingBufferTest(){};
+  ~AudioRingBufferTest(){};
+};
+
+TEST(AudioRingBufferTest, CapacityRoundsUpToPowerOfTwo) {
+  AudioRingBuffer ring(2200);
+  EXPECT_EQ(ring.capacity(), 4096);
+  EXPECT_EQ(ring.Available(), 0);
+}
+
+TEST(AudioRingBufferTest, ReadsBackWhatWasWrittenAcrossTheWrap) {
+  AudioRingBuffer ring(8);
+  int16_t in[6] = {1, 2, 3, 4, 5, 6};
+  int16_t out[6];
+  for (int pass = 0; pass < 3; pass++) {
+    ASSERT_EQ(ring.Write(in, 6), 6);
+    ASSERT_EQ(ring.Read(out, 6), 6);
+    for (int i = 0; i < 6; i++) {
+      EXPECT_EQ(out[i], in[i]);
+    }
+  }
+  EXPECT_EQ(ring.overruns(), 0u);
+  EXPECT_EQ(ring.underruns(), 0u);
+}
+
+TEST(AudioRingBufferTest, CountsOverrunsAndUnderruns) {
+  AudioRingBuffer ring(4);
+  int16_t in[6] = {1, 2, 3, 4, 5, 6};
+  EXPECT_EQ(ring.Write(in, 6), 4);
+  EXPECT_EQ(ring.overruns(), 1u);
+
+  int16_t out[6] = {-1, -1, -1, -1, -1, -1};
+  EXPECT_EQ(ring.Read(out, 6), 4);
+  EXPECT_EQ(ring.underruns(), 1u);
+  EXPECT_EQ(out[3], 4);
+  // Missing samples are silence.
+  EXPECT_EQ(out[4], 0);
+  EXPECT_EQ(out[5], 0);
+}
+
+TEST(AudioRingBufferTest, SamplesStayInOrderAcrossThreads) {
+  AudioRingBuffer ring(256);
+  const int TOTAL = 200000;
+  std::atomic<bool> in_order(true);
+
+  std::thread consumer([&] {
+    int16_t expected = 0;
+    int read = 0;
+    int16_t samples[37];
+    while (read < TOTAL) {
+      int count = ring.Read(samples, 37);
+      for (int i = 0; i < count; i++) {
+        if (samples[i] != expected) {
+          in_order = false;
+        }
+        expected++;
+      }
+      read += count;
+    }
+  });
+
+  int16_t next = 0;
+  int written = 0;
+  int16_t samples[8];
+  while (written < TOTAL) {
+    int count = std::min(8, TOTAL - written);
+    for (int i = 0; i < count; i++) {
+      samples[i] = next + i;
+    }
+    int wrote = ring.Write(samples, count);
+    next += wrote;
+    written += wrote;
+  }
+  consumer.join();
+
+  EXPECT_TRUE(in_order);
+}
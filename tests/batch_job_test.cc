@@ -0,0 +1,105 @@
+#include "batch_job.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "emulator.h"
+#include "gtest/gtest.h"
+#include "test_roms.h"
+
+class BatchJobTest : public ::testing::Test {
+ protected:
+  BatchJobTest(){};
+  ~BatchJobTest(){};
+};
+
+TEST(BatchJobTest, ReadManifest) {
+  std::istringstream manifest(
+      "# rom state input frames\n"
+      "\n"
+      "a.gb - - 60\n"
+      "  /roms/b.gb saves/b.state b.input 600\n");
+  std::vector<BatchJob> jobs;
+  std::string error;
+  ASSERT_TRUE(ReadManifest(manifest, "runs", jobs, error));
+  ASSERT_EQ(jobs.size(), 2u);
+  EXPECT_EQ(jobs[0].rom_path, "runs/a.gb");
+  EXPECT_EQ(jobs[0].state_path, "");
+  EXPECT_EQ(jobs[0].input_path, "");
+  EXPECT_EQ(jobs[0].frames, 60);
+  EXPECT_EQ(jobs[1].rom_path, "/roms/b.gb");
+  EXPECT_EQ(jobs[1].state_path, "runs/saves/b.state");
+  EXPECT_EQ(jobs[1].input_path, "runs/b.input");
+  EXPECT_EQ(jobs[1].frames, 600);
+
+  for (const char *bad : {"a.gb - 60\n", "a.gb - - sixty\n", "a.gb - - 60 extra\n", "- - - 60\n"}) {
+    std::istringstream bad_manifest(bad);
+    jobs.clear();
+    EXPECT_FALSE(ReadManifest(bad_manifest, "", jobs, error)) << bad;
+    EXPECT_NE(error.find("line 1"), std::string::npos);
+  }
+}
+
+TEST(BatchJobTest, ReadInputScript) {
+  std::istringstream script("# frame buttons\n0 0\n10 0x80\n10 16\n200 0x0\n");
+  std::vector<InputEvent> events;
+  std::string error;
+  ASSERT_TRUE(ReadInputScript(script, events, error));
+  ASSERT_EQ(events.size(), 4u);
+  EXPECT_EQ(events[1].frame, 10);
+  EXPECT_EQ(events[1].buttons, Button_Start);
+  EXPECT_EQ(events[2].buttons, Button_A);
+  EXPECT_EQ(events[3].frame, 200);
+
+  for (const char *bad : {"10\n", "10 0x100\n", "10 start\n", "10 0\n5 0\n", "-1 0\n"}) {
+    std::istringstream bad_script(bad);
+    events.clear();
+    EXPECT_FALSE(ReadInputScript(bad_script, events, error)) << bad;
+  }
+}
+
+TEST(BatchJobTest, RunBatchJobMatchesEmulatorAndResumes) {
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / "edge_batch_job_test";
+  std::filesystem::create_directories(dir);
+  std::vector<uint8_t> rom = SpinningROM();
+  std::ofstream((dir / "spin.gb").string(), std::ios::binary)
+      .write((const char *)rom.data(), rom.size());
+  std::ofstream((dir / "spin.input").string()) << "3 0x80\n5 0\n";
+
+  BatchJob job;
+  job.rom_path = (dir / "spin.gb").string();
+  job.input_path = (dir / "spin.input").string();
+  job.frames = 10;
+  BatchResult first = RunBatchJob(job, 1);
+  ASSERT_EQ(first.error, "");
+  EXPECT_EQ(first.serial_output, "k");
+  EXPECT_GT(first.seconds, 0);
+
+  EmulatorOptions options;
+  options.rtc_time = 1;
+  Emulator *reference = Emulator::Create(rom.data(), rom.size(), options);
+  reference->RunFrames(3);
+  reference->SetInput(Button_Start);
+  reference->RunFrames(2);
+  reference->SetInput(0);
+  reference->RunFrames(5);
+  EXPECT_EQ(first.frame_hash, reference->FrameHash());
+  EXPECT_EQ(first.snapshot, reference->Snapshot());
+
+  // Carry on from the first job's state.
+  std::ofstream((dir / "spin.state").string(), std::ios::binary)
+      .write((const char *)first.snapshot.data(), first.snapshot.size());
+  job.state_path = (dir / "spin.state").string();
+  job.input_path = "";
+  job.frames = 5;
+  BatchResult second = RunBatchJob(job, 1);
+  ASSERT_EQ(second.error, "");
+  reference->RunFrames(5);
+  EXPECT_EQ(second.snapshot, reference->Snapshot());
+  delete reference;
+
+  job.rom_path = (dir / "missing.gb").string();
+  EXPECT_NE(RunBatchJob(job, 1).error, "");
+  std::filesystem::remove_all(dir);
+}
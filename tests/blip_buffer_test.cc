@@ -0,0 +1,71 @@
+#include "blip_buffer.h"
+
+#include "constants.h"
+#include "gtest/gtest.h"
+
+class BlipBufferTest : public ::testing::Test {
+ protected:
+  BlipBufferTest(){};
+  ~BlipBufferTest(){};
+};
+
+TEST(BlipBufferTest, FrameProducesSamplesAtRate) {
+  BlipBuffer buffer(2048);
+  buffer.SetRates(CYCLES_PER_SECOND, 48000);
+  int16_t out[2 * 2048];
+  int total = 0;
+  for (int frame = 0; frame < 60; frame++) {
+    buffer.EndFrame(CYCLES_PER_FRAME);
+    total += buffer.ReadSamples(out, 2048);
+  }
+  double expected = 60.0 * CYCLES_PER_FRAME * 48000 / CYCLES_PER_SECOND;
+  EXPECT_NEAR(total, expected, 1);
+}
+
+TEST(BlipBufferTest, StepSettlesToDelta) {
+  BlipBuffer buffer(2048);
+  buffer.SetRates(CYCLES_PER_SECOND, DEFAULT_SAMPLE_RATE);
+  buffer.AddDelta(100, 1000);
+  buffer.EndFrame(4000);
+  int16_t out[2 * 64];
+  int samples = buffer.ReadSamples(out, 64);
+  ASSERT_GT(samples, 20);
+  // Before the step is silence. Once the kernel has passed it reaches the
+  // delta level, then slowly leaks back towards 0.
+  EXPECT_EQ(out[0], 0);
+  EXPECT_NEAR(out[2 * 20], 1000, 50);
+  EXPECT_LT(out[2 * (samples - 1)], out[2 * 20]);
+  EXPECT_GT(out[2 * (samples - 1)], 0);
+}
+
+TEST(BlipBufferTest, StereoInterleaved) {
+  BlipBuffer buffer(2048);
+  buffer.SetRates(CYCLES_PER_SECOND, DEFAULT_SAMPLE_RATE);
+  buffer.AddDelta(0, 500, -300);
+  buffer.EndFrame(4000);
+  int16_t out[2 * 32] = {};
+  int samples = buffer.ReadSamples(out, 32);
+  ASSERT_GT(samples, 20);
+  EXPECT_NEAR(out[2 * 20], 500, 25);
+  EXPECT_NEAR(out[2 * 20 + 1], -300, 15);
+}
+
+TEST(BlipBufferTest, OutputScalesBySide) {
+  BlipBuffer buffer(2048);
+  buffer.SetRates(CYCLES_PER_SECOND, DEFAULT_SAMPLE_RATE);
+  BlipOutput output;
+  output.SetLevels(8, 0);
+  output.Update(&buffer, 0, 800);
+  // Panning and volume changes take effect from the next update.
+  output.SetLevels(2, 4);
+  output.Update(&buffer, 2000, 800);
+  buffer.EndFrame(4000);
+  int16_t out[2 * 64] = {};
+  int samples = buffer.ReadSamples(out, 64);
+  ASSERT_GT(samples, 40);
+  EXPECT_NEAR(out[2 * 15], 800, 40);
+  EXPECT_EQ(out[2 * 15 + 1], 0);
+  // Less what has leaked away since.
+  EXPECT_NEAR(out[2 * (samples - 1)], 200, 50);
+  EXPECT_NEAR(out[2 * (samples - 1) + 1], 400, 40);
+}
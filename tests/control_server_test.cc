@@ -0,0 +1,163 @@
+#include "control_server.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "emulator.h"
+#include "gtest/gtest.h"
+#include "screen.h"
+#include "test_roms.h"
+
+class ControlServerTest : public ::testing::Test {
+ protected:
+  ControlServerTest(){};
+  ~ControlServerTest(){};
+};
+
+struct Response {
+  ControlHeader header;
+  std::vector<uint8_t> payload;
+};
+
+// A client talking to a server on the same thread.
+class TestClient {
+ public:
+  TestClient(const std::string &path, ControlServer *server) : server_(server) {
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    connected_ = connect(fd_, (struct sockaddr *)&address, sizeof(address)) == 0;
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+  }
+  ~TestClient() { close(fd_); }
+
+  bool connected() { return connected_; }
+
+  void Request(uint8_t op, const void *payload = nullptr, size_t size = 0) {
+    ControlHeader header = {op, 0, 0, (uint32_t)size};
+    const uint8_t *bytes = (const uint8_t *)&header;
+    pending_.insert(pending_.end(), bytes, bytes + sizeof(header));
+    bytes = (const uint8_t *)payload;
+    pending_.insert(pending_.end(), bytes, bytes + size);
+  }
+
+  // Sends every request made so far at once, and collects count responses.
+  std::vector<Response> Send(int count) {
+    EXPECT_EQ(send(fd_, pending_.data(), pending_.size(), 0), (ssize_t)pending_.size());
+    pending_.clear();
+    std::vector<Response> responses;
+    for (int polls = 0; (int)responses.size() < count && polls < 1000; polls++) {
+      server_->Poll(10);
+      uint8_t buffer[65536];
+      ssize_t read;
+      while ((read = recv(fd_, buffer, sizeof(buffer), 0)) > 0) {
+        in_.insert(in_.end(), buffer, buffer + read);
+      }
+      while (in_.size() >= sizeof(ControlHeader)) {
+        Response response;
+        memcpy(&response.header, in_.data(), sizeof(ControlHeader));
+        if (in_.size() < sizeof(ControlHeader) + response.header.length) {
+          break;
+        }
+        response.payload.assign(in_.begin() + sizeof(ControlHeader),
+                                in_.begin() + sizeof(ControlHeader) + response.header.length);
+        in_.erase(in_.begin(), in_.begin() + sizeof(ControlHeader) + response.header.length);
+        responses.push_back(response);
+      }
+    }
+    return responses;
+  }
+
+ private:
+  ControlServer *server_;
+  int fd_;
+  bool connected_ = false;
+  std::vector<uint8_t> pending_;
+  std::vector<uint8_t> in_;
+};
+
+static std::string SocketPath() { return "/tmp/edge_control_test_" + std::to_string(getpid()); }
+
+static uint64_t StepHash(const Response &response) {
+  uint64_t result[2];
+  memcpy(result, response.payload.data(), sizeof(result));
+  return result[1];
+}
+
+TEST(ControlServerTest, PipelinedRequests) {
+  std::vector<uint8_t> rom = ButtonROM();
+  EmulatorOptions options;
+  options.audio_buffer_ms = 0;
+  Emulator *emulator = Emulator::Create(rom.data(), rom.size(), options);
+  Emulator *reference = Emulator::Create(rom.data(), rom.size(), options);
+  ControlServer *server = ControlServer::Create(SocketPath(), emulator);
+  ASSERT_NE(server, nullptr);
+  TestClient client(SocketPath(), server);
+  ASSERT_TRUE(client.connected());
+
+  uint8_t buttons = Button_A | Button_Start;
+  uint32_t frames = 5;
+  uint16_t read[2] = {0xC000, 1};
+  uint16_t io[2] = {0xFF00, 4};
+  uint32_t more_frames = 3;
+  client.Request(ControlOp_SetInput, &buttons, 1);
+  client.Request(ControlOp_Step, &frames, sizeof(frames));
+  client.Request(ControlOp_Snapshot);
+  client.Request(ControlOp_ReadMemory, read, sizeof(read));
+  client.Request(ControlOp_ReadMemory, io, sizeof(io));
+  client.Request(ControlOp_Framebuffer);
+  client.Request(ControlOp_Step, &more_frames, sizeof(more_frames));
+  client.Request(99);
+  client.Request(ControlOp_Step, &buttons, 1);
+  std::vector<Response> responses = client.Send(9);
+  ASSERT_EQ(responses.size(), 9u);
+  EXPECT_EQ(server->connections(), 1);
+
+  reference->SetInput(buttons);
+  reference->RunFrames(5);
+  for (int i = 0; i < 7; i++) {
+    EXPECT_EQ(responses[i].header.status, ControlStatus_OK) << i;
+  }
+  EXPECT_EQ(responses[0].payload.size(), 0u);
+  ASSERT_EQ(responses[1].payload.size(), 16u);
+  EXPECT_EQ(StepHash(responses[1]), reference->FrameHash());
+  std::vector<uint8_t> snapshot = responses[2].payload;
+  EXPECT_EQ(snapshot, reference->Snapshot());
+  // P1 reads back 0 for the held A and Start.
+  ASSERT_EQ(responses[3].payload.size(), 1u);
+  EXPECT_EQ(responses[3].payload[0] & 0xF, 0x6);
+  // IO registers aren't read from outside.
+  EXPECT_EQ(responses[4].payload, std::vector<uint8_t>(4, 0xFF));
+  ASSERT_EQ(responses[5].payload.size(), SCREEN_PIXELS * sizeof(uint32_t));
+  EXPECT_EQ(memcmp(responses[5].payload.data(), reference->framebuffer(), responses[5].payload.size()), 0);
+  reference->RunFrames(3);
+  uint64_t expected = reference->FrameHash();
+  EXPECT_EQ(StepHash(responses[6]), expected);
+  EXPECT_EQ(responses[7].header.op, 99);
+  EXPECT_EQ(responses[7].header.status, ControlStatus_UnknownOp);
+  EXPECT_EQ(responses[8].header.status, ControlStatus_BadPayload);
+
+  // Back to the snapshot, then the same frames again.
+  uint32_t none = 0;
+  client.Request(ControlOp_Restore, snapshot.data(), snapshot.size());
+  client.Request(ControlOp_Step, &more_frames, sizeof(more_frames));
+  client.Request(ControlOp_Restore, snapshot.data(), 10);
+  client.Request(ControlOp_Step, &none, sizeof(none));
+  responses = client.Send(4);
+  ASSERT_EQ(responses.size(), 4u);
+  EXPECT_EQ(responses[0].header.status, ControlStatus_OK);
+  EXPECT_EQ(StepHash(responses[1]), expected);
+  EXPECT_EQ(responses[2].header.status, ControlStatus_RestoreFailed);
+  EXPECT_EQ(StepHash(responses[3]), expected);
+
+  delete server;
+  EXPECT_NE(access(SocketPath().c_str(), F_OK), 0);
+  delete emulator;
+  delete reference;
+}
@@ -0,0 +1,400 @@
+#include "emulator.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "cpu.h"
+#include "edge.h"
+#include "gtest/gtest.h"
+#include "interrupt_controller.h"
+#include "ppu.h"
+#include "screen.h"
+#include "serial_controller.h"
+#include "test_roms.h"
+
+class EmulatorTest : public ::testing::Test {
+ protected:
+  EmulatorTest(){};
+  ~EmulatorTest(){};
+};
+
+uint64_t FrameHash(const uint32_t *pixels) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < SCREEN_PIXELS; i++) {
+    hash = (hash ^ pixels[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+TEST(EmulatorTest, CreateRejectsBadROM) {
+  std::vector<uint8_t> rom = CountingROM();
+  EXPECT_EQ(Emulator::Create(rom.data(), 0x100), nullptr);
+  // Header says 64k.
+  rom[0x148] = 0x01;
+  EXPECT_EQ(Emulator::Create(rom.data(), rom.size()), nullptr);
+}
+
+// Turns on the LCD, then keeps writing to unusable memory at 0xFEA0.
+std::vector<uint8_t> ForbiddenWriteROM() {
+  return AssembleROM({
+      0x3E, 0x91,        // ld a, 0x91
+      0xE0, 0x40,        // ldh (LCDC), a
+      0xEA, 0xA0, 0xFE,  // loop: ld (0xFEA0), a
+      0x18, 0xFB,        // jr loop
+  });
+}
+
+TEST(EmulatorTest, LogsToCallbackOnly) {
+  std::vector<uint8_t> rom = ForbiddenWriteROM();
+  std::vector<std::string> lines;
+  EmulatorOptions options;
+  options.log = [&lines](const std::string &line) { lines.push_back(line); };
+  testing::internal::CaptureStdout();
+  Emulator *logged = Emulator::Create(rom.data(), rom.size(), options);
+  logged->RunFrames(1);
+  Emulator *quiet = Emulator::Create(rom.data(), rom.size());
+  quiet->RunFrames(1);
+  EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+
+  ASSERT_FALSE(lines.empty());
+  EXPECT_EQ(lines[0], "FORBIDDEN RAM: Empty i/o[0xfea0] = 0x91 (SET)");
+  // Forks log to the same place.
+  size_t count = lines.size();
+  Emulator *fork = logged->Fork();
+  fork->RunFrames(1);
+  EXPECT_GT(lines.size(), count);
+  delete fork;
+  delete logged;
+  delete quiet;
+}
+
+TEST(EmulatorTest, InstancesAreIndependent) {
+  std::vector<uint8_t> rom = CountingROM();
+  Emulator *a = Emulator::Create(rom.data(), rom.size());
+  Emulator *b = Emulator::Create(rom.data(), rom.size());
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+
+  a->RunFrames(10);
+  b->RunFrames(20);
+  EXPECT_NE(FrameHash(a->framebuffer()), FrameHash(b->framebuffer()));
+
+  a->RunFrames(10);
+  EXPECT_EQ(a->frame_count(), 20);
+  EXPECT_EQ(FrameHash(a->framebuffer()), FrameHash(b->framebuffer()));
+  EXPECT_EQ(a->serial_output(), "o");
+  EXPECT_EQ(b->serial_output(), "o");
+  delete a;
+  delete b;
+}
+
+TEST(EmulatorTest, InstancesOnThreadsMatch) {
+  std::vector<uint8_t> rom = CountingROM();
+  Emulator *reference = Emulator::Create(rom.data(), rom.size());
+  reference->RunFrames(30);
+  uint64_t expected = FrameHash(reference->framebuffer());
+  delete reference;
+
+  const int THREADS = 8;
+  std::vector<uint64_t> hashes(THREADS);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < THREADS; i++) {
+    threads.emplace_back([&rom, &hashes, i] {
+      Emulator *emulator = Emulator::Create(rom.data(), rom.size());
+      emulator->RunFrames(30);
+      hashes[i] = FrameHash(emulator->framebuffer());
+      delete emulator;
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i < THREADS; i++) {
+    EXPECT_EQ(hashes[i], expected);
+  }
+}
+
+TEST(EmulatorTest, SnapshotRestore) {
+  std::vector<uint8_t> rom = CountingROM();
+  Emulator *a = Emulator::Create(rom.data(), rom.size());
+  a->RunFrames(10);
+  std::vector<uint8_t> snapshot = a->Snapshot();
+  a->RunFrames(10);
+  uint64_t expected = FrameHash(a->framebuffer());
+
+  // Into the same instance, and into a fresh one.
+  ASSERT_TRUE(a->Restore(snapshot.data(), snapshot.size()));
+  a->RunFrames(10);
+  EXPECT_EQ(FrameHash(a->framebuffer()), expected);
+
+  Emulator *b = Emulator::Create(rom.data(), rom.size());
+  ASSERT_TRUE(b->Restore(snapshot.data(), snapshot.size()));
+  b->RunFrames(10);
+  EXPECT_EQ(FrameHash(b->framebuffer()), expected);
+  EXPECT_EQ(b->Snapshot(), a->Snapshot());
+
+  EXPECT_FALSE(b->Restore(snapshot.data(), snapshot.size() - 1));
+  std::vector<uint8_t> garbage(snapshot.size(), 0xAB);
+  EXPECT_FALSE(b->Restore(garbage.data(), garbage.size()));
+  delete a;
+  delete b;
+}
+
+TEST(EmulatorTest, SnapshotRejectsOtherROM) {
+  std::vector<uint8_t> rom = CountingROM();
+  Emulator *a = Emulator::Create(rom.data(), rom.size());
+  a->RunFrames(10);
+  std::vector<uint8_t> snapshot = a->Snapshot();
+
+  // Same header and RAM size, different code.
+  std::vector<uint8_t> other_rom = LoopROM();
+  Emulator *b = Emulator::Create(other_rom.data(), other_rom.size());
+  b->RunFrames(5);
+  std::vector<uint8_t> before = b->Snapshot();
+  EXPECT_FALSE(b->Restore(snapshot.data(), snapshot.size()));
+  EXPECT_EQ(b->Snapshot(), before);
+
+  // A fork hashes the same ROM.
+  Emulator *fork = a->Fork();
+  EXPECT_TRUE(fork->Restore(snapshot.data(), snapshot.size()));
+  delete fork;
+  delete a;
+  delete b;
+}
+
+TEST(EmulatorTest, SnapshotKeepsSerialTransfer) {
+  std::vector<uint8_t> rom = TransferROM(true);
+  Emulator *a = Emulator::Create(rom.data(), rom.size());
+  a->RunFrames(3);
+  // Partway through a byte.
+  ASSERT_TRUE(a->serial_controller()->clocking());
+  std::vector<uint8_t> snapshot = a->Snapshot();
+
+  Emulator *b = Emulator::Create(rom.data(), rom.size());
+  ASSERT_TRUE(b->Restore(snapshot.data(), snapshot.size()));
+  EXPECT_EQ(b->cycles(), a->cycles());
+  EXPECT_EQ(b->serial_controller()->sc(), a->serial_controller()->sc());
+  EXPECT_EQ(b->serial_controller()->transfer_end(), a->serial_controller()->transfer_end());
+  a->RunFrames(3);
+  b->RunFrames(3);
+  EXPECT_EQ(b->cycles(), a->cycles());
+  EXPECT_EQ(b->Snapshot(), a->Snapshot());
+  delete a;
+  delete b;
+}
+
+TEST(EmulatorTest, ForkMatchesOriginal) {
+  std::vector<uint8_t> rom = CountingROM();
+  Emulator *a = Emulator::Create(rom.data(), rom.size());
+  a->RunFrames(10);
+  // Forks start with no audio buffered.
+  int16_t a_audio[2 * 4096], b_audio[2 * 4096];
+  while (a->ReadAudio(a_audio, 4096) > 0) {
+  }
+  Emulator *b = a->Fork();
+  ASSERT_NE(b, nullptr);
+  EXPECT_EQ(b->Snapshot(), a->Snapshot());
+  EXPECT_EQ(b->frame_count(), 10);
+  EXPECT_EQ(b->serial_output(), "o");
+
+  for (int frame = 0; frame < 10; frame++) {
+    a->SetInput(frame);
+    b->SetInput(frame);
+    a->RunFrame();
+    b->RunFrame();
+    ASSERT_EQ(FrameHash(b->framebuffer()), FrameHash(a->framebuffer())) << frame;
+  }
+  EXPECT_EQ(b->Snapshot(), a->Snapshot());
+  int samples = a->ReadAudio(a_audio, 4096);
+  EXPECT_GT(samples, 0);
+  ASSERT_EQ(b->ReadAudio(b_audio, 4096), samples);
+  EXPECT_TRUE(std::equal(a_audio, a_audio + 2 * samples, b_audio));
+
+  // Forks carry on alone, and can fork in turn.
+  Emulator *c = b->Fork();
+  a->RunFrames(3);
+  c->RunFrames(5);
+  EXPECT_NE(FrameHash(c->framebuffer()), FrameHash(a->framebuffer()));
+  a->RunFrames(2);
+  EXPECT_EQ(FrameHash(c->framebuffer()), FrameHash(a->framebuffer()));
+  delete a;
+  delete b;
+  b = c->Fork();
+  delete c;
+  b->RunFrame();
+  EXPECT_EQ(b->frame_count(), 26);
+  delete b;
+}
+
+TEST(EmulatorTest, ForkKeepsFramebuffer) {
+  std::vector<uint8_t> rom = CountingROM();
+  Emulator *a = Emulator::Create(rom.data(), rom.size());
+  Emulator *blank = a->Fork();
+  a->RunFrames(3);
+  Emulator *b = a->Fork();
+  EXPECT_EQ(FrameHash(b->framebuffer()), FrameHash(a->framebuffer()));
+  EXPECT_NE(FrameHash(blank->framebuffer()), FrameHash(a->framebuffer()));
+
+  // Also when catching up with a.
+  blank->ForkFrom(*a);
+  EXPECT_EQ(FrameHash(blank->framebuffer()), FrameHash(a->framebuffer()));
+  a->RunFrame();
+  b->RunFrame();
+  EXPECT_EQ(FrameHash(b->framebuffer()), FrameHash(a->framebuffer()));
+  delete blank;
+  delete b;
+  delete a;
+}
+
+// Turns on the LCD with HBlank, OAM and LYC STAT interrupts, whose handler
+// writes LY and DIV around the first 256 bytes of tile data, so the
+// background changes every frame. Then runs through nops to a jump back, so
+// nearly every instruction takes one machine cycle.
+std::vector<uint8_t> StatInterruptROM() {
+  std::vector<uint8_t> rom = AssembleROM(
+      {
+          0x3E, 0x91,        // ld a, 0x91
+          0xE0, 0x40,        // ldh (LCDC), a
+          0x3E, 0x68,        // ld a, 0x68
+          0xE0, 0x41,        // ldh (STAT), a
+          0x3E, 0x40,        // ld a, 64
+          0xE0, 0x45,        // ldh (LYC), a
+          0x3E, 0x03,        // ld a, 0x03
+          0xE0, 0xFF,        // ldh (IE), a, VBlank and STAT
+          0x21, 0x00, 0x80,  // ld hl, 0x8000
+          0xFB,              // ei
+      },
+      {
+          0xD9,                                     // VBlank: reti
+          0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // to 0x48
+          0xF5,                                     // STAT: push af
+          0xF0, 0x44,                               // ldh a, (LY)
+          0x77,                                     // ld (hl), a
+          0x2C,                                     // inc l
+          0xF0, 0x04,                               // ldh a, (DIV)
+          0x77,                                     // ld (hl), a
+          0x2C,                                     // inc l
+          0xF1,                                     // pop af
+          0xD9,                                     // reti
+      });
+  const uint8_t jump[] = {0xC3, 0x64, 0x01};  // jp 0x164, the first nop
+  std::copy(jump, jump + sizeof(jump), rom.end() - sizeof(jump));
+  return rom;
+}
+
+// Runs frames an instruction at a time, noting the cycle count, STAT, LY and
+// pending interrupts after each, and the frame hash after each frame.
+void TraceFrames(Emulator *emulator, int frames, std::vector<uint64_t> &trace,
+                 std::vector<uint64_t> &frame_hashes) {
+  for (int frame = 0; frame < frames; frame++) {
+    bool vblank = false;
+    while (!vblank) {
+      vblank = emulator->AdvanceDevices(emulator->cpu()->Step());
+      trace.push_back((uint64_t)emulator->cycles() << 24 |
+                      emulator->ppu()->GetByteAt(0xFF41) << 16 |
+                      emulator->ppu()->GetByteAt(0xFF44) << 8 |
+                      emulator->interrupt_controller()->interrupt_request());
+    }
+    emulator->EndFrame();
+    frame_hashes.push_back(emulator->FrameHash());
+  }
+}
+
+TEST(EmulatorTest, FrameSkipOnlyChangesPixels) {
+  const int FRAMES = 12;
+  std::vector<uint8_t> rom = StatInterruptROM();
+  Emulator *reference = Emulator::Create(rom.data(), rom.size());
+  std::vector<uint64_t> expected_trace, expected_hashes;
+  TraceFrames(reference, FRAMES, expected_trace, expected_hashes);
+
+  for (int frame_skip : {1, 2, 5}) {
+    Emulator *skipping = Emulator::Create(rom.data(), rom.size());
+    skipping->ppu()->SetFrameSkip(frame_skip);
+    std::vector<uint64_t> trace, hashes;
+    TraceFrames(skipping, FRAMES, trace, hashes);
+
+    ASSERT_EQ(trace.size(), expected_trace.size()) << frame_skip;
+    for (size_t i = 0; i < trace.size(); i++) {
+      ASSERT_EQ(trace[i], expected_trace[i]) << frame_skip << " step " << i;
+    }
+    EXPECT_EQ(skipping->cycles(), reference->cycles());
+    EXPECT_EQ(skipping->Snapshot(), reference->Snapshot()) << frame_skip;
+    // Drawn frames match, skipped ones keep the last drawn.
+    for (int frame = 0; frame < FRAMES; frame++) {
+      if (frame % (frame_skip + 1) == 0) {
+        EXPECT_EQ(hashes[frame], expected_hashes[frame]) << frame_skip << " frame " << frame;
+      } else {
+        EXPECT_EQ(hashes[frame], hashes[frame - 1]) << frame_skip << " frame " << frame;
+        EXPECT_NE(hashes[frame], expected_hashes[frame]) << frame_skip << " frame " << frame;
+      }
+    }
+    delete skipping;
+  }
+  delete reference;
+}
+
+TEST(EmulatorTest, ForkFromRunsAhead) {
+  std::vector<uint8_t> rom = CountingROM();
+  Emulator *a = Emulator::Create(rom.data(), rom.size());
+  a->RunFrames(3);
+  Emulator *ahead = a->Fork();
+  a->ppu()->SetFrameSkip(1000);
+
+  // Like run-ahead: each frame, catch up with a and run a few frames further,
+  // drawing only the last.
+  for (int frame = 0; frame < 6; frame++) {
+    a->SetInput(frame);
+    a->RunFrame();
+    int frames = 1 + frame % 3;
+    ahead->ForkFrom(*a);
+    ahead->ppu()->SkipNextFrames(frames - 1);
+    ahead->RunFrames(frames);
+
+    // Draws every frame from the next on.
+    Emulator *check = a->Fork();
+    check->ppu()->SetFrameSkip(0);
+    check->ppu()->SkipNextFrames(0);
+    check->RunFrames(frames);
+    ASSERT_EQ(FrameHash(ahead->framebuffer()), FrameHash(check->framebuffer())) << frame;
+    EXPECT_EQ(ahead->Snapshot(), check->Snapshot());
+    EXPECT_EQ(ahead->frame_count(), a->frame_count() + frames);
+    delete check;
+  }
+  delete ahead;
+  delete a;
+}
+
+TEST(EmulatorTest, CInterface) {
+  std::vector<uint8_t> rom = CountingROM();
+  edge_options options;
+  edge_default_options(&options);
+  options.sample_rate = 44100;
+  edge_emulator *emulator = edge_create(rom.data(), rom.size(), &options);
+  ASSERT_NE(emulator, nullptr);
+
+  edge_set_input(emulator, EDGE_BUTTON_A | EDGE_BUTTON_START);
+  // Drain the first frame so the next read covers whole frames only.
+  std::vector<int16_t> audio(2 * 8192);
+  edge_run_frames(emulator, 1);
+  edge_audio(emulator, audio.data(), 8192);
+  edge_run_frames(emulator, 5);
+  EXPECT_EQ(edge_frame_count(emulator), 6);
+  EXPECT_STREQ(edge_serial_output(emulator), "o");
+  EXPECT_NE(edge_framebuffer(emulator), nullptr);
+
+  // About 5 frames of audio at 44.1 kHz.
+  int samples = edge_audio(emulator, audio.data(), 8192);
+  EXPECT_NEAR(samples, 5.0 * 44100 * CYCLES_PER_FRAME / CYCLES_PER_SECOND, 2);
+  EXPECT_EQ(edge_audio(emulator, audio.data(), 8192), 0);
+
+  size_t size = edge_snapshot(emulator, nullptr, 0);
+  std::vector<uint8_t> snapshot(size);
+  EXPECT_EQ(edge_snapshot(emulator, snapshot.data(), size), size);
+  edge_run_frames(emulator, 5);
+  uint64_t expected = FrameHash(edge_framebuffer(emulator));
+  EXPECT_EQ(edge_restore(emulator, snapshot.data(), size), 1);
+  edge_run_frames(emulator, 5);
+  EXPECT_EQ(FrameHash(edge_framebuffer(emulator)), expected);
+  edge_destroy(emulator);
+}
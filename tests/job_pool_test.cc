@@ -0,0 +1,72 @@
+#include "job_pool.h"
+
+#include <atomic>
+#include <chrono>
+
+#include "gtest/gtest.h"
+
+class JobPoolTest : public ::testing::Test {
+ protected:
+  JobPoolTest(){};
+  ~JobPoolTest(){};
+};
+
+TEST(JobPoolTest, RunsEveryJobOnce) {
+  JobPool pool(4);
+  EXPECT_EQ(pool.thread_count(), 4);
+  std::vector<std::atomic<int>> runs(1000);
+  for (size_t i = 0; i < runs.size(); i++) {
+    pool.Submit([&runs, i] { runs[i]++; });
+  }
+  pool.Wait();
+  for (size_t i = 0; i < runs.size(); i++) {
+    EXPECT_EQ(runs[i], 1);
+  }
+}
+
+TEST(JobPoolTest, IdleThreadsStealSlowThreadsJobs) {
+  JobPool pool(2);
+  std::atomic<int> done(0);
+  std::atomic<int> on_other_thread(0);
+  std::thread::id slow_thread;
+  std::atomic<bool> slow_started(false);
+  // Blocks its thread until every other job is done, which only happens if
+  // the other thread steals the share queued behind it.
+  pool.Submit([&] {
+    slow_thread = std::this_thread::get_id();
+    slow_started = true;
+    while (done < 9) {
+      std::this_thread::yield();
+    }
+  });
+  while (!slow_started) {
+    std::this_thread::yield();
+  }
+  for (int i = 0; i < 9; i++) {
+    pool.Submit([&] {
+      if (std::this_thread::get_id() != slow_thread) {
+        on_other_thread++;
+      }
+      done++;
+    });
+  }
+  pool.Wait();
+  EXPECT_EQ(done, 9);
+  EXPECT_EQ(on_other_thread, 9);
+}
+
+TEST(JobPoolTest, WaitsAgainAfterMoreJobs) {
+  JobPool pool;
+  EXPECT_GE(pool.thread_count(), 1);
+  std::atomic<int> count(0);
+  for (int round = 1; round <= 3; round++) {
+    for (int i = 0; i < 10; i++) {
+      pool.Submit([&count] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        count++;
+      });
+    }
+    pool.Wait();
+    EXPECT_EQ(count, round * 10);
+  }
+}
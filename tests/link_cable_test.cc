@@ -0,0 +1,140 @@
+#include "link_cable.h"
+
+#include <vector>
+
+#include "emulator.h"
+#include "gtest/gtest.h"
+#include "interrupt_controller.h"
+#include "mmu.h"
+#include "paged_memory.h"
+#include "serial_controller.h"
+#include "test_roms.h"
+
+uint8_t Received(Emulator *emulator, int index) {
+  return emulator->mmu()->work_ram().Get(index);
+}
+
+// Links a and b and runs them an instruction at a time, whichever is behind,
+// completing each transfer as soon as both are past its end, until they reach
+// the given cycles. Slow, but plainly exact, for checking LinkCable against.
+void RunLockstep(Emulator *a, Emulator *b, int64_t a_cycles, int64_t b_cycles) {
+  Emulator *emulators[2] = {a, b};
+  a->serial_controller()->set_linked(true);
+  b->serial_controller()->set_linked(true);
+  while (a->cycles() < a_cycles || b->cycles() < b_cycles) {
+    bool a_next = b->cycles() >= b_cycles || (a->cycles() < a_cycles && a->cycles() <= b->cycles());
+    Emulator *next = a_next ? a : b;
+    next->RunUntil(next->cycles() + 1);
+    for (int i = 0; i < 2; i++) {
+      SerialController *port = emulators[i]->serial_controller();
+      SerialController *other_port = emulators[1 - i]->serial_controller();
+      int64_t end = port->transfer_end();
+      if (!port->clocking() || a->cycles() < end || b->cycles() < end) {
+        continue;
+      }
+      bool listened = other_port->listening() && other_port->listening_since() <= end;
+      uint8_t sent = port->sb();
+      port->CompleteTransfer(listened ? other_port->sb() : 0xFF);
+      if (listened) {
+        other_port->CompleteTransfer(sent);
+      }
+    }
+  }
+}
+
+// Runs the ROMs linked for frames frames with a LinkCable, and again in
+// lockstep, and checks both end up the same.
+void ExpectLockstep(const std::vector<uint8_t> &a_rom, const std::vector<uint8_t> &b_rom, int frames) {
+  Emulator *a = Emulator::Create(a_rom.data(), a_rom.size());
+  Emulator *b = Emulator::Create(b_rom.data(), b_rom.size());
+  LinkCable *cable = new LinkCable(a, b);
+  Emulator *lockstep_a = Emulator::Create(a_rom.data(), a_rom.size());
+  Emulator *lockstep_b = Emulator::Create(b_rom.data(), b_rom.size());
+  for (int frame = 0; frame < frames; frame++) {
+    cable->RunFrame();
+    RunLockstep(lockstep_a, lockstep_b, a->cycles(), b->cycles());
+    ASSERT_EQ(lockstep_a->cycles(), a->cycles()) << frame;
+    ASSERT_EQ(lockstep_b->cycles(), b->cycles()) << frame;
+    ASSERT_EQ(lockstep_a->Snapshot(), a->Snapshot()) << frame;
+    ASSERT_EQ(lockstep_b->Snapshot(), b->Snapshot()) << frame;
+  }
+  delete cable;
+  delete a;
+  delete b;
+  delete lockstep_a;
+  delete lockstep_b;
+}
+
+TEST(LinkCableTest, TransfersBothWays) {
+  std::vector<uint8_t> clocking_rom = TransferROM(true);
+  std::vector<uint8_t> listening_rom = TransferROM(false);
+  Emulator *a = Emulator::Create(clocking_rom.data(), clocking_rom.size());
+  Emulator *b = Emulator::Create(listening_rom.data(), listening_rom.size());
+  LinkCable *cable = new LinkCable(a, b);
+
+  // 256 bytes at 4096 cycles each take over 14 frames.
+  cable->RunFrames(14);
+  EXPECT_EQ(Received(b, 255), 0);
+  cable->RunFrames(4);
+  for (int i = 0; i < 256; i++) {
+    ASSERT_EQ(Received(a, i), (uint8_t)~i) << i;
+    ASSERT_EQ(Received(b, i), i) << i;
+  }
+  EXPECT_EQ(cable->transfers(), 256);
+  EXPECT_GE(b->cycles(), a->cycles());
+  // Each end asked for the completion interrupt.
+  EXPECT_TRUE(a->interrupt_controller()->interrupt_request() & Interrupt_SerialTransferCompletion);
+  EXPECT_TRUE(b->interrupt_controller()->interrupt_request() & Interrupt_SerialTransferCompletion);
+
+  // Once it's over they run a frame at a time again.
+  int64_t runs = cable->runs();
+  cable->RunFrames(10);
+  EXPECT_LE(cable->runs() - runs, 30);
+  delete cable;
+  delete a;
+  delete b;
+}
+
+TEST(LinkCableTest, NothingConnected) {
+  // Transfers on the internal clock still complete, receiving 0xFF.
+  std::vector<uint8_t> clocking_rom = TransferROM(true);
+  Emulator *a = Emulator::Create(clocking_rom.data(), clocking_rom.size());
+  a->RunFrames(18);
+  for (int i = 0; i < 256; i++) {
+    ASSERT_EQ(Received(a, i), 0xFF) << i;
+  }
+  EXPECT_EQ(a->serial_output().size(), 256u);
+
+  // On the external clock, nothing ever comes.
+  std::vector<uint8_t> listening_rom = TransferROM(false);
+  Emulator *b = Emulator::Create(listening_rom.data(), listening_rom.size());
+  b->RunFrames(16);
+  EXPECT_EQ(b->serial_controller()->sc(), 0xFE);
+  EXPECT_FALSE(b->interrupt_controller()->interrupt_request() & Interrupt_SerialTransferCompletion);
+  EXPECT_EQ(Received(b, 0), 0);
+  delete a;
+  delete b;
+}
+
+TEST(LinkCableTest, ListenerJoinsLate) {
+  std::vector<uint8_t> clocking_rom = TransferROM(true);
+  // Starts listening after the first byte has gone, partway through the second.
+  std::vector<uint8_t> listening_rom = LateListenerROM(200);
+  Emulator *a = Emulator::Create(clocking_rom.data(), clocking_rom.size());
+  Emulator *b = Emulator::Create(listening_rom.data(), listening_rom.size());
+  LinkCable *cable = new LinkCable(a, b);
+  cable->RunFrames(2);
+  EXPECT_EQ(Received(a, 0), 0xFF);
+  EXPECT_EQ(Received(a, 1), 0x5A);
+  EXPECT_EQ(Received(a, 2), 0xFF);
+  EXPECT_EQ(Received(b, 0), 1);
+  delete cable;
+  delete a;
+  delete b;
+}
+
+TEST(LinkCableTest, MatchesLockstep) {
+  ExpectLockstep(TransferROM(true), TransferROM(false), 18);
+  ExpectLockstep(TransferROM(true), LateListenerROM(200), 4);
+  ExpectLockstep(TransferROM(false), TransferROM(true), 18);
+}
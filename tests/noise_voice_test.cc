@@ -2,6 +2,7 @@
 
 #include <cmath>
 
+#include "blip_buffer.h"
 #include "gtest/gtest.h"
 
 class NoiseVoiceTest : public ::testing::Test {
@@ -14,3 +15,24 @@ TEST(NoiseVoiceTest, LFSRStartsZero) {
   NoiseVoice *nv = new NoiseVoice();
   ASSERT_EQ(nv->LFSR(), 0x0000);
 }
+
+TEST(NoiseVoiceTest, RunStepsLFSRAtItsRate) {
+  NoiseVoice voice;
+  BlipBuffer buffer(1024);
+  buffer.SetRates(CYCLES_PER_SECOND, DEFAULT_SAMPLE_RATE);
+  voice.SetFF21(0xF0);
+  voice.SetFF22(0x00);  // Divider 0, shift 0: every 8 cycles.
+  voice.SetFF23(0x80);
+
+  NoiseVoice reference;
+  reference.SetFF21(0xF0);
+  reference.SetFF22(0x00);
+  reference.SetFF23(0x80);
+  // The first step comes a full period after the trigger.
+  for (int i = 0; i < 8192 / 8 - 1; i++) {
+    reference.TickLFSR();
+  }
+
+  voice.Run(0, 8192, &buffer);
+  EXPECT_EQ(voice.LFSR(), reference.LFSR());
+}
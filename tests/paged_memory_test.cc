@@ -0,0 +1,68 @@
+#include "paged_memory.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+class PagedMemoryTest : public ::testing::Test {
+ protected:
+  PagedMemoryTest(){};
+  ~PagedMemoryTest(){};
+};
+
+TEST(PagedMemoryTest, StartsZeroedWithoutPages) {
+  PagedMemory memory(0x2000);
+  EXPECT_EQ(memory.size(), 0x2000u);
+  EXPECT_EQ(memory.Get(0), 0);
+  EXPECT_EQ(memory.Get(0x1FFF), 0);
+  // Writing zero changes nothing.
+  memory.Set(0x10, 0);
+  EXPECT_EQ(memory.owned_pages(), 0);
+
+  memory.Set(0x10, 0xAB);
+  EXPECT_EQ(memory.Get(0x10), 0xAB);
+  EXPECT_EQ(memory.owned_pages(), 1);
+}
+
+TEST(PagedMemoryTest, ReadWriteAcrossPages) {
+  PagedMemory memory(3 * MEMORY_PAGE_SIZE);
+  std::vector<uint8_t> bytes(MEMORY_PAGE_SIZE + 20);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = i + 1;
+  }
+  memory.Write(MEMORY_PAGE_SIZE - 10, bytes.data(), bytes.size());
+  EXPECT_EQ(memory.owned_pages(), 3);
+
+  std::vector<uint8_t> read(bytes.size());
+  memory.Read(MEMORY_PAGE_SIZE - 10, read.data(), read.size());
+  EXPECT_EQ(read, bytes);
+  EXPECT_EQ(memory.Get(MEMORY_PAGE_SIZE - 11), 0);
+  EXPECT_EQ(memory.Get(MEMORY_PAGE_SIZE - 10), 1);
+}
+
+TEST(PagedMemoryTest, ShareCopiesOnWrite) {
+  PagedMemory original(4 * MEMORY_PAGE_SIZE);
+  for (int page = 0; page < 4; page++) {
+    original.Set(page * MEMORY_PAGE_SIZE, page + 1);
+  }
+  PagedMemory copy(4 * MEMORY_PAGE_SIZE);
+  copy.Share(original);
+  EXPECT_EQ(original.owned_pages(), 0);
+  EXPECT_EQ(copy.owned_pages(), 0);
+  EXPECT_EQ(copy.Get(2 * MEMORY_PAGE_SIZE), 3);
+
+  // Each side only copies the pages it writes, and the other never sees it.
+  copy.Set(2 * MEMORY_PAGE_SIZE, 0x33);
+  original.Set(1, 0x11);
+  EXPECT_EQ(copy.owned_pages(), 1);
+  EXPECT_EQ(original.owned_pages(), 1);
+  EXPECT_EQ(copy.Get(2 * MEMORY_PAGE_SIZE), 0x33);
+  EXPECT_EQ(original.Get(2 * MEMORY_PAGE_SIZE), 3);
+  EXPECT_EQ(copy.Get(1), 0);
+  EXPECT_EQ(original.Get(1), 0x11);
+
+  // Writing what a shared page already holds keeps sharing it.
+  uint8_t same = 4;
+  copy.Write(3 * MEMORY_PAGE_SIZE, &same, 1);
+  EXPECT_EQ(copy.owned_pages(), 1);
+}
@@ -0,0 +1,73 @@
+#include "pixel_fifo.h"
+
+#include "gtest/gtest.h"
+
+class PixelFIFOTest : public ::testing::Test {
+ protected:
+  PixelFIFOTest(){};
+  ~PixelFIFOTest(){};
+};
+
+Pixel PixelAt(PixelRow row, int x) { return (row >> (x * 8)) & 0xFF; }
+
+TEST(PixelFIFOTest, PixelPacking) {
+  Pixel pixel = MakePixel(0x3, SpritePalette1, true);
+  EXPECT_EQ(PixelColor(pixel), 0x3);
+  EXPECT_EQ(PixelPalette(pixel), SpritePalette1);
+  EXPECT_TRUE(PixelSpriteOverBackgroundWindow(pixel));
+
+  pixel = MakePixel(0x2, BackgroundWindowPalette, false);
+  EXPECT_EQ(PixelColor(pixel), 0x2);
+  EXPECT_EQ(PixelPalette(pixel), BackgroundWindowPalette);
+  EXPECT_FALSE(PixelSpriteOverBackgroundWindow(pixel));
+}
+
+TEST(PixelFIFOTest, MakePixelRowLeftmostFirst) {
+  // High byte supplies bit 0 of the color, low byte bit 1.
+  PixelRow row = MakePixelRow(0x80C0, BackgroundWindowPalette, false);
+  EXPECT_EQ(PixelAt(row, 0), MakePixel(0x3, BackgroundWindowPalette, false));
+  EXPECT_EQ(PixelAt(row, 1), MakePixel(0x2, BackgroundWindowPalette, false));
+  for (int x = 2; x < 8; x++) {
+    EXPECT_EQ(PixelAt(row, x), MakePixel(0x0, BackgroundWindowPalette, false));
+  }
+}
+
+TEST(PixelFIFOTest, OverlaySpriteOverBackground) {
+  // Background colors 0, 1, 0, 1 ...
+  PixelRow background = MakePixelRow(0x5500, BackgroundWindowPalette, false);
+  // Sprite colors 2 on the left half, transparent on the right half.
+  PixelRow over = MakePixelRow(0x00F0, SpritePalette0, true);
+  PixelRow under = MakePixelRow(0x00F0, SpritePalette1, false);
+
+  PixelRow blended = OverlaySpritePixelRow(background, over);
+  for (int x = 0; x < 8; x++) {
+    if (x < 4) {
+      EXPECT_EQ(PixelAt(blended, x), MakePixel(0x2, SpritePalette0, true));
+    } else {
+      EXPECT_EQ(PixelAt(blended, x), PixelAt(background, x));
+    }
+  }
+
+  // Behind the background, sprites only show through color 0.
+  blended = OverlaySpritePixelRow(background, under);
+  for (int x = 0; x < 8; x++) {
+    if (x < 4 && PixelColor(PixelAt(background, x)) == 0) {
+      EXPECT_EQ(PixelAt(blended, x), MakePixel(0x2, SpritePalette1, false));
+    } else {
+      EXPECT_EQ(PixelAt(blended, x), PixelAt(background, x));
+    }
+  }
+}
+
+TEST(PixelFIFOTest, OverlaySpriteKeepsEarlierSprite) {
+  PixelRow background = MakePixelRow(0x0000, BackgroundWindowPalette, false);
+  PixelRow first = OverlaySpritePixelRow(background, MakePixelRow(0xF000, SpritePalette0, true));
+  PixelRow second = OverlaySpritePixelRow(first, MakePixelRow(0xFFFF, SpritePalette1, true));
+  for (int x = 0; x < 8; x++) {
+    if (x < 4) {
+      EXPECT_EQ(PixelAt(second, x), MakePixel(0x1, SpritePalette0, true));
+    } else {
+      EXPECT_EQ(PixelAt(second, x), MakePixel(0x3, SpritePalette1, true));
+    }
+  }
+}
@@ -0,0 +1,127 @@
+#include "polyphase_resampler.h"
+
+#include <cmath>
+#include <vector>
+
+#include "blip_buffer.h"
+#include "constants.h"
+#include "gtest/gtest.h"
+#include "pulse_voice.h"
+
+class PolyphaseResamplerTest : public ::testing::Test {
+ protected:
+  PolyphaseResamplerTest(){};
+  ~PolyphaseResamplerTest(){};
+};
+
+// Renders seconds of a 50% pulse from voice 1 at NATIVE_SAMPLE_RATE and
+// resamples it to out_rate.
+std::vector<int16_t> ResampledPulse(int period, int out_rate, double seconds) {
+  PulseVoice voice(1);
+  voice.SetNRX1(0x80);
+  voice.SetNRX2(0xF0);
+  voice.SetNRX3(period & 0xFF);
+  voice.SetNRX4(0x80 | (period >> 8));
+
+  BlipBuffer blip(NATIVE_SAMPLE_RATE / 50);
+  blip.SetRates(CYCLES_PER_SECOND, NATIVE_SAMPLE_RATE);
+  PolyphaseResampler resampler(NATIVE_SAMPLE_RATE, out_rate);
+  std::vector<int16_t> native(2 * NATIVE_SAMPLE_RATE / 50);
+  std::vector<int16_t> resampled;
+  int frames = (int)(seconds * CYCLES_PER_SECOND / CYCLES_PER_FRAME);
+  for (int frame = 0; frame < frames; frame++) {
+    voice.Run(0, CYCLES_PER_FRAME, &blip);
+    blip.EndFrame(CYCLES_PER_FRAME);
+    int count = blip.ReadSamples(native.data(), NATIVE_SAMPLE_RATE / 50);
+    size_t start = resampled.size();
+    resampled.resize(start + 2 * resampler.MaxOutput(count));
+    int written = resampler.Process(native.data(), count, resampled.data() + start);
+    resampled.resize(start + 2 * written);
+  }
+  return resampled;
+}
+
+TEST(PolyphaseResamplerTest, OutputRate) {
+  PolyphaseResampler resampler(NATIVE_SAMPLE_RATE, 48000);
+  std::vector<int16_t> in(2 * 1000, 100);
+  std::vector<int16_t> out;
+  const int chunks = NATIVE_SAMPLE_RATE / 1000;
+  int total = 0;
+  for (int i = 0; i < chunks; i++) {
+    out.resize(2 * resampler.MaxOutput(1000));
+    total += resampler.Process(in.data(), 1000, out.data());
+  }
+  // About a second in, less what the filter holds back.
+  double expected = double(chunks * 1000 - resampler.taps()) * 48000 / NATIVE_SAMPLE_RATE;
+  EXPECT_NEAR(total, expected, 2);
+  // DC passes unchanged.
+  EXPECT_EQ(out[0], 100);
+  EXPECT_EQ(out[1], 100);
+}
+
+TEST(PolyphaseResamplerTest, PulseTHDN) {
+  // Period 1920 is a 1024 Hz pulse, so one second at 48 kHz holds a whole
+  // number of cycles and every harmonic is exactly on a DFT bin.
+  const int rate = 48000;
+  const double frequency = 1024;
+  std::vector<int16_t> out = ResampledPulse(1920, rate, 1.5);
+
+  // Skip the DC blocker settling, and analyze the left channel.
+  const int start = rate / 4;
+  ASSERT_GE((int)out.size(), 2 * (start + rate));
+  double total = 0;
+  for (int n = 0; n < rate; n++) {
+    double x = out[2 * (start + n)];
+    total += x * x;
+  }
+
+  // Whatever isn't at a harmonic below Nyquist is noise, or aliasing of
+  // harmonics above it.
+  double harmonics = 0;
+  for (int k = 0; k * frequency < rate / 2; k++) {
+    double re = 0;
+    double im = 0;
+    for (int n = 0; n < rate; n++) {
+      double x = out[2 * (start + n)];
+      double w = 2 * M_PI * k * frequency * n / rate;
+      re += x * cos(w);
+      im += x * sin(w);
+    }
+    harmonics += (k == 0 ? 1.0 : 2.0) * (re * re + im * im) / rate;
+  }
+  double thdn_db = 10 * log10((total - harmonics) / harmonics);
+  std::cerr << "THD+N " << thdn_db << " dB" << std::endl;
+  EXPECT_LT(thdn_db, -60);
+}
+
+TEST(PolyphaseResamplerTest, AVX2MatchesBaseline) {
+  // Full scale noise, so any lane or sum going astray shows.
+  std::vector<int16_t> in(2 * 16000);
+  uint32_t seed = 1;
+  for (int16_t &sample : in) {
+    seed = seed * 1664525 + 1013904223;
+    sample = (int16_t)(seed >> 16);
+  }
+  for (int out_rate : {22050, 48000, 96000}) {
+    PolyphaseResampler fast(NATIVE_SAMPLE_RATE, out_rate);
+    PolyphaseResampler baseline(NATIVE_SAMPLE_RATE, out_rate, false);
+    EXPECT_FALSE(baseline.avx2());
+    if (!fast.avx2()) {
+      // Nothing to compare on a machine without AVX2.
+      continue;
+    }
+    int total = 0;
+    for (int chunk = 0; chunk < 4; chunk++) {
+      const int16_t *samples = in.data() + chunk * 2 * 4000;
+      std::vector<int16_t> fast_out(2 * fast.MaxOutput(4000));
+      std::vector<int16_t> baseline_out(2 * baseline.MaxOutput(4000));
+      int written = fast.Process(samples, 4000, fast_out.data());
+      ASSERT_EQ(baseline.Process(samples, 4000, baseline_out.data()), written);
+      fast_out.resize(2 * written);
+      baseline_out.resize(2 * written);
+      EXPECT_EQ(fast_out, baseline_out) << out_rate << " chunk " << chunk;
+      total += written;
+    }
+    EXPECT_GT(total, 0) << out_rate;
+  }
+}
@@ -1,8 +1,26 @@
 #include "ppu.h"
 
+#include <vector>
+
+#include "address_router.h"
+#include "emulator.h"
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "interrupt_controller.h"
 #include "screen.h"
+#include "test_roms.h"
 #include "utils.h"
+#include "video_sink.h"
+
+using testing::_;
+
+const int ROW_CYCLES = 456;
+
+class MockInterruptHandler : public InterruptHandler {
+ public:
+  MockInterruptHandler(){};
+  MOCK_METHOD(void, RequestInterrupt, (Interrupt interrupt), (override));
+};
 
 class PPUTest : public ::testing::Test {
  protected:
@@ -11,7 +29,7 @@ class PPUTest : public ::testing::Test {
 };
 
 TEST(PPUTest, GetByte) {
-  PPU *ppu = new PPU(new Screen());
+  PPU *ppu = new PPU(new Screen(new HeadlessVideoSink()));
 
   ppu->SetByteAt(0xFF40, 0x91);
   uint8_t lcdc = ppu->GetByteAt(0xFF40);
@@ -20,3 +38,245 @@ TEST(PPUTest, GetByte) {
   ppu->SetByteAt(0x8000, 0x56);
   ASSERT_EQ(ppu->GetByteAt(0x8000), 0x56);
 }
+
+TEST(PPUTest, VBlankLYChangesAtRowBoundaries) {
+  MockInterruptHandler mock_handler;
+  PPU *ppu = new PPU(new Screen(new HeadlessVideoSink()));
+  ppu->SetInterruptHandler(&mock_handler);
+  ppu->SetByteAt(0xFF40, 0x91);
+  ppu->SetByteAt(0xFF45, 150);
+  // LYC interrupt only.
+  ppu->SetByteAt(0xFF41, 0x40);
+
+  EXPECT_CALL(mock_handler, RequestInterrupt(Interrupt_VBlank)).Times(1);
+  EXPECT_CALL(mock_handler, RequestInterrupt(Interrupt_LCDC)).Times(1);
+
+  // Start of VBlank is handled at the first VBlank cycle.
+  ASSERT_FALSE(ppu->Advance(144 * ROW_CYCLES));
+  for (int ly = 144; ly < 154; ly++) {
+    ASSERT_FALSE(ppu->Advance(4));
+    EXPECT_EQ(ppu->GetByteAt(0xFF44), ly);
+    EXPECT_EQ(ppu->GetByteAt(0xFF41) & 0x3, 0x1);
+    EXPECT_EQ(bit_set(ppu->GetByteAt(0xFF41), 2), ly == 150);
+    if (ly < 153) {
+      ASSERT_FALSE(ppu->Advance(ROW_CYCLES - 4));
+    }
+  }
+  ASSERT_TRUE(ppu->Advance(ROW_CYCLES - 4));
+}
+
+TEST(PPUTest, ModesWithinARow) {
+  MockInterruptHandler mock_handler;
+  PPU *ppu = new PPU(new Screen(new HeadlessVideoSink()));
+  ppu->SetInterruptHandler(&mock_handler);
+  ppu->SetByteAt(0xFF40, 0x91);
+  EXPECT_CALL(mock_handler, RequestInterrupt(_)).Times(0);
+
+  ppu->Advance(4);
+  EXPECT_EQ(ppu->GetByteAt(0xFF41) & 0x3, 0x2);
+  ppu->Advance(80);
+  EXPECT_EQ(ppu->GetByteAt(0xFF41) & 0x3, 0x3);
+  // 160 pixels plus fetches.
+  ppu->Advance(220);
+  EXPECT_EQ(ppu->GetByteAt(0xFF41) & 0x3, 0x0);
+  ppu->Advance(ROW_CYCLES - 304);
+  ppu->Advance(4);
+  EXPECT_EQ(ppu->GetByteAt(0xFF44), 1);
+  EXPECT_EQ(ppu->GetByteAt(0xFF41) & 0x3, 0x2);
+}
+
+TEST(PPUTest, LCDOffHoldsLYAtZero) {
+  MockInterruptHandler mock_handler;
+  PPU *ppu = new PPU(new Screen(new HeadlessVideoSink()));
+  ppu->SetInterruptHandler(&mock_handler);
+  ppu->SetByteAt(0xFF40, 0x91);
+  // All STAT interrupts.
+  ppu->SetByteAt(0xFF41, 0x78);
+
+  EXPECT_CALL(mock_handler, RequestInterrupt(Interrupt_VBlank)).Times(1);
+  EXPECT_CALL(mock_handler, RequestInterrupt(Interrupt_LCDC)).Times(testing::AtLeast(1));
+  ASSERT_FALSE(ppu->Advance(145 * ROW_CYCLES));
+  ppu->SetByteAt(0xFF40, 0x11);
+  EXPECT_EQ(ppu->GetByteAt(0xFF44), 0);
+  EXPECT_EQ(ppu->GetByteAt(0xFF41) & 0x3, 0x0);
+  testing::Mock::VerifyAndClearExpectations(&mock_handler);
+
+  // Frames are still counted while dormant, without interrupts.
+  EXPECT_CALL(mock_handler, RequestInterrupt(_)).Times(0);
+  int frames = 0;
+  for (int i = 0; i < 3 * 154 * ROW_CYCLES / 4; i++) {
+    frames += ppu->Advance(4);
+    EXPECT_EQ(ppu->GetByteAt(0xFF44), 0);
+  }
+  EXPECT_EQ(frames, 3);
+  testing::Mock::VerifyAndClearExpectations(&mock_handler);
+
+  // Turning the LCD back on starts again at the top of the frame.
+  ppu->SetByteAt(0xFF41, 0x00);
+  ppu->SetByteAt(0xFF40, 0x91);
+  ppu->Advance(4);
+  EXPECT_EQ(ppu->GetByteAt(0xFF44), 0);
+  EXPECT_EQ(ppu->GetByteAt(0xFF41) & 0x3, 0x2);
+  ppu->Advance(ROW_CYCLES);
+  EXPECT_EQ(ppu->GetByteAt(0xFF44), 1);
+}
+
+TEST(PPUTest, PresentsDrawnFramesToVideoSink) {
+  MockInterruptHandler mock_handler;
+  HeadlessVideoSink video_sink;
+  PPU *ppu = new PPU(new Screen(&video_sink));
+  ppu->SetInterruptHandler(&mock_handler);
+  ppu->SetByteAt(0xFF40, 0x91);
+  ppu->SetFrameSkip(1);
+  EXPECT_CALL(mock_handler, RequestInterrupt(_)).Times(testing::AnyNumber());
+
+  for (int i = 0; i < 4 * 154 * ROW_CYCLES / 4; i++) {
+    ppu->Advance(4);
+  }
+  EXPECT_EQ(video_sink.frames_presented(), 2);
+}
+
+TEST(PPUTest, BootSkipLeavesLCDOn) {
+  std::vector<uint8_t> rom = WaitForLYROM();
+  Emulator *emulator = Emulator::Create(rom.data(), rom.size());
+  ASSERT_NE(emulator, nullptr);
+  EXPECT_EQ(emulator->ppu()->GetByteAt(0xFF40), 0x91);
+  EXPECT_EQ(emulator->ppu()->GetByteAt(0xFF47), 0xFC);
+
+  // The first frame is a whole one.
+  emulator->RunFrames(1);
+  EXPECT_GE(emulator->cycles(), 154 * ROW_CYCLES);
+
+  emulator->RunFrames(2);
+  EXPECT_EQ(emulator->ppu()->GetByteAt(0xFF40), 0x11);
+  EXPECT_EQ(emulator->serial_output(), "k");
+  delete emulator;
+}
+
+// Puts OAM sprite index at OAM coordinates x and y, with its index as its tile
+// number so it can be told apart.
+void PlaceSprite(PPU *ppu, int index, uint8_t x, uint8_t y) {
+  ppu->SetByteAt(0xFE00 + 4 * index, y);
+  ppu->SetByteAt(0xFE00 + 4 * index + 1, x);
+  ppu->SetByteAt(0xFE00 + 4 * index + 2, index);
+}
+
+// Runs ppu to the next start of row and returns the OAM indexes of the sprites
+// found there, in the order they are drawn.
+std::vector<int> SpritesOnRow(PPU *ppu, int row) {
+  do {
+    ppu->Advance(ROW_CYCLES);
+  } while (ppu->GetByteAt(0xFF44) != row);
+  std::vector<int> sprites;
+  for (int i = 0; i < ppu->row_sprites_count(); i++) {
+    sprites.push_back(ppu->row_sprites()[i].tile_number_);
+  }
+  return sprites;
+}
+
+class RowSpritesTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ppu_ = new PPU(new Screen(new HeadlessVideoSink()));
+    ppu_->SetInterruptHandler(&mock_handler_);
+    EXPECT_CALL(mock_handler_, RequestInterrupt(_)).Times(testing::AnyNumber());
+  }
+
+  // Turns on the LCD, with 8x16 sprites if tall, and stops 4 cycles into
+  // the last row so the next SpritesOnRow starts a row.
+  void TurnOn(bool tall) {
+    ppu_->SetByteAt(0xFF40, tall ? 0x97 : 0x93);
+    ppu_->Advance(153 * ROW_CYCLES + 4);
+  }
+
+  MockInterruptHandler mock_handler_;
+  PPU *ppu_;
+};
+
+TEST_F(RowSpritesTest, SpriteHeight) {
+  // Top row 10.
+  PlaceSprite(ppu_, 0, 20, 26);
+  TurnOn(false);
+  EXPECT_EQ(SpritesOnRow(ppu_, 9), std::vector<int>{});
+  EXPECT_EQ(SpritesOnRow(ppu_, 10), std::vector<int>{0});
+  EXPECT_EQ(SpritesOnRow(ppu_, 17), std::vector<int>{0});
+  EXPECT_EQ(SpritesOnRow(ppu_, 18), std::vector<int>{});
+
+  // Switching to 8x16 sprites mid-frame finds the bottom half.
+  ppu_->SetByteAt(0xFF40, 0x97);
+  EXPECT_EQ(SpritesOnRow(ppu_, 25), std::vector<int>{0});
+  EXPECT_EQ(SpritesOnRow(ppu_, 26), std::vector<int>{});
+  EXPECT_EQ(SpritesOnRow(ppu_, 10), std::vector<int>{0});
+  EXPECT_EQ(SpritesOnRow(ppu_, 18), std::vector<int>{0});
+
+  // Partly above the top of the screen.
+  PlaceSprite(ppu_, 1, 20, 4);
+  EXPECT_EQ(SpritesOnRow(ppu_, 0), std::vector<int>{1});
+  EXPECT_EQ(SpritesOnRow(ppu_, 3), std::vector<int>{1});
+  EXPECT_EQ(SpritesOnRow(ppu_, 4), std::vector<int>{});
+}
+
+TEST_F(RowSpritesTest, OAMYWritesMoveSprites) {
+  PlaceSprite(ppu_, 5, 20, 26);
+  TurnOn(true);
+  EXPECT_EQ(SpritesOnRow(ppu_, 12), std::vector<int>{5});
+
+  // Moved down, it's found later in the same frame, and not where it was.
+  ppu_->SetByteAt(0xFE00 + 4 * 5, 16 + 100);
+  EXPECT_EQ(SpritesOnRow(ppu_, 99), std::vector<int>{});
+  EXPECT_EQ(SpritesOnRow(ppu_, 100), std::vector<int>{5});
+  EXPECT_EQ(SpritesOnRow(ppu_, 115), std::vector<int>{5});
+  EXPECT_EQ(SpritesOnRow(ppu_, 12), std::vector<int>{});
+
+  // Hidden below the screen, and off the top.
+  ppu_->SetByteAt(0xFE00 + 4 * 5, 160);
+  EXPECT_EQ(SpritesOnRow(ppu_, 100), std::vector<int>{});
+  EXPECT_EQ(SpritesOnRow(ppu_, 143), std::vector<int>{});
+  ppu_->SetByteAt(0xFE00 + 4 * 5, 0);
+  EXPECT_EQ(SpritesOnRow(ppu_, 0), std::vector<int>{});
+}
+
+TEST_F(RowSpritesTest, SortedByXWithTiesInOAMOrder) {
+  const uint8_t xs[] = {50, 20, 50, 10, 20};
+  for (int i = 0; i < 5; i++) {
+    PlaceSprite(ppu_, i, xs[i], 26);
+  }
+  TurnOn(false);
+  EXPECT_EQ(SpritesOnRow(ppu_, 10), (std::vector<int>{3, 1, 4, 0, 2}));
+}
+
+TEST_F(RowSpritesTest, TenSpritesARow) {
+  // The first ten on the row in OAM order are drawn, whatever their x.
+  PlaceSprite(ppu_, 0, 100, 80);
+  for (int i = 1; i <= 12; i++) {
+    PlaceSprite(ppu_, i, 100 - i, 26);
+  }
+  TurnOn(false);
+  EXPECT_EQ(SpritesOnRow(ppu_, 10), (std::vector<int>{10, 9, 8, 7, 6, 5, 4, 3, 2, 1}));
+  EXPECT_EQ(SpritesOnRow(ppu_, 64), std::vector<int>{0});
+}
+
+TEST(RowSpritesDMATest, DMAUpdatesRows) {
+  std::vector<uint8_t> rom = IdleROM();
+  Emulator *emulator = Emulator::Create(rom.data(), rom.size());
+  ASSERT_NE(emulator, nullptr);
+  AddressRouter *router = emulator->router();
+  PPU *ppu = emulator->ppu();
+  emulator->RunFrames(1);
+
+  // Sprites 0 and 1 on row 30, copied from work RAM.
+  const uint8_t sprites[] = {46, 40, 0, 0, 46, 30, 1, 0};
+  for (int i = 0; i < 0xA0; i++) {
+    router->SetByteAt(0xC000 + i, i < (int)sizeof(sprites) ? sprites[i] : 0);
+  }
+  router->SetByteAt(0xFF46, 0xC0);
+  EXPECT_EQ(SpritesOnRow(ppu, 30), (std::vector<int>{1, 0}));
+
+  // And gone again after a DMA from zeroed memory.
+  for (int i = 0; i < 0xA0; i++) {
+    router->SetByteAt(0xC100 + i, 0);
+  }
+  router->SetByteAt(0xFF46, 0xC1);
+  EXPECT_EQ(SpritesOnRow(ppu, 30), std::vector<int>{});
+  delete emulator;
+}
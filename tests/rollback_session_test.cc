@@ -0,0 +1,93 @@
+#include "rollback_session.h"
+
+#include <vector>
+
+#include "emulator.h"
+#include "gtest/gtest.h"
+#include "loopback_transport.h"
+#include "test_roms.h"
+
+// What each player holds on a frame, changing often enough that predictions
+// are wrong.
+uint8_t PlayerButtons(int player, int64_t frame) {
+  return player == 0 ? (frame / 5) % 4 : ((frame / 7) % 4) << 4;
+}
+
+TEST(RollbackSessionTest, LoopbackPlayersAgree) {
+  std::vector<uint8_t> rom = JoypadROM();
+  LoopbackOptions link_options;
+  link_options.latency_frames = 4;
+  link_options.jitter_frames = 3;
+  LoopbackLink link(link_options);
+  RollbackOptions options;
+  // Pins the cartridge clock, which save states hold.
+  EmulatorOptions emulator_options;
+  emulator_options.rtc_time = 1;
+  Emulator *emulators[2];
+  RollbackSession *sessions[2];
+  for (int i = 0; i < 2; i++) {
+    emulators[i] = Emulator::Create(rom.data(), rom.size(), emulator_options);
+    sessions[i] = new RollbackSession(emulators[i], link.end(i), options);
+  }
+
+  const int FRAMES = 300;
+  while (sessions[0]->frame() < FRAMES || sessions[1]->frame() < FRAMES) {
+    for (int i = 0; i < 2; i++) {
+      RollbackSession *session = sessions[i];
+      if (session->frame() < FRAMES) {
+        session->AdvanceFrame(PlayerButtons(i, session->frame()));
+      }
+      ASSERT_LE(session->frame() - session->confirmed_frames(), options.max_rollback);
+    }
+    link.Tick();
+  }
+  // Let the last inputs arrive.
+  for (int tick = 0; tick <= link_options.latency_frames + link_options.jitter_frames; tick++) {
+    link.Tick();
+    sessions[0]->Poll();
+    sessions[1]->Poll();
+  }
+
+  // Both played exactly the game the players' inputs make.
+  Emulator *expected = Emulator::Create(rom.data(), rom.size(), emulator_options);
+  for (int64_t frame = 0; frame < FRAMES; frame++) {
+    int64_t pressed = frame - options.input_delay;
+    expected->SetInput(pressed < 0 ? 0 : PlayerButtons(0, pressed) | PlayerButtons(1, pressed));
+    expected->RunFrame();
+  }
+  for (int i = 0; i < 2; i++) {
+    EXPECT_EQ(sessions[i]->confirmed_frames(), FRAMES);
+    EXPECT_GT(sessions[i]->rollbacks(), 0);
+    EXPECT_LE(sessions[i]->resimulated_frames(), sessions[i]->rollbacks() * options.max_rollback);
+    EXPECT_EQ(emulators[i]->Snapshot(), expected->Snapshot()) << i;
+    delete sessions[i];
+    delete emulators[i];
+  }
+  delete expected;
+}
+
+TEST(RollbackSessionTest, StallsForSlowPeer) {
+  std::vector<uint8_t> rom = JoypadROM();
+  LoopbackOptions link_options;
+  link_options.latency_frames = 20;
+  LoopbackLink link(link_options);
+  RollbackOptions options;
+  options.max_rollback = 4;
+  Emulator *emulator = Emulator::Create(rom.data(), rom.size());
+  Emulator *peer_emulator = Emulator::Create(rom.data(), rom.size());
+  RollbackSession *session = new RollbackSession(emulator, link.end(0), options);
+  // Only sends its first inputs, which don't arrive in time.
+  RollbackSession *peer = new RollbackSession(peer_emulator, link.end(1), options);
+
+  for (int tick = 0; tick < 10; tick++) {
+    session->AdvanceFrame(Button_A);
+    link.Tick();
+  }
+  EXPECT_EQ(session->frame(), options.max_rollback);
+  EXPECT_EQ(session->stalls(), 10 - options.max_rollback);
+  EXPECT_EQ(session->confirmed_frames(), 0);
+  delete session;
+  delete peer;
+  delete emulator;
+  delete peer_emulator;
+}
@@ -0,0 +1,65 @@
+#include "screen.h"
+
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "video_sink.h"
+
+class ScreenTest : public ::testing::Test {
+ protected:
+  ScreenTest(){};
+  ~ScreenTest(){};
+};
+
+// Fills a frame with a single color 0-3.
+void DrawFrame(Screen *screen, uint8_t color) {
+  screen->VBlankBegan();
+  for (int y = 0; y < SCREEN_HEIGHT; y++) {
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+      screen->DrawPixel(MakePixel(color, BackgroundWindowPalette, false));
+    }
+    screen->NewLine();
+  }
+  screen->VBlankEnded();
+}
+
+TEST(ScreenTest, PixelsReturnsNewestFrame) {
+  HeadlessVideoSink video_sink;
+  Screen screen(&video_sink);
+  DrawFrame(&screen, 1);
+  DrawFrame(&screen, 3);
+  uint32_t color3 = screen.pixels()[0];
+  EXPECT_EQ(screen.pixels()[0], color3);
+
+  DrawFrame(&screen, 1);
+  uint32_t color1 = screen.pixels()[0];
+  EXPECT_NE(color1, color3);
+  EXPECT_EQ(video_sink.frames_presented(), 3);
+}
+
+TEST(ScreenTest, ReaderNeverSeesTornFrames) {
+  HeadlessVideoSink video_sink;
+  Screen screen(&video_sink);
+  std::atomic<bool> done(false);
+  int torn_frames = 0;
+
+  std::thread reader([&] {
+    while (!done) {
+      const uint32_t *pixels = screen.pixels();
+      for (int i = 1; i < SCREEN_PIXELS; i++) {
+        if (pixels[i] != pixels[0]) {
+          torn_frames++;
+          break;
+        }
+      }
+    }
+  });
+  for (int frame = 0; frame < 2000; frame++) {
+    DrawFrame(&screen, frame % 4);
+  }
+  done = true;
+  reader.join();
+
+  EXPECT_EQ(torn_frames, 0);
+}
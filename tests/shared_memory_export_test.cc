@@ -0,0 +1,119 @@
+#include "shared_memory_export.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "cartridge.h"
+#include "emulator.h"
+#include "gtest/gtest.h"
+#include "test_roms.h"
+
+class SharedMemoryExportTest : public ::testing::Test {
+ protected:
+  SharedMemoryExportTest(){};
+  ~SharedMemoryExportTest(){};
+};
+
+static std::string TestName() { return "/edge_test_" + std::to_string(getpid()); }
+
+TEST(SharedMemoryExportTest, FramesAndAudioReadInPlace) {
+  std::vector<uint8_t> rom = LoopROM();
+  HeadlessVideoSink video_sink;
+  HeadlessAudioSink audio_sink(48000);
+  SharedMemoryExport *shared = SharedMemoryExport::Create(TestName(), &video_sink, &audio_sink);
+  ASSERT_NE(shared, nullptr);
+  SharedMemoryReader *reader = SharedMemoryReader::Open(TestName());
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(reader->header().sample_rate, 48000u);
+  EXPECT_EQ(reader->frames_written(), 0u);
+  EXPECT_FALSE(reader->WriterGone());
+
+  Emulator emulator(new Cartridge(rom.data(), rom.size()), EmulatorOptions(), shared, shared);
+  std::vector<uint64_t> hashes;
+  for (int frame = 1; frame <= 12; frame++) {
+    shared->set_input(frame);
+    emulator.RunFrame();
+    hashes.push_back(emulator.FrameHash());
+  }
+  EXPECT_EQ(video_sink.frames_presented(), 12);
+  EXPECT_GT(audio_sink.samples_queued(), 0);
+  ASSERT_EQ(reader->frames_written(), 12u);
+
+  uint32_t ticket;
+  // Only the newest frames are still in the ring.
+  EXPECT_EQ(reader->BeginReadFrame(12 - SHARED_EXPORT_FRAME_SLOTS, &ticket), nullptr);
+  EXPECT_EQ(reader->BeginReadFrame(13, &ticket), nullptr);
+  for (uint64_t frame = 13 - SHARED_EXPORT_FRAME_SLOTS; frame <= 12; frame++) {
+    const SharedFrameSlot *slot = reader->BeginReadFrame(frame, &ticket);
+    ASSERT_NE(slot, nullptr);
+    EXPECT_EQ(slot->frame_number, frame);
+    EXPECT_EQ(slot->input, frame);
+    EXPECT_EQ(slot->hash, hashes[frame - 1]);
+    EXPECT_EQ(SharedFrameHash(slot->pixels), slot->hash);
+    EXPECT_TRUE(reader->EndRead(slot->sequence, ticket));
+  }
+  EXPECT_EQ(std::vector<uint32_t>(emulator.framebuffer(), emulator.framebuffer() + SCREEN_PIXELS),
+            std::vector<uint32_t>(reader->BeginReadFrame(12, &ticket)->pixels,
+                                  reader->BeginReadFrame(12, &ticket)->pixels + SCREEN_PIXELS));
+
+  long long samples = 0;
+  for (uint64_t block = 1; block <= reader->blocks_written(); block++) {
+    const SharedAudioBlock *audio = reader->BeginReadAudio(block, &ticket);
+    ASSERT_NE(audio, nullptr);
+    EXPECT_EQ(audio->block_number, block);
+    samples += audio->count;
+    EXPECT_TRUE(reader->EndRead(audio->sequence, ticket));
+  }
+  EXPECT_EQ(samples, audio_sink.samples_queued());
+
+  // Rewriting a slot invalidates a read in progress.
+  const SharedFrameSlot *slot = reader->BeginReadFrame(12 - SHARED_EXPORT_FRAME_SLOTS + 1, &ticket);
+  ASSERT_NE(slot, nullptr);
+  emulator.RunFrame();
+  EXPECT_FALSE(reader->EndRead(slot->sequence, ticket));
+
+  delete shared;
+  EXPECT_TRUE(reader->WriterGone());
+  EXPECT_FALSE(reader->WaitForFrame(14, 1000));
+  delete reader;
+  EXPECT_EQ(SharedMemoryReader::Open(TestName()), nullptr);
+}
+
+TEST(SharedMemoryExportTest, ReaderWaitsForEachFrame) {
+  std::vector<uint8_t> rom = LoopROM();
+  HeadlessVideoSink video_sink;
+  HeadlessAudioSink audio_sink;
+  SharedMemoryExport *shared = SharedMemoryExport::Create(TestName(), &video_sink, &audio_sink);
+  ASSERT_NE(shared, nullptr);
+  SharedMemoryReader *reader = SharedMemoryReader::Open(TestName());
+  ASSERT_NE(reader, nullptr);
+
+  // The writer stays a frame or two ahead, so the reader is usually asleep
+  // waiting when a frame lands.
+  const int FRAMES = 30;
+  std::atomic<int> read(0);
+  std::thread writer([shared, &rom, &read, &video_sink] {
+    Emulator emulator(new Cartridge(rom.data(), rom.size()), EmulatorOptions(), shared, shared);
+    while (video_sink.frames_presented() < FRAMES) {
+      while (read < video_sink.frames_presented() - 1) {
+        std::this_thread::yield();
+      }
+      emulator.RunFrame();
+    }
+  });
+  for (uint64_t frame = 1; frame <= FRAMES; frame++) {
+    ASSERT_TRUE(reader->WaitForFrame(frame, 5000));
+    uint32_t ticket;
+    const SharedFrameSlot *slot = reader->BeginReadFrame(frame, &ticket);
+    ASSERT_NE(slot, nullptr);
+    EXPECT_EQ(SharedFrameHash(slot->pixels), slot->hash);
+    EXPECT_TRUE(reader->EndRead(slot->sequence, ticket));
+    read++;
+  }
+  writer.join();
+  delete shared;
+  delete reader;
+}
@@ -1,5 +1,10 @@
 #include "sound_controller.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "audio_sink.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "interrupt_controller.h"
@@ -11,7 +16,7 @@ class SoundControllerTest : public ::testing::Test {
   SoundControllerTest(){};
   ~SoundControllerTest(){};
   void SetUp() override {
-    controller_ = new SoundController();
+    controller_ = new SoundController(new HeadlessAudioSink());
   }
 
   void TestMemoryRWWithValue(uint8_t test_value, bool set_value) {
@@ -130,3 +135,152 @@ TEST_F(SoundControllerTest, WhenOffShouldIgnoreWritesToRegisters) {
     }
     TestMemoryRWWithValue(0x00, false);
 }
+
+TEST(SoundControllerRateTest, RateRatioScalesSampleCount) {
+    HeadlessAudioSink nominal_sink;
+    SoundController nominal(&nominal_sink);
+    HeadlessAudioSink fast_sink;
+    SoundController fast(&fast_sink);
+    fast.SetRateRatio(1.005);
+
+    // Ten seconds of emulation.
+    for (int i = 0; i < 10 * CYCLES_PER_SECOND / 4; i++) {
+        nominal.Advance(4);
+        fast.Advance(4);
+    }
+    double ratio = double(fast_sink.samples_queued()) / nominal_sink.samples_queued();
+    EXPECT_NEAR(ratio, 1.005, 0.0002);
+}
+
+class RecordingAudioSink : public AudioSink {
+ public:
+  void QueueSamples(const int16_t *samples, int count) override {
+    samples_.insert(samples_.end(), samples, samples + count * AUDIO_CHANNELS);
+  }
+  std::vector<int16_t> samples_;
+};
+
+// Plays a short tune on voice 1, each step scheduled at a cycle.
+static void WriteTuneAt(int cycle, SoundController *controller) {
+    if (cycle == 0) {
+        controller->SetByteAt(0xFF24, 0x77);
+        controller->SetByteAt(0xFF25, 0xFF);
+        controller->SetByteAt(0xFF12, 0xF3);
+        controller->SetByteAt(0xFF11, 0x80);
+    }
+    if (cycle % 20000 == 0) {
+        uint16_t period = 1400 + cycle / 200;
+        controller->SetByteAt(0xFF13, period & 0xFF);
+        controller->SetByteAt(0xFF14, 0x80 | (period >> 8));
+    }
+}
+
+TEST(SoundControllerClockTest, LoggedWritesMatchPerInstructionAdvance) {
+    RecordingAudioSink stepped_sink;
+    SoundController stepped(&stepped_sink);
+    RecordingAudioSink clocked_sink;
+    SoundController clocked(&clocked_sink);
+    int clock = 0;
+    clocked.SetClock(&clock);
+
+    for (int cycle = 0; cycle < 3 * CYCLES_PER_FRAME; cycle += 4) {
+        WriteTuneAt(cycle, &stepped);
+        stepped.Advance(4);
+
+        WriteTuneAt(cycle, &clocked);
+        clock += 4;
+        if (clock == CYCLES_PER_FRAME) {
+            clocked.Advance(clock);
+            clock = 0;
+        }
+    }
+    int16_t loudest = 0;
+    for (int16_t sample : stepped_sink.samples_) {
+        loudest = std::max<int16_t>(loudest, sample);
+    }
+    ASSERT_GT(loudest, 0);
+    EXPECT_EQ(stepped_sink.samples_, clocked_sink.samples_);
+}
+
+TEST(SoundControllerClockTest, ReadsDuringLongFrame) {
+    RecordingAudioSink stepped_sink;
+    SoundController stepped(&stepped_sink);
+    RecordingAudioSink clocked_sink;
+    SoundController clocked(&clocked_sink);
+    int clock = 0;
+    clocked.SetClock(&clock);
+
+    // Frames run long when the LCD is turned on partway through one, so
+    // reads can come well past the end of the audio frame.
+    const int long_frame = CYCLES_PER_FRAME * 5 / 2;
+    for (int cycle = 0; cycle < 2 * long_frame; cycle += 4) {
+        WriteTuneAt(cycle, &stepped);
+        EXPECT_EQ(stepped.GetByteAt(0xFF26), 0xF1);
+        stepped.Advance(4);
+
+        WriteTuneAt(cycle, &clocked);
+        EXPECT_EQ(clocked.GetByteAt(0xFF26), 0xF1);
+        clock += 4;
+        if (clock == long_frame) {
+            clocked.Advance(clock);
+            clock = 0;
+        }
+    }
+    ASSERT_FALSE(stepped_sink.samples_.empty());
+    EXPECT_EQ(stepped_sink.samples_, clocked_sink.samples_);
+}
+
+TEST(SoundControllerStereoTest, PanningAndMasterVolume) {
+    RecordingAudioSink sink;
+    SoundController controller(&sink);
+    // Voice 1 only on the left, at full left and half right volume.
+    controller.SetByteAt(0xFF24, 0x73);
+    controller.SetByteAt(0xFF25, 0x10);
+    controller.SetByteAt(0xFF12, 0xF0);
+    controller.SetByteAt(0xFF11, 0x80);
+    controller.SetByteAt(0xFF13, 0x00);
+    controller.SetByteAt(0xFF14, 0x87);
+    for (int i = 0; i < CYCLES_PER_FRAME / 4; i++) {
+        controller.Advance(4);
+    }
+
+    int loudest_left = 0;
+    int loudest_right = 0;
+    for (size_t i = 0; i < sink.samples_.size(); i += 2) {
+        loudest_left = std::max(loudest_left, std::abs(sink.samples_[i]));
+        loudest_right = std::max(loudest_right, std::abs(sink.samples_[i + 1]));
+    }
+    EXPECT_GT(loudest_left, VOICE_MAX_VOLUME / 2);
+    EXPECT_EQ(loudest_right, 0);
+
+    // Moving it to the right plays it at half volume there.
+    controller.SetByteAt(0xFF25, 0x01);
+    sink.samples_.clear();
+    for (int i = 0; i < CYCLES_PER_FRAME / 4; i++) {
+        controller.Advance(4);
+    }
+    loudest_left = 0;
+    loudest_right = 0;
+    // Skip the step as the left side falls silent.
+    for (size_t i = 2 * 32; i < sink.samples_.size(); i += 2) {
+        loudest_left = std::max(loudest_left, std::abs(sink.samples_[i]));
+        loudest_right = std::max(loudest_right, std::abs(sink.samples_[i + 1]));
+    }
+    EXPECT_LT(loudest_left, VOICE_MAX_VOLUME / 16);
+    EXPECT_GT(loudest_right, VOICE_MAX_VOLUME / 4);
+    EXPECT_LT(loudest_right, VOICE_MAX_VOLUME * 3 / 4);
+}
+
+TEST(SoundControllerRateTest, ExactSampleRates) {
+    const int rates[] = {44100, 48000, 96000};
+    for (int rate : rates) {
+        HeadlessAudioSink sink(rate);
+        SoundController controller(&sink);
+        // Ten seconds of emulation in frame-sized steps, as System runs it.
+        for (int i = 0; i < 10 * CYCLES_PER_SECOND / CYCLES_PER_FRAME; i++) {
+            controller.Advance(CYCLES_PER_FRAME);
+        }
+        double seconds = double(10 * CYCLES_PER_SECOND / CYCLES_PER_FRAME) * CYCLES_PER_FRAME / CYCLES_PER_SECOND;
+        EXPECT_NEAR(sink.samples_queued(), rate * seconds, 1) << rate;
+    }
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Hand assembled cartridges for the tests and benchmarks.
+
+// A 32k ROM only cartridge whose entry point jumps to program at 0x150, with
+// an optional VBlank handler at 0x40.
+inline std::vector<uint8_t> AssembleROM(const std::vector<uint8_t> &program,
+                                        const std::vector<uint8_t> &vblank = {}) {
+  std::vector<uint8_t> rom(0x8000, 0x00);
+  const uint8_t entry[] = {0x00, 0xC3, 0x50, 0x01};  // nop; jp 0x150
+  std::copy(entry, entry + sizeof(entry), rom.begin() + 0x100);
+  std::copy(vblank.begin(), vblank.end(), rom.begin() + 0x40);
+  std::copy(program.begin(), program.end(), rom.begin() + 0x150);
+  return rom;
+}
+
+// Turns on the LCD and spins.
+inline std::vector<uint8_t> IdleROM() {
+  return AssembleROM({
+      0x3E, 0x91,  // ld a, 0x91
+      0xE0, 0x40,  // ldh (LCDC), a
+      0x18, 0xFE,  // jr -2
+  });
+}
+
+// Sends "k" over serial, turns on the LCD and spins.
+inline std::vector<uint8_t> SpinningROM() {
+  return AssembleROM({
+      0x3E, 0x6B,  // ld a, 'k'
+      0xE0, 0x01,  // ldh (SB), a
+      0x3E, 0x81,  // ld a, 0x81
+      0xE0, 0x02,  // ldh (SC), a
+      0x3E, 0x91,  // ld a, 0x91
+      0xE0, 0x40,  // ldh (LCDC), a
+      0x18, 0xFE,  // jr -2
+  });
+}
+
+// Turns on the LCD, then keeps writing a count across video RAM, so every
+// frame looks different.
+inline std::vector<uint8_t> LoopROM() {
+  return AssembleROM({
+      0x3E, 0x91,        // ld a, 0x91
+      0xE0, 0x40,        // ldh (LCDC), a
+      0x21, 0x00, 0x80,  // loop: ld hl, 0x8000
+      0x3C,              // fill: inc a
+      0x22,              // ld (hl+), a
+      0x47,              // ld b, a
+      0x7C,              // ld a, h
+      0xFE, 0xA0,        // cp 0xA0
+      0x78,              // ld a, b
+      0x20, 0xF7,        // jr nz, fill
+      0x18, 0xF2,        // jr loop
+  });
+}
+
+// Sends "o" over serial, turns on the LCD, then keeps writing an
+// incrementing count across video RAM, which shifts on each pass.
+inline std::vector<uint8_t> CountingROM() {
+  return AssembleROM({
+      0x3E, 0x6F,        // ld a, 'o'
+      0xE0, 0x01,        // ldh (SB), a
+      0x3E, 0x81,        // ld a, 0x81
+      0xE0, 0x02,        // ldh (SC), a
+      0x3E, 0x91,        // ld a, 0x91
+      0xE0, 0x40,        // ldh (LCDC), a
+      0x21, 0x00, 0x80,  // ld hl, 0x8000
+      0xAF,              // xor a
+      0x3C,              // loop: inc a
+      0x22,              // ld (hl+), a
+      0x47,              // ld b, a
+      0x7C,              // ld a, h
+      0xFE, 0xA0,        // cp 0xA0
+      0x20, 0x03,        // jr nz, +3
+      0x26, 0x80,        // ld h, 0x80
+      0x04,              // inc b, so the next pass differs
+      0x78,              // ld a, b
+      0x18, 0xF2,        // jr loop
+  });
+}
+
+// Turns on the LCD, then keeps storing the buttons to work RAM and adding
+// them into a count it writes across video RAM, so frames differ with input.
+inline std::vector<uint8_t> ButtonROM() {
+  return AssembleROM({
+      0x3E, 0x91,        // ld a, 0x91
+      0xE0, 0x40,        // ldh (LCDC), a
+      0x21, 0x00, 0x80,  // ld hl, 0x8000
+      0x3E, 0x10,        // loop: ld a, 0x10
+      0xE0, 0x00,        // ldh (P1), a
+      0xF0, 0x00,        // ldh a, (P1)
+      0xEA, 0x00, 0xC0,  // ld (0xC000), a
+      0x80,              // add b
+      0x47,              // ld b, a
+      0x22,              // ld (hl+), a
+      0x7C,              // ld a, h
+      0xFE, 0xA0,        // cp 0xA0
+      0x20, 0xEF,        // jr nz, loop
+      0x26, 0x80,        // ld h, 0x80
+      0x18, 0xEB,        // jr loop
+  });
+}
+
+// Turns on the LCD, then keeps copying the joypad register across work RAM,
+// so every input changes its state.
+inline std::vector<uint8_t> JoypadROM() {
+  return AssembleROM({
+      0x3E, 0x91,        // ld a, 0x91
+      0xE0, 0x40,        // ldh (LCDC), a
+      0xAF,              // xor a
+      0xE0, 0x00,        // ldh (P1), a, selecting both button groups
+      0x21, 0x00, 0xC0,  // loop: ld hl, 0xC000
+      0xF0, 0x00,        // copy: ldh a, (P1)
+      0x22,              // ld (hl+), a
+      0x7C,              // ld a, h
+      0xFE, 0xE0,        // cp 0xE0
+      0x20, 0xF8,        // jr nz, copy
+      0x18, 0xF3,        // jr loop
+  });
+}
+
+// Counts VBlanks in an interrupt handler while it mixes the joypad into A
+// through most of the ALU and writes the result across video RAM. Lanes with
+// different input branch differently.
+inline std::vector<uint8_t> MixingROM() {
+  return AssembleROM(
+      {
+          0x3E, 0x91,        // ld a, 0x91
+          0xE0, 0x40,        // ldh (LCDC), a
+          0x3E, 0x01,        // ld a, 0x01
+          0xE0, 0xFF,        // ldh (IE), a
+          0xFB,              // ei
+          0x21, 0x00, 0x80,  // ld hl, 0x8000
+          0x3E, 0x10,        // loop: ld a, 0x10
+          0xE0, 0x00,        // ldh (P1), a
+          0xF0, 0x00,        // ldh a, (P1)
+          0x4F,              // ld c, a
+          0x78,              // ld a, b
+          0x81,              // add c
+          0x8A,              // adc d
+          0x93,              // sub e
+          0xDE, 0x13,        // sbc 0x13
+          0xE6, 0xF7,        // and 0xF7
+          0xA9,              // xor c
+          0xB3,              // or e
+          0xFE, 0x40,        // cp 0x40
+          0x30, 0x01,        // jr nc, +1
+          0x14,              // inc d
+          0xCB, 0x37,        // swap a
+          0x22,              // ld (hl+), a
+          0x5F,              // ld e, a
+          0x7C,              // ld a, h
+          0xFE, 0xA0,        // cp 0xA0
+          0x20, 0x02,        // jr nz, +2
+          0x26, 0x80,        // ld h, 0x80
+          0x05,              // dec b
+          0x1C,              // inc e
+          0x0B,              // dec bc
+          0xC3, 0x5C, 0x01,  // jp loop
+      },
+      {
+          0xF5,              // push af
+          0xFA, 0x00, 0xC0,  // ld a, (0xC000)
+          0x3C,              // inc a
+          0xEA, 0x00, 0xC0,  // ld (0xC000), a
+          0xF1,              // pop af
+          0xD9,              // reti
+      });
+}
+
+// Turns on the LCD, then loops over register arithmetic and writes to work
+// RAM, which all run wide.
+inline std::vector<uint8_t> ArithmeticROM() {
+  return AssembleROM({
+      0x3E, 0x91,        // ld a, 0x91
+      0xE0, 0x40,        // ldh (LCDC), a
+      0x21, 0x00, 0xC0,  // loop: ld hl, 0xC000
+      0x78,              // fill: ld a, b
+      0x81,              // add c
+      0xAA,              // xor d
+      0x22,              // ld (hl+), a
+      0x04,              // inc b
+      0x0D,              // dec c
+      0x7C,              // ld a, h
+      0xFE, 0xC4,        // cp 0xC4
+      0x20, 0xF5,        // jr nz, fill
+      0x14,              // inc d
+      0xC3, 0x54, 0x01,  // jp loop
+  });
+}
+
+// Turns on the LCD, then sends bytes over serial one at a time, waiting for
+// each, and copies each byte received to work RAM. The clocking end sends 0,
+// 1, 2... on the internal clock, the other end their complements on the
+// external clock. Stops after 256 bytes, or with forever wraps around the
+// same 256 bytes of work RAM.
+inline std::vector<uint8_t> TransferROM(bool clocking, bool forever = false) {
+  return AssembleROM({
+      0x3E, 0x91,                               // ld a, 0x91
+      0xE0, 0x40,                               // ldh (LCDC), a
+      0x21, 0x00, 0xC0,                         // ld hl, 0xC000
+      0x06, 0x00,                               // ld b, 0
+      0x78,                                     // loop: ld a, b
+      (uint8_t)(clocking ? 0x00 : 0x2F),        // nop or cpl
+      0xE0, 0x01,                               // ldh (SB), a
+      0x3E, (uint8_t)(clocking ? 0x81 : 0x80),  // ld a, SC
+      0xE0, 0x02,                               // ldh (SC), a
+      0xF0, 0x02,                               // wait: ldh a, (SC)
+      0xE6, 0x80,                               // and 0x80
+      0x20, 0xFA,                               // jr nz, wait
+      0xF0, 0x01,                               // ldh a, (SB)
+      0x77,                                     // ld (hl), a
+      0x04,                                     // inc b
+      0x2C,                                     // inc l
+      (uint8_t)(forever ? 0x18 : 0x20), 0xEB,   // jr loop, or jr nz, loop
+      0x18, 0xFE,                               // done: jr done
+  });
+}
+
+// Turns on the LCD, waits about 28 cycles for each count of delay, then
+// listens on the external clock for one byte, sending 0x5A, and stores the
+// byte received at 0xC000.
+inline std::vector<uint8_t> LateListenerROM(uint16_t delay) {
+  return AssembleROM({
+      0x3E, 0x91,                                             // ld a, 0x91
+      0xE0, 0x40,                                             // ldh (LCDC), a
+      0x01, (uint8_t)(delay & 0xFF), (uint8_t)(delay >> 8),  // ld bc, delay
+      0x0B,                                                   // wait: dec bc
+      0x78,                                                   // ld a, b
+      0xB1,                                                   // or c
+      0x20, 0xFB,                                             // jr nz, wait
+      0x3E, 0x5A,                                             // ld a, 0x5A
+      0xE0, 0x01,                                             // ldh (SB), a
+      0x3E, 0x80,                                             // ld a, 0x80
+      0xE0, 0x02,                                             // ldh (SC), a
+      0xF0, 0x02,                                             // listen: ldh a, (SC)
+      0xE6, 0x80,                                             // and 0x80
+      0x20, 0xFA,                                             // jr nz, listen
+      0xF0, 0x01,                                             // ldh a, (SB)
+      0xEA, 0x00, 0xC0,                                       // ld (0xC000), a
+      0x18, 0xFE,                                             // jr @
+  });
+}
+
+// Waits for LY to reach VBlank before it touches LCDC, then turns off the
+// LCD and sends "k" over serial.
+inline std::vector<uint8_t> WaitForLYROM() {
+  return AssembleROM({
+      0xF0, 0x44,  // wait: ldh a, (LY)
+      0xFE, 0x90,  // cp 144
+      0x20, 0xFA,  // jr nz, wait
+      0x3E, 0x11,  // ld a, 0x11
+      0xE0, 0x40,  // ldh (LCDC), a
+      0x3E, 0x6B,  // ld a, 'k'
+      0xE0, 0x01,  // ldh (SB), a
+      0x3E, 0x81,  // ld a, 0x81
+      0xE0, 0x02,  // ldh (SC), a
+      0x18, 0xFE,  // jr @
+  });
+}
@@ -0,0 +1,162 @@
+#include "vec_env.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mmu.h"
+#include "screen.h"
+#include "test_roms.h"
+
+class VecEnvTest : public ::testing::Test {
+ protected:
+  VecEnvTest(){};
+  ~VecEnvTest(){};
+};
+
+// The observation VecEnv should give for the last two frames drawn: their
+// per channel maximum, in grayscale, downsampled by 2.
+static std::vector<uint8_t> ExpectedObservation(const std::vector<uint32_t> &previous,
+                                                const std::vector<uint32_t> &last) {
+  std::vector<uint32_t> pooled(SCREEN_PIXELS);
+  for (int i = 0; i < SCREEN_PIXELS; i++) {
+    for (int shift = 0; shift < 32; shift += 8) {
+      pooled[i] |= std::max((previous[i] >> shift) & 0xFF, (last[i] >> shift) & 0xFF) << shift;
+    }
+  }
+  std::vector<uint8_t> observation;
+  for (int y = 0; y < SCREEN_HEIGHT; y += 2) {
+    for (int x = 0; x < SCREEN_WIDTH; x += 2) {
+      int sum = 0;
+      for (int i : {0, 1, SCREEN_WIDTH, SCREEN_WIDTH + 1}) {
+        uint32_t argb = pooled[y * SCREEN_WIDTH + x + i];
+        sum += (((argb >> 16) & 0xFF) * 77 + ((argb >> 8) & 0xFF) * 150 + (argb & 0xFF) * 29) >> 8;
+      }
+      observation.push_back(sum / 4);
+    }
+  }
+  return observation;
+}
+
+TEST(VecEnvTest, CreateRejectsBadOptions) {
+  std::vector<uint8_t> rom = ButtonROM();
+  EXPECT_EQ(VecEnv::Create(rom.data(), 0x100, 2), nullptr);
+  EXPECT_EQ(VecEnv::Create(rom.data(), rom.size(), 0), nullptr);
+  for (int downsample : {0, 3, 5, 32}) {
+    VecEnvOptions options;
+    options.downsample = downsample;
+    EXPECT_EQ(VecEnv::Create(rom.data(), rom.size(), 2, options), nullptr) << downsample;
+  }
+  VecEnvOptions options;
+  options.action_repeat = 0;
+  EXPECT_EQ(VecEnv::Create(rom.data(), rom.size(), 2, options), nullptr);
+
+  options = VecEnvOptions();
+  options.grayscale = false;
+  options.downsample = 4;
+  VecEnv *env = VecEnv::Create(rom.data(), rom.size(), 2, options);
+  ASSERT_NE(env, nullptr);
+  EXPECT_EQ(env->observation_width(), 40);
+  EXPECT_EQ(env->observation_height(), 36);
+  EXPECT_EQ(env->observation_channels(), 3);
+  EXPECT_EQ(env->observation_size(), 40 * 36 * 3);
+  delete env;
+}
+
+TEST(VecEnvTest, StepMatchesEmulators) {
+  std::vector<uint8_t> rom = ButtonROM();
+  EmulatorOptions emulator_options;
+  emulator_options.audio_buffer_ms = 0;
+  emulator_options.rtc_time = 1;
+  VecEnv *env = VecEnv::Create(rom.data(), rom.size(), 3, VecEnvOptions(), emulator_options);
+  ASSERT_NE(env, nullptr);
+  std::vector<Emulator *> alone;
+  for (int i = 0; i < env->envs(); i++) {
+    alone.push_back(Emulator::Create(rom.data(), rom.size(), emulator_options));
+    // As VecEnv runs before its first step.
+    alone[i]->RunFrame();
+  }
+
+  std::vector<uint8_t> observations(env->envs() * env->observation_size());
+  std::vector<uint8_t> ram(env->envs() * VEC_ENV_RAM_SIZE);
+  for (int step = 0; step < 10; step++) {
+    uint8_t actions[] = {0, (uint8_t)(step % 2 ? Button_A : Button_B), Button_Start};
+    env->Step(actions, observations.data(), ram.data());
+    for (int i = 0; i < env->envs(); i++) {
+      alone[i]->SetInput(actions[i]);
+      alone[i]->RunFrames(3);
+      const uint32_t *frame = alone[i]->framebuffer();
+      std::vector<uint32_t> previous(frame, frame + SCREEN_PIXELS);
+      alone[i]->RunFrame();
+      frame = alone[i]->framebuffer();
+      std::vector<uint32_t> last(frame, frame + SCREEN_PIXELS);
+
+      std::vector<uint8_t> expected = ExpectedObservation(previous, last);
+      ASSERT_EQ(expected.size(), (size_t)env->observation_size());
+      ASSERT_TRUE(std::equal(expected.begin(), expected.end(),
+                             observations.begin() + i * env->observation_size()))
+          << "env " << i << " step " << step;
+      const uint8_t *env_ram = ram.data() + i * VEC_ENV_RAM_SIZE;
+      std::vector<uint8_t> work_ram(0x2000);
+      alone[i]->mmu()->work_ram().Read(0, work_ram.data(), work_ram.size());
+      ASSERT_TRUE(std::equal(env_ram, env_ram + 0x2000, work_ram.begin()));
+      ASSERT_TRUE(std::equal(env_ram + 0x2000, env_ram + VEC_ENV_RAM_SIZE,
+                             alone[i]->mmu()->high_ram()));
+    }
+  }
+  // P1 reads back 0 for held buttons.
+  EXPECT_EQ(ram[0] & 0xF, 0xF);
+  EXPECT_EQ(ram[2 * VEC_ENV_RAM_SIZE] & 0xF, 0x7);
+
+  for (Emulator *emulator : alone) {
+    delete emulator;
+  }
+  delete env;
+}
+
+TEST(VecEnvTest, ResetRepeatsAndThreadsAgree) {
+  std::vector<uint8_t> rom = ButtonROM();
+  EmulatorOptions emulator_options;
+  emulator_options.audio_buffer_ms = 0;
+  VecEnvOptions options;
+  options.action_repeat = 3;
+  VecEnv *env = VecEnv::Create(rom.data(), rom.size(), 5, options, emulator_options);
+  options.threads = 2;
+  VecEnv *threaded = VecEnv::Create(rom.data(), rom.size(), 5, options, emulator_options);
+  ASSERT_NE(env, nullptr);
+  ASSERT_NE(threaded, nullptr);
+
+  int size = env->envs() * env->observation_size();
+  int ram_size = env->envs() * VEC_ENV_RAM_SIZE;
+  std::vector<uint8_t> observations(size), ram(ram_size);
+  std::vector<uint8_t> threaded_observations(size), threaded_ram(ram_size);
+  std::vector<std::vector<uint8_t>> first_run;
+  for (int run = 0; run < 2; run++) {
+    env->Reset(observations.data(), ram.data());
+    threaded->Reset(threaded_observations.data(), threaded_ram.data());
+    EXPECT_EQ(observations, threaded_observations);
+    for (int step = 0; step < 6; step++) {
+      uint8_t actions[] = {0, Button_A, Button_B, Button_Select, (uint8_t)(step * 16)};
+      env->Step(actions, observations.data(), ram.data());
+      threaded->Step(actions, threaded_observations.data(), threaded_ram.data());
+      ASSERT_EQ(observations, threaded_observations);
+      ASSERT_EQ(ram, threaded_ram);
+      if (run == 0) {
+        first_run.push_back(observations);
+        first_run.push_back(ram);
+      } else {
+        EXPECT_EQ(first_run[step * 2], observations);
+        EXPECT_EQ(first_run[step * 2 + 1], ram);
+      }
+    }
+  }
+
+  // Resetting one environment leaves the others be.
+  std::vector<uint8_t> before = ram;
+  env->ResetEnv(1, nullptr, ram.data());
+  EXPECT_TRUE(std::equal(ram.begin(), ram.begin() + VEC_ENV_RAM_SIZE, before.begin()));
+  EXPECT_TRUE(std::equal(ram.begin() + 2 * VEC_ENV_RAM_SIZE, ram.end(),
+                         before.begin() + 2 * VEC_ENV_RAM_SIZE));
+  delete env;
+  delete threaded;
+}
@@ -0,0 +1,45 @@
+#include "wave_voice.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "blip_buffer.h"
+#include "gtest/gtest.h"
+
+class WaveVoiceTest : public ::testing::Test {
+ protected:
+  WaveVoiceTest(){};
+  ~WaveVoiceTest(){};
+};
+
+// Loudest left sample over a frame of alternating 15 and 0 samples.
+int LoudestAtOutputLevel(uint8_t output_level) {
+  WaveVoice voice;
+  for (uint16_t address = 0xFF30; address <= 0xFF3F; address++) {
+    voice.SetWavePatternAddress(address, 0xF0);
+  }
+  voice.SetNR30(0x80);
+  voice.SetNR32(output_level << 5);
+  voice.SetNR33(0x00);
+  voice.SetNR34(0x87);
+
+  BlipBuffer buffer(2048);
+  buffer.SetRates(CYCLES_PER_SECOND, DEFAULT_SAMPLE_RATE);
+  voice.Run(0, CYCLES_PER_FRAME, &buffer);
+  buffer.EndFrame(CYCLES_PER_FRAME);
+  int16_t out[2 * 2048];
+  int samples = buffer.ReadSamples(out, 2048);
+  int loudest = 0;
+  for (int i = 0; i < samples; i++) {
+    loudest = std::max(loudest, std::abs(out[2 * i]));
+  }
+  return loudest;
+}
+
+TEST(WaveVoiceTest, OutputLevelShifts) {
+  int full = LoudestAtOutputLevel(1);
+  EXPECT_GT(full, VOICE_MAX_VOLUME * 3 / 4);
+  EXPECT_EQ(LoudestAtOutputLevel(0), 0);
+  EXPECT_NEAR(LoudestAtOutputLevel(2), full / 2, full / 50);
+  EXPECT_NEAR(LoudestAtOutputLevel(3), full / 4, full / 50);
+}
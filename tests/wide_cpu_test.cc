@@ -0,0 +1,79 @@
+#include "wide_cpu.h"
+
+#include <vector>
+
+#include "address_router.h"
+#include "gtest/gtest.h"
+#include "test_roms.h"
+
+class WideCPUTest : public ::testing::Test {
+ protected:
+  WideCPUTest(){};
+  ~WideCPUTest(){};
+};
+
+// Some lanes share input, so they run together, and some don't.
+static uint8_t LaneInput(int lane, int frame) {
+  if (lane % 3 == 0) {
+    return 0;
+  }
+  return (lane * 37 + (frame / 4) * 11) & 0xFF;
+}
+
+TEST(WideCPUTest, CreateRejectsBadROM) {
+  std::vector<uint8_t> rom = MixingROM();
+  EXPECT_EQ(WideCPU::Create(rom.data(), 0x100, 4), nullptr);
+  EXPECT_EQ(WideCPU::Create(rom.data(), rom.size(), 0), nullptr);
+  WideCPU *wide_cpu = WideCPU::Create(rom.data(), rom.size(), 4);
+  ASSERT_NE(wide_cpu, nullptr);
+  EXPECT_EQ(wide_cpu->lanes(), 4);
+  delete wide_cpu;
+}
+
+TEST(WideCPUTest, LanesMatchEmulatorsRunAlone) {
+  const int lanes = 7;
+  const int frames = 40;
+  std::vector<uint8_t> rom = MixingROM();
+  EmulatorOptions options;
+  options.audio_buffer_ms = 0;
+  options.rtc_time = 1;
+  WideCPU *wide_cpu = WideCPU::Create(rom.data(), rom.size(), lanes, options);
+  ASSERT_NE(wide_cpu, nullptr);
+  std::vector<Emulator *> alone;
+  for (int i = 0; i < lanes; i++) {
+    alone.push_back(Emulator::Create(rom.data(), rom.size(), options));
+  }
+
+  for (int frame = 0; frame < frames; frame++) {
+    for (int i = 0; i < lanes; i++) {
+      wide_cpu->lane(i)->SetInput(LaneInput(i, frame));
+      alone[i]->SetInput(LaneInput(i, frame));
+      alone[i]->RunFrame();
+    }
+    wide_cpu->RunFrame();
+    for (int i = 0; i < lanes; i++) {
+      ASSERT_EQ(wide_cpu->lane(i)->frame_count(), alone[i]->frame_count());
+      ASSERT_EQ(wide_cpu->lane(i)->FrameHash(), alone[i]->FrameHash())
+          << "lane " << i << " frame " << frame;
+      ASSERT_EQ(wide_cpu->lane(i)->Snapshot(), alone[i]->Snapshot())
+          << "lane " << i << " frame " << frame;
+    }
+  }
+  // The VBlank handler ran.
+  EXPECT_GT(wide_cpu->lane(0)->router()->GetByteAt(0xC000), 0);
+  // Most instructions ran together, and the divergent ones alone.
+  EXPECT_GT(wide_cpu->wide_steps(), wide_cpu->scalar_steps());
+  EXPECT_GT(wide_cpu->scalar_steps(), 0u);
+
+  // A lane can still run on its own between wide frames.
+  wide_cpu->lane(2)->RunFrame();
+  alone[2]->RunFrame();
+  wide_cpu->RunFrame();
+  alone[2]->RunFrame();
+  EXPECT_EQ(wide_cpu->lane(2)->Snapshot(), alone[2]->Snapshot());
+
+  for (Emulator *emulator : alone) {
+    delete emulator;
+  }
+  delete wide_cpu;
+}